@@ -0,0 +1,151 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+#include "objects/blocks/filter.hh"
+#include "objects/blocks/piano.hh"
+#include "objects/blocks/vco.hh"
+#include "synth/node.hh"
+#include "synth/samples.hh"
+
+///
+/// Microbenchmarks for the blocks which tend to show up the most in patches, each invoked the same way the Runner
+/// does it (one batch at a time through GenericNode::invoke()).
+///
+/// Run with: bazel run -c opt //bench:blocks_bench
+///
+
+namespace objects::blocks {
+namespace {
+void set_batch_counters(benchmark::State& state) {
+    state.SetItemsProcessed(state.iterations() * synth::Samples::batch_size());
+    state.counters["batch_size"] = synth::Samples::batch_size();
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+static void BM_VCOInvoke(benchmark::State& state) {
+    const bool modulated = state.range(0);
+    const float shape = state.range(1) / 100.f;
+    const auto interpolation = static_cast<synth::Wavetable::Interpolation>(state.range(2));
+
+    // Either a fixed frequency or one swept by a slow sine, which is the usual way an LFO is patched in
+    synth::Samples frequency{0.5f};
+    if (modulated) {
+        frequency.populate_samples([](size_t i) { return 0.5f + 0.5f * std::sin(0.01f * i); });
+    }
+    const synth::Samples shapes{shape};
+
+    VoltageControlledOscillator vco{10, 1000};
+    vco.set_input(0, frequency);
+    vco.set_input(1, shapes);
+    vco.set_interpolation(interpolation);
+    synth::GenericNode& node = vco;
+
+    synth::Context context{std::chrono::nanoseconds{0}};
+    for (auto _ : state) {
+        node.invoke(context);
+        benchmark::DoNotOptimize(vco.output(0).samples.data());
+        context.timestamp += synth::Samples::batch_increment();
+    }
+    set_batch_counters(state);
+}
+// Shape is in hundredths, -1 is all square, 1 is all sine and anything in between crossfades neighboring shapes
+BENCHMARK(BM_VCOInvoke)
+    ->ArgsProduct({{0, 1}, {-100, 0, 100}, {0, 1}})
+    ->ArgNames({"modulated", "shape", "cubic"});
+
+//
+// #############################################################################
+//
+
+static void BM_VCOControlRate(benchmark::State& state) {
+    // Knobs patched straight in, compare against BM_VCOInvoke with the same shape. Modulated moves both every batch.
+    const bool modulated = state.range(0);
+    const float shape = state.range(1) / 100.f;
+
+    synth::Samples frequency{0.5f};
+    synth::Samples shapes{shape};
+
+    VoltageControlledOscillator vco{10, 1000};
+    synth::GenericNode& node = vco;
+    node.set_input(0, frequency);
+    node.set_input(1, shapes);
+    node.set_input_rate(0, synth::Rate::kControl);
+    node.set_input_rate(1, synth::Rate::kControl);
+
+    synth::Context context{std::chrono::nanoseconds{0}};
+    size_t batch = 0;
+    for (auto _ : state) {
+        if (modulated) {
+            frequency.samples[0] = 0.5f + 0.1f * (batch % 2);
+            shapes.samples[0] = shape + 0.01f * (batch % 2);
+            ++batch;
+        }
+        node.invoke(context);
+        benchmark::DoNotOptimize(vco.output(0).samples.data());
+        context.timestamp += synth::Samples::batch_increment();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_VCOControlRate)->ArgsProduct({{0, 1}, {-100, 0}})->ArgNames({"modulated", "shape"});
+
+//
+// #############################################################################
+//
+
+static void BM_PianoInvoke(benchmark::State& state) {
+    const size_t keys = state.range(0);
+
+    PianoHelper helper;
+    const char layout[] = "azsxdcvgbhnmk";
+    for (size_t key = 0; key < keys; ++key) helper.set_key(layout[key], true);
+
+    PianoNode piano{0};
+    piano.set_value(helper.as_float());
+
+    synth::Context context{std::chrono::nanoseconds{0}};
+    for (auto _ : state) {
+        piano.invoke(context);
+        benchmark::DoNotOptimize(piano.output(0).samples.data());
+        context.timestamp += synth::Samples::batch_increment();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_PianoInvoke)->Arg(0)->Arg(1)->Arg(3)->Arg(PianoHelper::kNumFrequencies)->ArgName("keys");
+
+//
+// #############################################################################
+//
+
+static void BM_FilterInvoke(benchmark::State& state) {
+    const bool modulated = state.range(0);
+    const bool control = state.range(1);
+
+    synth::Samples input;
+    input.populate_samples([](size_t i) { return std::sin(0.3f * i) + 0.5f * std::sin(0.05f * i); });
+    synth::Samples cutoff{0.2f};
+    if (modulated && !control) cutoff.populate_samples([](size_t i) { return std::sin(0.01f * i); });
+
+    // At control rate a modulated cutoff moves once a batch instead
+    Filter filter{synth::BiQuadFilter::Type::kLpf, 0};
+    synth::GenericNode& node = filter;
+    node.set_input(0, input);
+    node.set_input(1, cutoff);
+    if (control) node.set_input_rate(1, synth::Rate::kControl);
+
+    synth::Context context{std::chrono::nanoseconds{0}};
+    size_t batch = 0;
+    for (auto _ : state) {
+        if (modulated && control) cutoff.samples[0] = std::sin(0.01f * batch++);
+        node.invoke(context);
+        benchmark::DoNotOptimize(filter.output(0).samples.data());
+        context.timestamp += synth::Samples::batch_increment();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_FilterInvoke)->ArgsProduct({{0, 1}, {0, 1}})->ArgNames({"modulated", "control"});
+}  // namespace objects::blocks
@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+
+#include "synth/kernels.hh"
+#include "synth/samples.hh"
+
+///
+/// Compares each of the vectorized kernels against the scalar implementation, for every instruction set this CPU
+/// supports. Sizes are per call, a typical batch is Samples::batch_size().
+///
+/// Run with: bazel run -c opt //bench:kernels_bench
+///
+
+namespace synth::kernels {
+namespace {
+struct Data {
+    explicit Data(size_t size) : out(size), lhs(size), rhs(size), mix(size) {
+        for (size_t i = 0; i < size; ++i) {
+            lhs[i] = std::sin(0.1 * i);
+            rhs[i] = std::cos(0.1 * i);
+            mix[i] = static_cast<float>(i) / size;
+        }
+    }
+    std::vector<float> out;
+    std::vector<float> lhs;
+    std::vector<float> rhs;
+    std::vector<float> mix;
+};
+
+template <typename F>
+void run(benchmark::State& state, const Table& table, F f) {
+    const size_t size = state.range(0);
+    Data data{size};
+    for (auto _ : state) {
+        f(table, data, size);
+        benchmark::DoNotOptimize(data.out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+    state.SetLabel(table.name);
+}
+
+void register_kernel(const std::string& name, void (*f)(const Table&, Data&, size_t)) {
+    for (const Table* table : available()) {
+        benchmark::RegisterBenchmark((name + "/" + table->name).c_str(),
+                                     [table, f](benchmark::State& state) { run(state, *table, f); })
+            ->Arg(Samples::batch_size())
+            ->Arg(4096);
+    }
+}
+
+int register_all() {
+    register_kernel("fill", [](const Table& t, Data& d, size_t n) { t.fill(d.out.data(), 1.0, n); });
+    register_kernel("add", [](const Table& t, Data& d, size_t n) { t.add(d.out.data(), d.lhs.data(), 0.5, n); });
+    register_kernel("multiply", [](const Table& t, Data& d, size_t n) {
+        t.multiply(d.out.data(), d.lhs.data(), d.rhs.data(), 10.0, n);
+    });
+    register_kernel("multiply_add", [](const Table& t, Data& d, size_t n) {
+        t.multiply_add(d.out.data(), d.lhs.data(), d.rhs.data(), n);
+    });
+    register_kernel("scale", [](const Table& t, Data& d, size_t n) { t.scale(d.out.data(), d.lhs.data(), 2.0, n); });
+    register_kernel("clamp",
+                    [](const Table& t, Data& d, size_t n) { t.clamp(d.out.data(), d.lhs.data(), -0.5, 0.5, n); });
+    register_kernel("remap", [](const Table& t, Data& d, size_t n) {
+        t.remap(d.out.data(), d.lhs.data(), -1.0, 1.0, 10.0, 1000.0, n);
+    });
+    register_kernel("crossfade", [](const Table& t, Data& d, size_t n) {
+        t.crossfade(d.out.data(), d.lhs.data(), d.rhs.data(), d.mix.data(), n);
+    });
+    return 0;
+}
+
+const int kRegistered = register_all();
+}  // namespace
+}  // namespace synth::kernels
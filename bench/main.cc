@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+///
+/// Entry point for //bench, which runs every benchmark in this directory. The usual console output is printed and the
+/// results are also written as JSON (to benchmarks.json in the directory bazel was run from, unless --benchmark_out is
+/// given) so runs from different commits can be compared:
+///
+///     bazel run -c opt //bench
+///     bazel run -c opt //bench -- --benchmark_out=/tmp/after.json --benchmark_filter=BM_Runner
+///     compare.py benchmarks /tmp/before.json /tmp/after.json  (from google/benchmark's tools/)
+///
+
+int main(int argc, char* argv[]) {
+    std::vector<char*> args(argv, argv + argc);
+
+    bool has_out = false;
+    bool has_format = false;
+    for (const std::string arg : args) {
+        has_out |= arg.rfind("--benchmark_out=", 0) == 0;
+        has_format |= arg.rfind("--benchmark_out_format=", 0) == 0;
+    }
+
+    // bazel run starts in the runfiles tree, which isn't somewhere anyone would look for the results
+    const char* directory = std::getenv("BUILD_WORKING_DIRECTORY");
+    std::string out = "--benchmark_out=" + std::string(directory != nullptr ? directory : ".") + "/benchmarks.json";
+    std::string format = "--benchmark_out_format=json";
+    if (!has_out) args.push_back(out.data());
+    if (!has_format) args.push_back(format.data());
+
+    int size = static_cast<int>(args.size());
+    benchmark::Initialize(&size, args.data());
+    if (benchmark::ReportUnrecognizedArguments(size, args.data())) return EXIT_FAILURE;
+    benchmark::RunSpecifiedBenchmarks();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+
+#include "synth/biquad.hh"
+#include "synth/buffer.hh"
+#include "synth/samples.hh"
+
+///
+/// Microbenchmarks for the building blocks every node uses: Samples operations, the BiQuad filter and the buffer
+/// between the audio thread and the driver. Everything works on a single batch of Samples::batch_size() samples.
+///
+/// Run with: bazel run -c opt //bench:synth_bench
+///
+
+namespace synth {
+namespace {
+Samples wave(double frequency) {
+    Samples samples;
+    samples.populate_samples([&](size_t i) { return std::sin(2.0 * M_PI * frequency * i / Samples::batch_size()); });
+    return samples;
+}
+
+void set_batch_counters(benchmark::State& state) {
+    state.SetItemsProcessed(state.iterations() * Samples::batch_size());
+    state.counters["batch_size"] = Samples::batch_size();
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+static void BM_SamplesFill(benchmark::State& state) {
+    Samples samples;
+    for (auto _ : state) {
+        samples.fill(0.5f);
+        benchmark::DoNotOptimize(samples.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_SamplesFill);
+
+//
+// #############################################################################
+//
+
+static void BM_SamplesCopy(benchmark::State& state) {
+    const Samples from = wave(3.0);
+    Samples to;
+    for (auto _ : state) {
+        to.copy(from);
+        benchmark::DoNotOptimize(to.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_SamplesCopy);
+
+//
+// #############################################################################
+//
+
+static void BM_SamplesSum(benchmark::State& state) {
+    const Samples rhs = wave(3.0);
+    Samples samples = wave(5.0);
+    for (auto _ : state) {
+        samples.sum(rhs.samples, 0.5f);
+        benchmark::DoNotOptimize(samples.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_SamplesSum);
+
+//
+// #############################################################################
+//
+
+static void BM_SamplesCombine(benchmark::State& state) {
+    const Samples rhs = wave(3.0);
+    Samples samples = wave(5.0);
+    for (auto _ : state) {
+        samples.combine(0.5f, rhs.samples, 0.5f);
+        benchmark::DoNotOptimize(samples.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_SamplesCombine);
+
+//
+// #############################################################################
+//
+
+static void BM_SamplesPopulate(benchmark::State& state) {
+    Samples samples;
+    float phase = 0.f;
+    for (auto _ : state) {
+        samples.populate_samples([&](size_t) { return std::sin(phase += 0.01f); });
+        benchmark::DoNotOptimize(samples.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_SamplesPopulate);
+
+//
+// #############################################################################
+//
+
+static void BM_BiQuadProcess(benchmark::State& state) {
+    const auto type = static_cast<BiQuadFilter::Type>(state.range(0));
+    BiQuadFilter filter;
+    filter.set_coeff(type, 500.0, 3.0, 1.0);
+
+    const Samples input = wave(7.0);
+    Samples output;
+    for (auto _ : state) {
+        output.populate_samples([&](size_t i) { return filter.process(input.samples[i]); });
+        benchmark::DoNotOptimize(output.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_BiQuadProcess)
+    ->Arg(static_cast<int>(BiQuadFilter::Type::kLpf))
+    ->Arg(static_cast<int>(BiQuadFilter::Type::kHpf))
+    ->ArgName("type");
+
+//
+// #############################################################################
+//
+
+static void BM_BiQuadProcessBlock(benchmark::State& state) {
+    BiQuadFilter filter;
+    filter.set_coeff(BiQuadFilter::Type::kLpf, 500.0, 3.0, 1.0);
+    filter.set_precision(static_cast<BiQuadFilter::Precision>(state.range(0)));
+
+    const Samples input = wave(7.0);
+    Samples output;
+    for (auto _ : state) {
+        filter.process_block({input.samples.data(), Samples::batch_size()},
+                             {output.samples.data(), Samples::batch_size()});
+        benchmark::DoNotOptimize(output.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_BiQuadProcessBlock)
+    ->Arg(static_cast<int>(BiQuadFilter::Precision::kDouble))
+    ->Arg(static_cast<int>(BiQuadFilter::Precision::kFloat))
+    ->ArgName("float");
+
+//
+// #############################################################################
+//
+
+static void BM_BiQuadCascade(benchmark::State& state) {
+    BiQuadCascade cascade;
+    cascade.set_butterworth(BiQuadFilter::Type::kLpf, state.range(0), 500.0);
+    cascade.set_precision(static_cast<BiQuadFilter::Precision>(state.range(1)));
+
+    const Samples input = wave(7.0);
+    Samples output;
+    for (auto _ : state) {
+        cascade.process_block({input.samples.data(), Samples::batch_size()},
+                              {output.samples.data(), Samples::batch_size()});
+        benchmark::DoNotOptimize(output.samples.data());
+        benchmark::ClobberMemory();
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_BiQuadCascade)->ArgsProduct({{2, 4, 8}, {0, 1}})->ArgNames({"order", "float"});
+
+//
+// #############################################################################
+//
+
+static void BM_BiQuadBank(benchmark::State& state) {
+    // Each filter gets its own input and cutoff, like a voice would. Compare against filters * BM_BiQuadProcessBlock.
+    const size_t filters = state.range(0);
+    std::vector<BiQuadFilter> bank_filters(filters);
+    std::vector<Samples> inputs(filters);
+    std::vector<Samples> outputs(filters);
+    for (size_t f = 0; f < filters; ++f) {
+        bank_filters[f].set_coeff(BiQuadFilter::Type::kLpf, 200.0 + 10.0 * f, 3.0, 1.0);
+        inputs[f] = wave(1.0 + f);
+    }
+
+    BiQuadBank bank;
+    bank.reserve(filters);
+    for (auto _ : state) {
+        bank.clear();
+        for (size_t f = 0; f < filters; ++f) {
+            bank.add(bank_filters[f], inputs[f].samples.data(), outputs[f].samples.data());
+        }
+        bank.process(Samples::batch_size());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * filters * Samples::batch_size());
+    state.counters["filters"] = filters;
+}
+BENCHMARK(BM_BiQuadBank)->Arg(1)->Arg(2)->Arg(4)->Arg(16)->Arg(64)->Arg(256)->ArgName("filters");
+
+//
+// #############################################################################
+//
+
+static void BM_ThreadSafeBufferPushPop(benchmark::State& state) {
+    ThreadSafeBuffer buffer{4 * Samples::batch_size()};
+    const Samples input = wave(3.0);
+    Samples output;
+    for (auto _ : state) {
+        for (size_t i = 0; i < Samples::batch_size(); ++i) buffer.push(input.samples[i]);
+        for (size_t i = 0; i < Samples::batch_size(); ++i) buffer.pop(output.samples[i]);
+        benchmark::DoNotOptimize(output.samples.data());
+    }
+    set_batch_counters(state);
+}
+BENCHMARK(BM_ThreadSafeBufferPushPop);
+
+//
+// #############################################################################
+//
+
+static void BM_ThreadSafeBufferWriteRead(benchmark::State& state) {
+    // Channels worth of interleaved samples per batch, like the Bridge writes
+    const size_t size = state.range(0) * Samples::batch_size();
+    ThreadSafeBuffer buffer{4 * size};
+    std::vector<float> input(size, 0.5f);
+    std::vector<float> output(size);
+    for (auto _ : state) {
+        buffer.write(input);
+        buffer.read(output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_ThreadSafeBufferWriteRead)->Arg(1)->Arg(2)->ArgName("channels");
+}  // namespace synth
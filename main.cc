@@ -1,3 +1,8 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 #include <thread>
 
 #include "engine/object_global.hh"
@@ -11,13 +16,24 @@
 constexpr size_t kWidth = 1280;
 constexpr size_t kHeight = 720;
 
-int main() {
+int main(int argc, char* argv[]) {
+    synth::EngineConfig config;
+    for (int i = 1; i < argc; ++i) {
+        if (!synth::parse_flag(argv[i], config)) throw std::runtime_error(std::string("Unknown argument: ") + argv[i]);
+    }
+
+    // Needs to happen before anything else creates nodes or buffers
+    synth::Samples::configure(config);
+
     objects::BlockLoader loader = objects::default_loader();
     objects::Bridge bridge{loader};
 
-    auto manager = std::make_shared<objects::Manager>(loader, bridge.component_manager());
+    auto manager = std::make_shared<objects::Manager>(loader, bridge.component_manager(), bridge.parameters());
 
-    synth::AudioDriver driver{bridge.audio_buffer()};
+    // Audio is generated from the driver's callback exactly when the device asks for it
+    synth::AudioCallbacks callbacks;
+    callbacks.on_demand = [&bridge](size_t frames) { bridge.pull(frames); };
+    synth::AudioDriver driver{bridge.audio_buffer(), std::move(callbacks)};
     driver.start_thread();
 
     engine::GlobalObjectManager object_manager;
@@ -29,14 +45,14 @@ int main() {
 
     window.init();
 
-    bool shutdown = false;
-    std::thread process{[&]() {
+    // Changes to the graph are published from here, the lock is only held while checking the components
+    std::atomic<bool> shutdown = false;
+    std::thread publisher{[&]() {
         while (!shutdown) {
-            constexpr auto duration = std::chrono::milliseconds(15);
-            std::this_thread::sleep_for(0.3 * duration);
+            std::this_thread::sleep_for(std::chrono::milliseconds(15));
 
             std::lock_guard lock{window.mutex()};
-            bridge.process(duration);
+            bridge.update();
         }
     }};
 
@@ -44,7 +60,13 @@ int main() {
     }
 
     shutdown = true;
-    process.join();
+    publisher.join();
+
+    // The callbacks pull from the bridge and log, so they have to be done before anything is torn down
+    driver.stop();
+
+    std::cout << "Device underflows: " << driver.underflows()
+              << ", buffer underruns: " << bridge.audio_buffer().underruns() << " samples\n";
 
     exit(EXIT_SUCCESS);
 }
@@ -7,6 +7,8 @@
 #include "objects/blocks/button.hh"
 #include "objects/blocks/filter.hh"
 #include "objects/blocks/knob.hh"
+#include "objects/blocks/mixer.hh"
+#include "objects/blocks/pan.hh"
 #include "objects/blocks/piano.hh"
 #include "objects/blocks/speaker.hh"
 #include "objects/blocks/vco.hh"
@@ -177,6 +179,8 @@ BlockLoader default_loader() {
     loader.add_factory(std::make_unique<blocks::HPFFactory>());
     loader.add_factory(std::make_unique<blocks::PianoFactory>());
     loader.add_factory(std::make_unique<blocks::LPFFactory>());
+    loader.add_factory(std::make_unique<blocks::PanFactory>());
+    loader.add_factory(std::make_unique<blocks::StereoMixerFactory>());
     return loader;
 }
 }  // namespace objects
@@ -15,8 +15,12 @@ public:
         auto& input = inputs[0];
         auto& level = inputs[1];
 
-        outputs[0].populate_samples([&](size_t i) { return 10 * level.samples[i] * input.samples[i]; });
+        synth::Samples::batch_kernels().multiply(outputs[0].samples.data(), level.samples.data(),
+                                                 input.samples.data(), 10.f, synth::Samples::batch_size());
     }
+
+    /// Nothing comes out when either the input or the level is silent
+    bool idle() const override { return inputs()[0].silent || inputs()[1].silent; }
 };
 
 //
@@ -9,7 +9,13 @@ public:
     inline static const std::string kName = "Button";
 
 public:
-    Button(size_t count) : InjectorNode{kName + std::to_string(count)} {}
+    Button(size_t count) : InjectorNode{kName + std::to_string(count)} {
+        // Just long enough to avoid a click when toggled
+        set_ramp(synth::Samples::samples_from_time(std::chrono::milliseconds(1)));
+
+        // Nothing needs it sample accurate, the runner will ramp it for any audio rate inputs
+        set_rate(synth::Rate::kControl);
+    }
 };
 
 //
@@ -1,24 +1,58 @@
 #include "objects/blocks/filter.hh"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 #include "synth/debug.hh"
 
 namespace objects::blocks {
+namespace {
+// Gain and slope don't have inputs hooked up yet
+constexpr float kGain = 3.0;
+constexpr float kSlope = 1.0;
 
-//
-// #############################################################################
-//
+std::pair<float, float> f0_range(synth::BiQuadFilter::Type type) {
+    return type == synth::BiQuadFilter::Type::kLpf ? std::make_pair(100.f, 1000.f) : std::make_pair(1000.f, 10000.f);
+}
+
+///
+/// @brief Filters of the same type share a table, which is built again if the sample rate has changed since
+///
+std::shared_ptr<const synth::BiQuadTable> shared_table(synth::BiQuadFilter::Type type) {
+    static std::mutex mutex;
+    static std::map<std::pair<synth::BiQuadFilter::Type, uint64_t>, std::weak_ptr<const synth::BiQuadTable>> tables;
+
+    std::lock_guard lock{mutex};
+    std::weak_ptr<const synth::BiQuadTable>& weak = tables[{type, synth::Samples::sample_rate()}];
+    std::shared_ptr<const synth::BiQuadTable> table = weak.lock();
+    if (table == nullptr) {
+        const auto [f_min, f_max] = f0_range(type);
+        table = std::make_shared<synth::BiQuadTable>(type, f_min, f_max, kGain, kSlope);
+        weak = table;
+    }
+    return table;
+}
+
+bool constant(const synth::Samples& samples) {
+    const auto end = samples.samples.begin() + synth::Samples::batch_size();
+    return std::find_if(samples.samples.begin(), end, [&](float s) { return s != samples.samples.front(); }) == end;
+}
+}  // namespace
 
 //
 // #############################################################################
 //
 
 Filter::Filter(synth::BiQuadFilter::Type type, size_t count)
-    : AbstractNode{"Filter" + std::to_string(count)}, type_(type) {}
+    : AbstractNode{"Filter" + std::to_string(count)}, type_(type), table_(shared_table(type)) {
+    // Somewhere sensible to ramp from if the first batch is modulated
+    update(0.f);
+}
 
 //
 // #############################################################################
@@ -41,26 +75,68 @@ float Filter::remap(float raw, const std::tuple<float, float>& from, const std::
 //
 
 void Filter::invoke(const Inputs& inputs, Outputs& outputs) {
-    auto& input = inputs[0].samples;
+    const size_t size = synth::Samples::batch_size();
+    synth::Span<const float> input{inputs[0].samples.data(), size};
+    synth::Span<float> output{outputs[0].samples.data(), size};
     auto& f0s = inputs[1].samples;
-    // auto& gains = inputs[2].samples;
-    // auto& slopes = inputs[3].samples;
-    auto gain = 3.0;
-    auto slope = 1.0;
 
-    auto& output = outputs[0];
+    if (inputs.control(1)) {
+        // A single value for the batch, a new one is ramped to over the batch so the change isn't a step
+        if (needs_update(f0s[0], kGain, kSlope)) {
+            filter_.process_ramp(input, output, coeff(f0s[0]));
+        } else {
+            filter_.process_block(input, output);
+        }
+        return;
+    }
+
+    if (constant(inputs[1])) {
+        update(f0s[0]);
+        filter_.process_block(input, output);
+        return;
+    }
+
+    // Looking the coefficients up every sample costs more than the filtering, so when the cutoff is moving they only
+    // follow it at control rate. Each chunk ramps towards the coefficients for the cutoff at the end of the chunk.
+    for (size_t begin = 0; begin < size; begin += kControlSamples) {
+        const size_t length = std::min(kControlSamples, size - begin);
+        const synth::BiQuadFilter::Coeff target = coeff(f0s[begin + length - 1]);
+        filter_.process_ramp(input.subspan(begin, length), output.subspan(begin, length), target);
+    }
+
+    // Which leaves the filter on the coefficients for the last sample
+    needs_update(f0s[size - 1], kGain, kSlope);
+}
+
+//
+// #############################################################################
+//
+
+bool Filter::add_to(synth::BiQuadBank& bank) {
+    const float f0 = inputs()[1].samples.front();
+    if (inputs().control(1) ? f0 != previous_f0_ : !constant(inputs()[1])) return false;
 
-    output.populate_samples([&](size_t i) {
-        if (needs_update(f0s[i], gain, slope)) {
-            using Type = synth::BiQuadFilter::Type;
-            const std::pair<float, float> f0_range =
-                type_ == Type::kLpf ? std::make_pair(100.f, 1000.f) : std::make_pair(1000.f, 10000.f);
+    update(f0);
+    outputs()[0].clear_flags();
+    bank.add(filter_, inputs()[0].samples.data(), outputs()[0].samples.data());
+    return true;
+}
 
-            float f0 = remap(f0s[i], {-1.0, 1.0}, f0_range);
-            filter_.set_coeff(type_, f0, gain, slope);
-        }
-        return filter_.process(input[i]);
-    });
+//
+// #############################################################################
+//
+
+synth::BiQuadFilter::Coeff Filter::coeff(float raw_f0) const {
+    // The table covers the whole f0 range, so the remapping is just onto [0, 1]
+    return table_->at(0.5f * (raw_f0 + 1.f));
+}
+
+//
+// #############################################################################
+//
+
+void Filter::update(float raw_f0) {
+    if (needs_update(raw_f0, kGain, kSlope)) filter_.set_coeff(coeff(raw_f0));
 }
 
 //
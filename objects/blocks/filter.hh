@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <tuple>
 
 #include "objects/blocks.hh"
@@ -8,7 +9,13 @@
 
 namespace objects::blocks {
 
-class Filter final : public synth::AbstractNode<4, 1> {
+class Filter final : public synth::AbstractNode<4, 1>, public synth::BiQuadNode {
+public:
+    ///
+    /// @brief When the cutoff is modulated the coefficients are only looked up this often, and ramped in between
+    ///
+    static constexpr size_t kControlSamples = 16;
+
 public:
     Filter(synth::BiQuadFilter::Type type, size_t count);
 
@@ -17,10 +24,33 @@ public:
 
     void invoke(const Inputs& inputs, Outputs& outputs) override;
 
+    /// Everything but the signal itself is usually a knob
+    synth::Rate input_rate(size_t index) const override {
+        return index == 0 ? synth::Rate::kAudio : synth::Rate::kControl;
+    }
+
+    synth::BiQuadNode* as_biquad() override { return this; }
+
+    /// Only when the cutoff is the same for the whole batch (and hasn't moved since the last one, at control rate)
+    bool add_to(synth::BiQuadBank& bank) override;
+
+    /// Once the input goes quiet, the filter is only idle after it's rung out
+    bool idle() const override { return inputs()[0].silent && filter_.settled(); }
+
+private:
+    /// Coefficients for the raw cutoff input (in [-1, 1])
+    synth::BiQuadFilter::Coeff coeff(float raw_f0) const;
+
+    /// Point the filter at the raw cutoff input
+    void update(float raw_f0);
+
 private:
     const synth::BiQuadFilter::Type type_;
     synth::BiQuadFilter filter_;
 
+    /// Shared with every other filter of the same type
+    std::shared_ptr<const synth::BiQuadTable> table_;
+
     // Used for caching
     float previous_f0_ = 0.0f;
     float previous_gain_ = 0.0f;
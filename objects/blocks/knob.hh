@@ -9,7 +9,13 @@ public:
     inline static const std::string kName = "Knob";
 
 public:
-    Knob(size_t count) : InjectorNode{kName + std::to_string(count)} {}
+    Knob(size_t count) : InjectorNode{kName + std::to_string(count)} {
+        // Smooth out the steps from dragging the knob around
+        set_ramp(synth::Samples::samples_from_time(std::chrono::milliseconds(5)));
+
+        // Nothing needs it sample accurate, the runner will ramp it for any audio rate inputs
+        set_rate(synth::Rate::kControl);
+    }
 };
 
 //
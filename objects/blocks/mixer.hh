@@ -0,0 +1,61 @@
+#pragma once
+
+#include "objects/blocks.hh"
+#include "synth/node.hh"
+
+namespace objects::blocks {
+
+///
+/// @brief Crossfades between two stereo pairs, a balance of -1 is only the first pair and 1 is only the second
+///
+class StereoMixer final : public synth::AbstractNode<5, 2> {
+public:
+    inline static const std::string kName = "Stereo Mixer";
+
+public:
+    StereoMixer(size_t count) : AbstractNode{kName + std::to_string(count)} {}
+
+public:
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        const auto& kernels = synth::Samples::batch_kernels();
+        const size_t size = synth::Samples::batch_size();
+
+        kernels.remap(mix_.samples.data(), inputs[4].samples.data(), -1.f, 1.f, 0.f, 1.f, size);
+        for (size_t c = 0; c < 2; ++c) {
+            kernels.crossfade(outputs[c].samples.data(), inputs[c].samples.data(), inputs[2 + c].samples.data(),
+                              mix_.samples.data(), size);
+        }
+    }
+
+    /// Wherever the balance is, there's nothing to mix
+    bool idle() const override {
+        return inputs()[0].silent && inputs()[1].silent && inputs()[2].silent && inputs()[3].silent;
+    }
+
+private:
+    synth::Samples mix_;
+};
+
+//
+// #############################################################################
+//
+
+class StereoMixerFactory : public SimpleBlockFactory {
+public:
+    StereoMixerFactory()
+        : SimpleBlockFactory([] {
+              SimpleBlockFactory::Config config;
+              config.name = StereoMixer::kName;
+              config.inputs = 5;
+              config.outputs = 2;
+              return config;
+          }()) {}
+    ~StereoMixerFactory() override = default;
+
+public:
+    std::unique_ptr<synth::GenericNode> spawn_synth_node() const override {
+        static size_t counter = 0;
+        return std::make_unique<StereoMixer>(counter++);
+    }
+};
+}  // namespace objects::blocks
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "objects/blocks.hh"
+#include "synth/node.hh"
+
+namespace objects::blocks {
+
+///
+/// @brief Places a mono signal between the left (-1) and right (1) channels. The pan law is equal power, so the signal
+/// stays the same loudness as it moves and is 3dB down on each channel in the center.
+///
+class Pan final : public synth::AbstractNode<2, 2> {
+public:
+    inline static const std::string kName = "Pan";
+
+public:
+    Pan(size_t count) : AbstractNode{kName + std::to_string(count)} {}
+
+public:
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        auto& input = inputs[0];
+        auto& pan = inputs[1];
+
+        // A held knob only needs the gains worked out once, the per sample trig is just for audio rate modulation
+        if (pan.constant) {
+            const auto& kernels = synth::Samples::batch_kernels();
+            const size_t size = synth::Samples::batch_size();
+            const float angle = this->angle(pan.samples[0]);
+            kernels.scale(outputs[0].samples.data(), input.samples.data(), std::cos(angle), size);
+            kernels.scale(outputs[1].samples.data(), input.samples.data(), std::sin(angle), size);
+            return;
+        }
+
+        auto& left = outputs[0].samples;
+        auto& right = outputs[1].samples;
+        for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+            const float angle = this->angle(pan.samples[i]);
+            left[i] = std::cos(angle) * input.samples[i];
+            right[i] = std::sin(angle) * input.samples[i];
+        }
+    }
+
+    bool idle() const override { return inputs()[0].silent; }
+
+private:
+    static float angle(float pan) { return 0.25f * M_PI * (std::clamp(pan, -1.f, 1.f) + 1.f); }
+};
+
+//
+// #############################################################################
+//
+
+class PanFactory : public SimpleBlockFactory {
+public:
+    PanFactory()
+        : SimpleBlockFactory([] {
+              SimpleBlockFactory::Config config;
+              config.name = Pan::kName;
+              config.inputs = 2;
+              config.outputs = 2;
+              return config;
+          }()) {}
+    ~PanFactory() override = default;
+
+public:
+    std::unique_ptr<synth::GenericNode> spawn_synth_node() const override {
+        static size_t counter = 0;
+        return std::make_unique<Pan>(counter++);
+    }
+};
+}  // namespace objects::blocks
@@ -74,28 +74,34 @@ public:
     inline static const std::string kName = "Piano";
 
 public:
-    PianoNode(size_t count) : InjectorNode{kName + std::to_string(count)}, data_(std::make_unique<Data>()) {}
-    synth::Samples get_output(size_t) const override {
-        synth::Samples output;
+    PianoNode(size_t count) : InjectorNode{kName + std::to_string(count)} {}
+
+    void generate(const synth::Context&, synth::Samples& output) override {
+        output.fill(0.f);
+
         auto bitset = PianoHelper::from_float(get_value());
         for (size_t f = 0; f < PianoHelper::kNumFrequencies; ++f) {
             synth::Samples this_f;
             double phase_inc = phase_increment(PianoHelper::kFrequencies[f]);
-            auto fade_data = fade_info(bitset.test(f), data_->previous.test(f));
+            auto fade_data = fade_info(bitset.test(f), previous_.test(f));
             float fade = std::get<0>(fade_data);
             float fade_inc = std::get<1>(fade_data);
 
-            this_f.populate_samples(
-                [&](size_t) { return (fade += fade_inc) * std::sin((data_->phases[f] += phase_inc)); });
+            this_f.populate_samples([&](size_t) { return (fade += fade_inc) * std::sin((phases_[f] += phase_inc)); });
             output.sum(this_f.samples);
         }
-        data_->previous = bitset;
-        return output;
+        previous_ = bitset;
     }
 
+    ///
+    /// @brief With no keys down and nothing left fading out. The phases stop moving while it's idle, which doesn't
+    /// matter since a key starts from wherever its phase happens to be anyway.
+    ///
+    bool idle() const override { return previous_.none() && PianoHelper::from_float(get_value()).none(); }
+
 private:
     double phase_increment(float frequency) const {
-        return 2.0 * M_PI * static_cast<double>(frequency) / synth::Samples::kSampleRate;
+        return 2.0 * M_PI * static_cast<double>(frequency) / synth::Samples::sample_rate();
     }
     std::pair<float, float> fade_info(bool is_enabled, bool was_enabled) const {
         if (is_enabled && was_enabled) {
@@ -105,20 +111,17 @@ private:
             return {0.f, 0.f};  // off
         }
         if (is_enabled && !was_enabled) {
-            return {0.f, 1.f / synth::Samples::kBatchSize};  // fade on
+            return {0.f, 1.f / synth::Samples::batch_size()};  // fade on
         }
         if (!is_enabled && was_enabled) {
-            return {1.f, -1.f / synth::Samples::kBatchSize};  // fade off
+            return {1.f, -1.f / synth::Samples::batch_size()};  // fade off
         }
         return {0.0, 0.0};
     }
 
 private:
-    struct Data {
-        std::array<double, PianoHelper::kNumFrequencies> phases{0.0};
-        std::bitset<PianoHelper::kNumFrequencies> previous{0};
-    };
-    std::unique_ptr<Data> data_;
+    std::array<double, PianoHelper::kNumFrequencies> phases_{0.0};
+    std::bitset<PianoHelper::kNumFrequencies> previous_{0};
 };
 
 //
@@ -9,7 +9,8 @@ public:
     inline static const std::string kName = "Speaker";
 
 public:
-    Speaker(size_t count) : EjectorNode{kName + std::to_string(count)} {}
+    /// One input per output channel, the first is played on all of them if it's the only one connected
+    Speaker(size_t count) : EjectorNode{kName + std::to_string(count), synth::Samples::channels()} {}
 };
 
 //
@@ -22,7 +23,7 @@ public:
         : SimpleBlockFactory([] {
               SimpleBlockFactory::Config config;
               config.name = Speaker::kName;
-              config.inputs = 1;
+              config.inputs = synth::Samples::channels();
               config.outputs = 0;
               return config;
           }()) {}
@@ -0,0 +1,181 @@
+#include "objects/blocks/filter.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+namespace objects::blocks {
+
+TEST(FilterTest, matches_per_sample) {
+    using Type = synth::BiQuadFilter::Type;
+
+    synth::Samples input;
+    input.populate_samples([](size_t i) { return std::sin(0.3f * i) + 0.5f * std::sin(0.05f * i); });
+
+    // A sweep which moves every sample, and then a cutoff which stays put for a few batches
+    synth::Samples cutoff;
+    size_t sample = 0;
+    const auto sweep = [&](size_t) { return 0.8f * std::sin(0.005f * sample++); };
+
+    for (Type type : {Type::kLpf, Type::kHpf}) {
+        sample = 0;
+        Filter filter{type, 0};
+        typename Filter::Outputs outputs;
+
+        synth::BiQuadFilter reference;
+        const std::tuple<float, float> range = type == Type::kLpf ? std::make_tuple(100.f, 1000.f)
+                                                                  : std::make_tuple(1000.f, 10000.f);
+        float max_error = 0.0;
+        for (size_t batch = 0; batch < 8; ++batch) {
+            if (batch < 4) {
+                cutoff.populate_samples(sweep);
+            } else {
+                cutoff.fill(0.25f);
+            }
+            filter.invoke({input, cutoff, synth::silence(), synth::silence()}, outputs);
+
+            for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+                reference.set_coeff(type, filter.remap(cutoff.samples[i], {-1.0, 1.0}, range), 3.0, 1.0);
+                const float error = std::abs(outputs[0].samples[i] - reference.process(input.samples[i]));
+                max_error = std::max(max_error, error);
+
+                // Once the cutoff settles the filter should be right on
+                if (batch > 4) {
+                    ASSERT_NEAR(error, 0.0, 1E-4) << "batch: " << batch << " sample: " << i;
+                }
+            }
+        }
+
+        // Following the sweep at control rate should be close enough to inaudible
+        EXPECT_LT(max_error, 1E-2);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(FilterTest, bank) {
+    synth::Samples input;
+    input.populate_samples([](size_t i) { return std::sin(0.3f * i) + 0.5f * std::sin(0.05f * i); });
+    synth::Samples cutoff{0.25f};
+
+    Filter banked{synth::BiQuadFilter::Type::kLpf, 0};
+    Filter invoked{synth::BiQuadFilter::Type::kLpf, 1};
+    synth::GenericNode& banked_node = banked;
+    synth::GenericNode& invoked_node = invoked;
+    for (synth::GenericNode* node : {&banked_node, &invoked_node}) {
+        node->set_input(0, input);
+        node->set_input(1, cutoff);
+    }
+    ASSERT_EQ(banked_node.as_biquad(), &banked);
+
+    synth::BiQuadBank bank;
+    bank.reserve(1);
+    synth::Context context{std::chrono::nanoseconds{0}};
+    for (size_t batch = 0; batch < 3; ++batch) {
+        bank.clear();
+        ASSERT_TRUE(banked.add_to(bank));
+        bank.process(synth::Samples::batch_size());
+        invoked_node.invoke(context);
+
+        for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+            ASSERT_NEAR(banked.output(0).samples[i], invoked.output(0).samples[i], 1E-4)
+                << "batch: " << batch << " sample: " << i;
+        }
+    }
+
+    // A cutoff that moves within the batch needs the filter invoked as normal
+    cutoff.samples[10] = 0.5f;
+    bank.clear();
+    EXPECT_FALSE(banked.add_to(bank));
+    EXPECT_EQ(bank.size(), 0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(FilterTest, control_rate) {
+    synth::Samples input;
+    input.populate_samples([](size_t i) { return std::sin(0.3f * i) + 0.5f * std::sin(0.05f * i); });
+
+    // The same cutoff as a control rate value and as the full batch the runner would have promoted it to
+    Filter control{synth::BiQuadFilter::Type::kLpf, 0};
+    Filter audio{synth::BiQuadFilter::Type::kLpf, 1};
+    synth::GenericNode& control_node = control;
+    synth::GenericNode& audio_node = audio;
+
+    synth::Samples control_cutoff;
+    synth::Samples audio_cutoff;
+    control_node.set_input(0, input);
+    control_node.set_input(1, control_cutoff);
+    control_node.set_input_rate(1, synth::Rate::kControl);
+    audio_node.set_input(0, input);
+    audio_node.set_input(1, audio_cutoff);
+
+    synth::BiQuadBank bank;
+    bank.reserve(1);
+    synth::Context context{std::chrono::nanoseconds{0}};
+    const std::vector<float> cutoffs{0.25, 0.25, 0.6, 0.6, 0.6};
+    float previous = 0.f;
+    for (size_t batch = 0; batch < cutoffs.size(); ++batch) {
+        control_cutoff.samples[0] = cutoffs[batch];
+        audio_cutoff.ramp(previous, cutoffs[batch]);
+        previous = cutoffs[batch];
+
+        // Only a cutoff which has moved since the last batch needs the filter invoked on its own
+        bank.clear();
+        const bool moved = batch == 0 || cutoffs[batch] != cutoffs[batch - 1];
+        if (moved) {
+            EXPECT_FALSE(control.add_to(bank));
+            control_node.invoke(context);
+        } else {
+            EXPECT_TRUE(control.add_to(bank));
+            bank.process(synth::Samples::batch_size());
+        }
+        audio_node.invoke(context);
+
+        // Ramping the coefficients over the batch isn't quite the same as ramping the cutoff
+        for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+            ASSERT_NEAR(control.output(0).samples[i], audio.output(0).samples[i], 1E-2)
+                << "batch: " << batch << " sample: " << i;
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(FilterTest, idle) {
+    synth::Samples input;
+    synth::Samples cutoff;
+    cutoff.fill(0.25f);
+
+    Filter filter{synth::BiQuadFilter::Type::kLpf, 0};
+    synth::GenericNode& node = filter;
+    node.set_input(0, input);
+    node.set_input(1, cutoff);
+
+    synth::Context context{std::chrono::nanoseconds{0}};
+    input.populate_samples([](size_t i) { return std::sin(0.3f * i); });
+    node.invoke(context);
+    EXPECT_FALSE(filter.idle());
+
+    // Silence in isn't enough, the filter needs to ring out first
+    input.fill(0.f);
+    node.invoke(context);
+    EXPECT_FALSE(filter.idle());
+    EXPECT_NE(filter.output(0).samples[0], 0.0);
+
+    size_t batches = 1;
+    for (; batches < 1000 && !filter.idle(); ++batches) node.invoke(context);
+    EXPECT_TRUE(filter.idle()) << "after " << batches << " batches";
+
+    // Which means invoking it would only have output silence
+    node.invoke(context);
+    for (size_t i = 0; i < synth::Samples::batch_size(); ++i) ASSERT_EQ(filter.output(0).samples[i], 0.0) << i;
+}
+}  // namespace objects::blocks
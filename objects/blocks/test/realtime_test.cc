@@ -0,0 +1,44 @@
+#include "synth/realtime.hh"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "objects/blocks.hh"
+#include "synth/node.hh"
+
+namespace objects::blocks {
+
+//
+// #############################################################################
+//
+
+TEST(RealtimeTest, every_block) {
+    if (!synth::realtime::kEnabled) GTEST_SKIP() << "Only checked with --config=rtcheck";
+
+    const BlockLoader loader = default_loader();
+    for (const std::string& name : loader.names()) {
+        auto node = loader.get(name).spawn_synth_node();
+
+        // Something changing on every input, so nothing can take a shortcut
+        std::vector<synth::Samples> inputs(node->num_inputs());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            inputs[i].populate_samples([&](size_t s) { return 0.1f * i + static_cast<float>(s) / 1000.f; });
+            node->set_input(i, inputs[i]);
+        }
+        if (auto* injector = node->as_injector()) injector->set_value(1.0);
+
+        const size_t before = synth::realtime::violations();
+        {
+            synth::realtime::Scope realtime;
+            synth::Context context{std::chrono::nanoseconds(0)};
+            for (size_t batch = 0; batch < 20; ++batch) {
+                if (auto* injector = node->as_injector()) injector->schedule(0.1f * batch, batch);
+                node->invoke(context);
+                context.timestamp += synth::Samples::batch_increment();
+            }
+        }
+        EXPECT_EQ(synth::realtime::violations(), before) << name;
+    }
+}
+}  // namespace objects::blocks
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <utility>
+
+#include "objects/blocks/mixer.hh"
+#include "objects/blocks/pan.hh"
+
+namespace objects::blocks {
+
+//
+// #############################################################################
+//
+
+TEST(PanTest, equal_power) {
+    Pan pan(0);
+    synth::Samples input(1.0);
+    Pan::Outputs outputs;
+
+    for (float position : {-1.f, -0.5f, 0.f, 0.3f, 1.f}) {
+        synth::Samples control(position);
+        pan.invoke({input, control}, outputs);
+
+        const float left = outputs[0].samples[0];
+        const float right = outputs[1].samples[0];
+        EXPECT_NEAR(left * left + right * right, 1.0, 1E-6);
+        if (position < 0) {
+            EXPECT_GT(left, right);
+        }
+        if (position > 0) {
+            EXPECT_LT(left, right);
+        }
+    }
+
+    // Centered is 3dB down on each side
+    synth::Samples center(0.0);
+    pan.invoke({input, center}, outputs);
+    EXPECT_NEAR(outputs[0].samples[0], std::sqrt(0.5), 1E-6);
+    EXPECT_NEAR(outputs[1].samples[0], std::sqrt(0.5), 1E-6);
+}
+
+//
+// #############################################################################
+//
+
+TEST(PanTest, constant) {
+    Pan pan(0);
+    synth::Samples input;
+    input.populate_samples([](size_t i) { return std::sin(0.1f * i); });
+
+    for (float position : {-1.f, -0.5f, 0.f, 0.3f, 1.f}) {
+        // Samples built with a value don't claim to be constant, so this is the per sample path
+        Pan::Outputs expected;
+        synth::Samples modulated(position);
+        pan.invoke({input, modulated}, expected);
+
+        Pan::Outputs outputs;
+        synth::Samples held;
+        held.fill(position);
+        pan.invoke({input, held}, outputs);
+
+        for (size_t c = 0; c < 2; ++c) {
+            for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+                ASSERT_NEAR(outputs[c].samples[i], expected[c].samples[i], 1E-6) << position;
+            }
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(StereoMixerTest, balance) {
+    StereoMixer mixer(0);
+    synth::Samples left_1(1.0);
+    synth::Samples right_1(2.0);
+    synth::Samples left_2(3.0);
+    synth::Samples right_2(4.0);
+    StereoMixer::Outputs outputs;
+
+    auto mix = [&](float balance) {
+        synth::Samples control(balance);
+        mixer.invoke({left_1, right_1, left_2, right_2, control}, outputs);
+        return std::make_pair(outputs[0].samples[0], outputs[1].samples[0]);
+    };
+
+    EXPECT_EQ(mix(-1.0), std::make_pair(1.f, 2.f));
+    EXPECT_EQ(mix(1.0), std::make_pair(3.f, 4.f));
+    EXPECT_EQ(mix(0.0), std::make_pair(2.f, 3.f));
+
+    // Past the ends is the same as the end
+    EXPECT_EQ(mix(10.0), std::make_pair(3.f, 4.f));
+}
+}  // namespace objects::blocks
@@ -4,6 +4,8 @@
 
 #include <chrono>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 namespace objects::blocks {
 
@@ -14,13 +16,13 @@ using Shape = VoltageControlledOscillator::Shape;
 //
 
 TEST(VoltageControlledOscillatorTest, remap) {
-    EXPECT_EQ(remap(0.0, {-1.0, 1.0}, {0.0, 100.0}), 50.0);
-    EXPECT_EQ(remap(1.0, {-1.0, 1.0}, {0.0, 100.0}), 100.0);
-    EXPECT_EQ(remap(-1.0, {-1.0, 1.0}, {0.0, 100.0}), 0.0);
-    EXPECT_EQ(remap(0.1, {-1.0, 1.0}, {0.0, 100.0}), 55.0);
-    EXPECT_EQ(remap(-100, {-1.0, 1.0}, {0.0, 100.0}), 0.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(0.0, {-1.0, 1.0}, {0.0, 100.0}), 50.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(1.0, {-1.0, 1.0}, {0.0, 100.0}), 100.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(-1.0, {-1.0, 1.0}, {0.0, 100.0}), 0.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(0.1, {-1.0, 1.0}, {0.0, 100.0}), 55.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(-100, {-1.0, 1.0}, {0.0, 100.0}), 0.0);
 
-    EXPECT_EQ(remap(2.0, {-7.0, 3.0}, {-5.0, 5.0}), 4.0);
+    EXPECT_EQ(VoltageControlledOscillator::remap(2.0, {-7.0, 3.0}, {-5.0, 5.0}), 4.0);
 }
 
 //
@@ -37,11 +39,9 @@ TEST(VoltageControlledOscillatorTest, pure_sin) {
     vco.invoke({frequency, shape}, outputs);
     auto& output = outputs[0].samples;
 
-    EXPECT_EQ(frequency.samples.size(), output.size());
-
     double f = 10000.0;
-    for (size_t i = 0; i < output.size(); ++i) {
-        float expected = std::sin(2 * M_PI * f * i / synth::Samples::kSampleRate);
+    for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+        float expected = std::sin(2 * M_PI * f * i / synth::Samples::sample_rate());
         ASSERT_NEAR(output[i], expected, 1E-5) << "iteration: " << i;
     }
 }
@@ -53,19 +53,23 @@ TEST(VoltageControlledOscillatorTest, pure_sin) {
 TEST(VoltageControlledOscillatorTest, pure_square) {
     VoltageControlledOscillator vco(0, 10000);
 
-    synth::Samples frequency(0.0);
-    synth::Samples shape(-1.0);
+    synth::Samples frequency(-0.9);  // 500 Hz
+    synth::Samples shape(VoltageControlledOscillator::shape_input(Shape::kSquare));
 
     typename VoltageControlledOscillator::Outputs outputs;
     vco.invoke({frequency, shape}, outputs);
     auto& output = outputs[0].samples;
 
-    EXPECT_EQ(frequency.samples.size(), output.size());
-
-    double f = 5005.0;
-    for (size_t i = 0; i < output.size(); ++i) {
-        float expected = std::fmod(2.0 * M_PI * f * i / synth::Samples::kSampleRate, 2 * M_PI) < M_PI ? -1.f : 1.f;
-        ASSERT_NEAR(output[i], expected, 1E-5) << "iteration: " << i;
+    // Band limited, so it's only flat away from the edges and rings a little around them
+    double f = 500.0;
+    for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+        const double cycle = std::fmod(f * i / synth::Samples::sample_rate(), 1.0);
+        ASSERT_LE(std::abs(output[i]), 1.0) << "iteration: " << i;
+        if (cycle > 0.1 && cycle < 0.4) {
+            ASSERT_NEAR(output[i], 0.9, 0.1) << "iteration: " << i;
+        } else if (cycle > 0.6 && cycle < 0.9) {
+            ASSERT_NEAR(output[i], -0.9, 0.1) << "iteration: " << i;
+        }
     }
 }
 
@@ -74,24 +78,115 @@ TEST(VoltageControlledOscillatorTest, pure_square) {
 //
 
 TEST(VoltageControlledOscillatorTest, mixed) {
-    VoltageControlledOscillator vco(0, 10000);
+    synth::Samples frequency(0.0);
+    auto generate = [&](float shape_value) {
+        VoltageControlledOscillator vco(0, 10000);
+        synth::Samples shape(shape_value);
+        typename VoltageControlledOscillator::Outputs outputs;
+        vco.invoke({frequency, shape}, outputs);
+        return outputs[0];
+    };
+
+    // 20% of the way from the triangle to the sine
+    const float triangle = VoltageControlledOscillator::shape_input(Shape::kTriangle);
+    const float sin = VoltageControlledOscillator::shape_input(Shape::kSin);
+    const synth::Samples expected_triangle = generate(triangle);
+    const synth::Samples expected_sin = generate(sin);
+    const synth::Samples output = generate(triangle + 0.2 * (sin - triangle));
+
+    for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+        const float expected = 0.8 * expected_triangle.samples[i] + 0.2 * expected_sin.samples[i];
+        ASSERT_NEAR(output.samples[i], expected, 1E-5) << "iteration: " << i;
+    }
+}
 
+//
+// #############################################################################
+//
+
+TEST(VoltageControlledOscillatorTest, modulated_shape) {
+    // Sweeping the shape across every table should match generating each sample with a constant shape
     synth::Samples frequency(0.0);
-    synth::Samples shape(0.6);  // 20% square 80% sin
+    synth::Samples shape;
+    shape.populate_samples([](size_t i) { return -1.0 + 2.0 * i / (synth::Samples::batch_size() - 1); });
 
+    VoltageControlledOscillator vco(0, 10000);
     typename VoltageControlledOscillator::Outputs outputs;
     vco.invoke({frequency, shape}, outputs);
-    auto& output = outputs[0].samples;
 
-    EXPECT_EQ(frequency.samples.size(), output.size());
+    for (size_t i = 0; i < synth::Samples::batch_size(); i += 7) {
+        VoltageControlledOscillator reference(0, 10000);
+        typename VoltageControlledOscillator::Outputs expected;
+        reference.invoke({frequency, synth::Samples(shape.samples[i])}, expected);
+        ASSERT_NEAR(outputs[0].samples[i], expected[0].samples[i], 1E-5) << "iteration: " << i;
+    }
+}
 
-    double f = 5005.0;
-    for (size_t i = 0; i < output.size(); ++i) {
-        float expected =
-            0.2 * (std::fmod(2.0 * M_PI * f * i / synth::Samples::kSampleRate, 2 * M_PI) < M_PI ? -1.f : 1.f);
-        expected += 0.8 * std::sin(2 * M_PI * f * i / synth::Samples::kSampleRate);
+//
+// #############################################################################
+//
 
-        ASSERT_NEAR(output[i], expected, 1E-5) << "iteration: " << i;
+TEST(VoltageControlledOscillatorTest, continuous) {
+    // Consecutive batches pick up exactly where the last one left off
+    VoltageControlledOscillator vco(0, 1000);
+    synth::Samples frequency(0.3);
+    synth::Samples shape(VoltageControlledOscillator::shape_input(Shape::kSin));
+
+    typename VoltageControlledOscillator::Outputs outputs;
+    const double f = 650.0;
+    for (size_t batch = 0; batch < 4; ++batch) {
+        vco.invoke({frequency, shape}, outputs);
+        for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+            const size_t sample = batch * synth::Samples::batch_size() + i;
+            const float expected = std::sin(2 * M_PI * f * sample / synth::Samples::sample_rate());
+            ASSERT_NEAR(outputs[0].samples[i], expected, 1E-4) << "sample: " << sample;
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(VoltageControlledOscillatorTest, control_rate) {
+    // Control rate inputs should sound the same as the full batches the runner would have promoted them to
+    VoltageControlledOscillator control(0, 1000);
+    VoltageControlledOscillator audio(0, 1000, 1);
+    synth::GenericNode& control_node = control;
+    synth::GenericNode& audio_node = audio;
+
+    synth::Samples control_frequency;
+    synth::Samples control_shape;
+    synth::Samples audio_frequency;
+    synth::Samples audio_shape;
+    control_node.set_input(0, control_frequency);
+    control_node.set_input(1, control_shape);
+    control_node.set_input_rate(0, synth::Rate::kControl);
+    control_node.set_input_rate(1, synth::Rate::kControl);
+    audio_node.set_input(0, audio_frequency);
+    audio_node.set_input(1, audio_shape);
+
+    // Held for a couple of batches, then each one moves
+    const std::vector<std::pair<float, float>> values{{0.3, -0.2}, {0.3, -0.2}, {0.5, -0.2}, {0.5, 0.6}, {0.5, 0.6}};
+    synth::Context context{std::chrono::nanoseconds{0}};
+    for (size_t batch = 0; batch < values.size(); ++batch) {
+        const auto [frequency, shape] = values[batch];
+        control_frequency.samples[0] = frequency;
+        control_shape.samples[0] = shape;
+        if (batch == 0) {
+            audio_frequency.fill(frequency);
+            audio_shape.fill(shape);
+        } else {
+            audio_frequency.ramp(values[batch - 1].first, frequency);
+            audio_shape.ramp(values[batch - 1].second, shape);
+        }
+
+        control_node.invoke(context);
+        audio_node.invoke(context);
+        for (size_t i = 0; i < synth::Samples::batch_size(); ++i) {
+            ASSERT_NEAR(control.output(0).samples[i], audio.output(0).samples[i], 1E-4)
+                << "batch: " << batch << " sample: " << i;
+        }
     }
 }
 }  // namespace objects::blocks
@@ -1,5 +1,6 @@
 #include "objects/blocks/vco.hh"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <iomanip>
@@ -18,21 +19,105 @@ namespace objects::blocks {
 //
 
 VoltageControlledOscillator::VoltageControlledOscillator(float f_min, float f_max, size_t count)
-    : AbstractNode{"VoltageControlledOscillator" + std::to_string(count)}, frequency_{f_min, f_max} {}
+    : AbstractNode{"VoltageControlledOscillator" + std::to_string(count)}, frequency_{f_min, f_max} {
+    // The tables are shared by every oscillator and built the first time they're used, which needs to be here rather
+    // than on the audio thread
+    tables_ = {&synth::Wavetable::square(), &synth::Wavetable::saw(), &synth::Wavetable::triangle(),
+               &synth::Wavetable::sine()};
+}
 
 //
 // #############################################################################
 //
 
 void VoltageControlledOscillator::invoke(const Inputs& inputs, Outputs& outputs) {
-    auto& frequencies = inputs[0].samples;
-    auto& shapes = inputs[1].samples;
-    auto& output = outputs[0];
-
-    output.populate_samples([&](size_t i) {
-        return sample(remap(frequencies[i], {-1.0, 1.0}, frequency_),
-                      remap(shapes[i], {-1.0, 1.0}, {0.0, static_cast<int>(Shape::kMax) - 1}));
-    });
+    using Phase = synth::Wavetable::Phase;
+    constexpr size_t kMaxSize = synth::Samples::kMaxBatchSize;
+    const size_t size = synth::Samples::batch_size();
+    const auto& kernels = synth::Samples::batch_kernels();
+    const auto& [f_min, f_max] = frequency_;
+
+    // Phases for the whole batch up front, so each table lookup below only depends on its own sample. The level is
+    // picked for the highest frequency in the batch so that nothing aliases even when the frequency is modulated.
+    alignas(64) std::array<Phase, kMaxSize> phases;
+    Phase max_increment = 0;
+
+    // A control rate input which has changed since the last batch is ramped to over this one, the same way the runner
+    // would have promoted it. Otherwise it's held, and anything which depends on it only needs working out once.
+    const float raw_frequency = inputs[0].samples[0];
+    if (inputs.control(0) && (raw_frequency == previous_frequency_ || std::isnan(previous_frequency_))) {
+        const float frequency = remap(raw_frequency, {-1.0, 1.0}, frequency_);
+        const Phase increment = synth::Wavetable::phase_increment(frequency);
+        for (size_t i = 0; i < size; ++i) {
+            phases[i] = phase_;
+            phase_ += increment;
+        }
+        max_increment = std::min<Phase>(increment, Phase{0} - increment);
+    } else {
+        const float* raw = inputs[0].samples.data();
+        if (inputs.control(0)) {
+            ramp_.ramp(previous_frequency_, raw_frequency);
+            raw = ramp_.samples.data();
+        }
+
+        alignas(64) std::array<float, kMaxSize> frequencies;
+        kernels.remap(frequencies.data(), raw, -1.0, 1.0, f_min, f_max, size);
+        for (size_t i = 0; i < size; ++i) {
+            const Phase increment = synth::Wavetable::phase_increment(frequencies[i]);
+            phases[i] = phase_;
+            phase_ += increment;
+            max_increment = std::max(max_increment, std::min<Phase>(increment, Phase{0} - increment));
+        }
+    }
+    if (inputs.control(0)) previous_frequency_ = raw_frequency;
+    const size_t level = synth::Wavetable::level(max_increment);
+
+    float* output = outputs[0].samples.data();
+    const float* shapes = inputs[1].samples.data();
+    const float last_shape = kShapes - 1;
+
+    // The frequency is done with the ramp by now, so the shape can reuse it
+    bool held = false;
+    if (inputs.control(1)) {
+        const float shape = shapes[0];
+        held = shape == previous_shape_ || std::isnan(previous_shape_);
+        if (!held) {
+            ramp_.ramp(previous_shape_, shape);
+            shapes = ramp_.samples.data();
+        }
+        previous_shape_ = shape;
+    } else {
+        held = std::all_of(shapes, shapes + size, [&](float shape) { return shape == shapes[0]; });
+    }
+
+    // The shape is almost always a knob, in which case at most two tables are needed for the whole batch
+    if (held) {
+        const float position = remap(shapes[0], {-1.0, 1.0}, {0.0, last_shape});
+        const size_t lower = std::min<size_t>(position, kShapes - 2);
+        const float mix = position - lower;
+
+        if (mix == 0.f || mix == 1.f) {
+            tables_[lower + static_cast<size_t>(mix)]->render(output, phases.data(), level, size, interpolation_);
+            return;
+        }
+
+        alignas(64) std::array<float, kMaxSize> upper;
+        tables_[lower]->render(output, phases.data(), level, size, interpolation_);
+        tables_[lower + 1]->render(upper.data(), phases.data(), level, size, interpolation_);
+        kernels.scale(output, output, 1.f - mix, size);
+        kernels.add(output, upper.data(), mix, size);
+        return;
+    }
+
+    alignas(64) std::array<float, kMaxSize> positions;
+    kernels.remap(positions.data(), shapes, -1.0, 1.0, 0.0, last_shape, size);
+    for (size_t i = 0; i < size; ++i) {
+        const size_t lower = std::min<size_t>(positions[i], kShapes - 2);
+        const float mix = positions[i] - lower;
+        const float lhs = tables_[lower]->at(phases[i], level, interpolation_);
+        const float rhs = tables_[lower + 1]->at(phases[i], level, interpolation_);
+        output[i] = lhs + mix * (rhs - lhs);
+    }
 }
 
 //
@@ -56,36 +141,8 @@ float VoltageControlledOscillator::remap(float raw, const std::tuple<float, floa
 // #############################################################################
 //
 
-float VoltageControlledOscillator::sample(float frequency, float shape) {
-    constexpr auto kMax = static_cast<int>(Shape::kMax);
-    int discrete_shape = static_cast<int>(shape);
-    float percent = shape - discrete_shape;
-    const Shape shape0 = static_cast<Shape>(discrete_shape);
-    const Shape shape1 = static_cast<Shape>((discrete_shape + 1) % kMax);
-
-    auto sample_with_shape = [phase = this->phase_](const Shape s) -> float {
-        switch (s) {
-            case Shape::kSin:
-                return std::sin(phase);
-            case Shape::kSquare:
-                return std::fmod(phase, 2 * M_PI) < M_PI ? -1.f : 1.f;
-            case Shape::kMax:
-            default:
-                throw std::runtime_error("Invalid shape in VCO::sample()!");
-                break;
-        }
-    };
-
-    phase_ += phase_increment(frequency);
-    return percent * sample_with_shape(shape0) + (1.0 - percent) * sample_with_shape(shape1);
-}
-
-//
-// #############################################################################
-//
-
-double VoltageControlledOscillator::phase_increment(float frequency) {
-    return 2.0 * M_PI * static_cast<double>(frequency) / synth::Samples::kSampleRate;
+float VoltageControlledOscillator::shape_input(Shape shape) {
+    return remap(static_cast<float>(shape), {0.0, kShapes - 1}, {-1.0, 1.0});
 }
 
 //
@@ -1,35 +1,57 @@
 #pragma once
 
+#include <array>
+#include <limits>
 #include <tuple>
 
 #include "objects/blocks.hh"
 #include "synth/node.hh"
+#include "synth/wavetable.hh"
 
 namespace objects::blocks {
 
+///
+/// @brief Band-limited wavetable oscillator. The first input sets the frequency, the second morphs between the shapes
+/// in order (-1 is a square, 1 is a sine) crossfading between neighbors.
+///
 class VoltageControlledOscillator final : public synth::AbstractNode<2, 1> {
 public:
     VoltageControlledOscillator(float f_min, float f_max, size_t count = 0);
 
 public:
     enum class Shape : uint8_t {
-        kSin = 0,
-        kSquare = 1,
-        kMax = 2,
+        kSquare = 0,
+        kSaw = 1,
+        kTriangle = 2,
+        kSin = 3,
+        kMax = 4,
     };
+    static constexpr size_t kShapes = static_cast<size_t>(Shape::kMax);
 
     static float remap(float raw, const std::tuple<float, float>& from, const std::tuple<float, float>& to);
 
+    /// Value of the shape input which plays only the given shape
+    static float shape_input(Shape shape);
+
     void invoke(const Inputs& inputs, Outputs& outputs) override;
 
-    float sample(float frequency, float shape);
+    /// Both are usually knobs, which saves remapping the frequency and blending the shapes every sample
+    synth::Rate input_rate(size_t) const override { return synth::Rate::kControl; }
 
-private:
-    double phase_increment(float frequency);
+    void set_interpolation(synth::Wavetable::Interpolation interpolation) { interpolation_ = interpolation; }
 
 private:
     std::tuple<float, float> frequency_;
-    double phase_ = 0.0;
+    synth::Wavetable::Phase phase_ = 0;
+    synth::Wavetable::Interpolation interpolation_ = synth::Wavetable::Interpolation::kCubic;
+
+    // Control rate inputs from the last batch, NaN before the first
+    float previous_frequency_ = std::numeric_limits<float>::quiet_NaN();
+    float previous_shape_ = std::numeric_limits<float>::quiet_NaN();
+    synth::Samples ramp_;
+
+    // In the same order as Shape
+    std::array<const synth::Wavetable*, kShapes> tables_;
 };
 
 //
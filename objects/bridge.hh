@@ -1,97 +1,403 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "objects/blocks.hh"
+#include "objects/blocks/speaker.hh"
 #include "objects/components.hh"
 #include "synth/debug.hh"
 #include "synth/node.hh"
+#include "synth/parameters.hh"
 #include "synth/runner.hh"
 #include "synth/samples.hh"
+#include "synth/thread_pool.hh"
 
 namespace objects {
 class Bridge {
 public:
-    Bridge(const BlockLoader& loader) : loader_(loader), audio_buffer_(synth::Samples::kSampleRate) {}
+    Bridge(const BlockLoader& loader)
+        : loader_(loader), mix_(synth::Samples::channels() * synth::Samples::batch_size()) {
+        main_bus_ = &audio_buffer(blocks::Speaker::kStreamName);
+    }
+
+    ~Bridge() {
+        stop_thread();
+        delete pending_.load();
+        delete retired_.load();
+        delete active_;
+    }
+
+    Bridge(const Bridge& rhs) = delete;
+    Bridge(Bridge&& rhs) = delete;
+    Bridge& operator=(const Bridge& rhs) = delete;
+    Bridge& operator=(Bridge&& rhs) = delete;
 
 public:
     ComponentManager& component_manager() { return component_; };
     const ComponentManager& component_manager() const { return component_; };
 
-    synth::ThreadSafeBuffer& audio_buffer() { return audio_buffer_; }
+    ///
+    /// @brief Generated audio for the speakers, as interleaved frames with Samples::channels() channels
+    ///
+    synth::ThreadSafeBuffer& audio_buffer() { return *main_bus_; }
+
+    ///
+    /// @brief Audio mixed from every SynthOutput with the given stream name (the bus is created if it doesn't exist
+    /// yet), so it can be sent somewhere other than the speakers. Buses are created here and by update(), so this
+    /// needs to be called from the same thread. Every bus is filled at the same rate, anything that isn't read will
+    /// start dropping samples once it's full.
+    ///
+    synth::ThreadSafeBuffer& audio_buffer(const std::string& stream_name) {
+        auto& bus = buses_[stream_name];
+        if (bus == nullptr) {
+            bus = std::make_unique<synth::ThreadSafeBuffer>(synth::Samples::channels() * synth::Samples::sample_rate());
+        }
+        return *bus;
+    }
+
+    ///
+    /// @brief Parameter changes for the graph, keyed by SynthNode id. This is the only way to change values without
+    /// the graph being rebuilt.
+    ///
+    synth::ParameterQueue& parameters() { return parameters_; }
 
 public:
+    ///
+    /// @brief Pick up any changes to the structure of the graph. This reads the components, so it needs to be called
+    /// while nothing else is modifying them. The new graph is built here and handed off to be swapped in between
+    /// batches, so whatever is generating audio never waits on this.
+    ///
+    void update() {
+        // Only one new graph can be in flight at once, any changes will be picked up once it has been swapped in
+        if (pending_.load(std::memory_order_acquire) != nullptr) return;
+
+        // Anything the audio side is done with is cleaned up here so it never needs to free memory
+        delete retired_.exchange(nullptr, std::memory_order_acquire);
+
+        // Most calls don't change anything about the structure of the graph, so only rebuild it when needed
+        if (update_topology()) publish(rebuild());
+    }
+
+    ///
+    /// @brief Generate at least the given duration of audio on the calling thread (unless plenty is already
+    /// buffered). This only touches the graph and the parameter queue, so it doesn't need to be synchronized with
+    /// changes to the components. This shouldn't be used while the audio thread is running.
+    ///
+    void run(const std::chrono::nanoseconds& duration) {
+        if (buffered() > 1.5 * duration) {
+            return;
+        }
+        generate(duration);
+    }
+
     void process(const std::chrono::nanoseconds& duration) {
-        if (synth::Samples::time_from_samples(audio_buffer_.size()) > 1.5 * duration) {
+        update();
+        run(duration);
+    }
+
+    ///
+    /// @brief Pull mode, meant to be called from the audio driver's callback (see synth::AudioCallbacks::on_demand).
+    /// Whole batches are generated until at least the number of frames are buffered. Whatever is left over from the
+    /// last batch stays buffered for the next call, so there's never more than a batch of extra latency.
+    ///
+    void pull(size_t frames) {
+        // Make sure this can always finish, even if asked for more than fits
+        const size_t channels = synth::Samples::channels();
+        const size_t capacity = main_bus_->capacity() - channels * synth::Samples::batch_size();
+        const size_t target = std::min(channels * frames, capacity);
+        while (main_bus_->size() < target) generate(synth::Samples::batch_increment());
+    }
+
+public:
+    ///
+    /// @brief Push mode, generate audio on a dedicated (real-time priority, if allowed) thread which keeps at least
+    /// latency worth of samples in the audio buffer. The thread wakes up each time notify() is called, or every so
+    /// often otherwise.
+    ///
+    void start_thread(const std::chrono::nanoseconds& latency) {
+        stop_thread();
+        shutdown_ = false;
+        thread_ = std::thread([this, latency]() {
+            while (!shutdown_) {
+                // Topped up a batch at a time, so the buffer stays just above the target
+                while (!shutdown_ && buffered() < latency) {
+                    generate(synth::Samples::batch_increment());
+                }
+                wait_for_demand(latency / 4);
+            }
+        });
+        if (!synth::set_realtime_priority(thread_)) info("Unable to give the audio thread real-time priority.");
+    }
+
+    void stop_thread() {
+        shutdown_ = true;
+        demand_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    ///
+    /// @brief Let the audio thread know samples have been taken out of the audio buffer. This doesn't lock or
+    /// allocate, so it's safe to call from the audio driver's callback.
+    ///
+    void notify() {
+        demanded_.store(true, std::memory_order_release);
+        demand_.notify_one();
+    }
+
+    /// Number of times the graph has been rebuilt
+    size_t rebuilds() const { return rebuilds_; }
+
+    ///
+    /// @brief Time every node in graphs built from now on (see synth::Runner::set_profiling()). Timing starts over
+    /// each time the graph is rebuilt.
+    ///
+    void set_profiling(bool enabled, size_t trace_events = 0) {
+        profiling_ = enabled;
+        trace_events_ = trace_events;
+    }
+
+    ///
+    /// @brief Timing for the graph currently generating audio. These read state owned by the audio side, so they
+    /// should only be used in pull mode from the thread calling pull() (or with the audio stopped).
+    ///
+    synth::Profile profile() const { return active_ != nullptr ? active_->runner.profile() : synth::Profile{}; }
+    synth::Runner::SkipStats skip_stats() const {
+        return active_ != nullptr ? active_->runner.skip_stats() : synth::Runner::SkipStats{};
+    }
+    void write_trace(std::ostream& stream) const {
+        if (active_ != nullptr) active_->runner.write_trace(stream);
+    }
+
+private:
+    ///
+    /// @brief Snapshot of the graph, built by update() and then owned by whatever generates audio once it's swapped
+    /// in. Nodes which survive a rebuild are moved from the previous snapshot to the new one, which is safe since the
+    /// runner only holds raw pointers and the previous snapshot isn't freed until after the swap.
+    ///
+    struct Graph {
+        synth::NodeWrappers wrappers;
+        synth::Runner runner;
+        bool compiled = false;
+
+        ///
+        /// @brief Every SynthOutput with the same stream name is summed into that bus. Buses without any outputs are
+        /// still filled (with silence) so they all stay in step.
+        ///
+        struct Route {
+            synth::ThreadSafeBuffer* bus;
+            std::vector<synth::EjectorNode*> ejectors;
+        };
+        std::vector<Route> routes;
+
+        // Values from the components, which are set when the graph is swapped in
+        std::vector<std::pair<synth::InjectorNode*, float>> values;
+    };
+
+private:
+    ///
+    /// @brief Everything in the components which affects the structure of the graph. This is much cheaper to collect
+    /// than rebuilding the graph, so it's used to detect when something has changed.
+    ///
+    struct Topology {
+        // entity id, node id, hash of the node name
+        std::vector<std::array<size_t, 3>> nodes;
+        // from node id, from port, to node id, to port
+        std::vector<std::array<size_t, 4>> connections;
+        // node id for each input (in the same order as they're stored), entity id, node id and hash of the stream
+        // name for each output
+        std::vector<size_t> inputs;
+        std::vector<std::array<size_t, 3>> outputs;
+
+        bool operator==(const Topology& rhs) const {
+            return nodes == rhs.nodes && connections == rhs.connections && inputs == rhs.inputs &&
+                   outputs == rhs.outputs;
+        }
+    };
+
+    ///
+    /// @brief Collect the current topology, returning true if it's different than the last time this was called
+    ///
+    bool update_topology() {
+        // Reuse the previous capacity so this doesn't allocate every cycle
+        auto& next = next_topology_;
+        next.nodes.clear();
+        next.connections.clear();
+        next.inputs.clear();
+        next.outputs.clear();
+
+        component_.run_system<SynthNode>([&](const ecs::Entity& e, const SynthNode& node) {
+            next.nodes.push_back({e.id(), node.id, std::hash<std::string>{}(node.name)});
+        });
+        component_.run_system<SynthConnection>([&](const ecs::Entity&, const SynthConnection& connection) {
+            next.connections.push_back({node_id(connection.from), connection.from_port, node_id(connection.to),
+                                        connection.to_port});
+        });
+        auto [inputs, num_inputs] = component_.raw_view<SynthInput>();
+        for (size_t i = 0; i < num_inputs; ++i) next.inputs.push_back(node_id(inputs[i].parent));
+        component_.run_system<SynthOutput>([&](const ecs::Entity& e, const SynthOutput& output) {
+            next.outputs.push_back({e.id(), node_id(output.parent), std::hash<std::string>{}(output.stream_name)});
+        });
+
+        if (next == topology_) return false;
+        std::swap(next, topology_);
+        return true;
+    }
+
+    void generate(const std::chrono::nanoseconds& duration) {
+        swap_in_pending();
+
+        // Each batch is mixed as soon as it's generated, so the streams never hold more than one
+        const auto increment = synth::Samples::batch_increment();
+        const size_t batches = std::max<size_t>(1, (duration + increment - std::chrono::nanoseconds(1)) / increment);
+        for (size_t batch = 0; batch < batches; ++batch) {
+            if (active_ != nullptr && active_->compiled) active_->runner.next();
+            mix();
+        }
+    }
+
+    ///
+    /// @brief Sum the latest batch from each output into its bus. Nothing here allocates.
+    ///
+    void mix() {
+        if (active_ == nullptr) {
+            std::fill(mix_.begin(), mix_.end(), 0.f);
+            main_bus_->write(mix_);
             return;
         }
 
-        // TODO it'd be easy to add an needs_update type bool to skip doing this if we don't need to
-        {
-            auto previous_wrappers = std::move(wrappers_);
-            component_.run_system<SynthNode>(
-                [&](const ecs::Entity&, const SynthNode& node) { add_node(node, previous_wrappers); });
+        for (const auto& route : active_->routes) {
+            std::fill(mix_.begin(), mix_.end(), 0.f);
+            for (synth::EjectorNode* ejector : route.ejectors) ejector->stream().mix_into(mix_);
+            route.bus->write(mix_);
         }
+    }
+
+    ///
+    /// @brief Audio side of the hand off. Nothing here allocates, frees or locks.
+    ///
+    void swap_in_pending() {
+        Graph* pending = pending_.load(std::memory_order_acquire);
+        if (pending == nullptr) return;
+
+        if (pending->compiled) pending->runner.bind();
+        for (const auto& [injector, value] : pending->values) injector->set_value(value);
+        if (active_ != nullptr) pending->runner.continue_from(active_->runner);
+
+        // The previous graph goes back to be freed by update(), which has always collected the last one by the time
+        // it can publish another
+        retired_.store(active_, std::memory_order_release);
+        active_ = pending;
+        pending_.store(nullptr, std::memory_order_release);
+    }
+
+    /// How much audio is waiting to be played
+    std::chrono::nanoseconds buffered() const {
+        return synth::Samples::time_from_samples(main_bus_->size() / synth::Samples::channels());
+    }
+
+    void wait_for_demand(const std::chrono::nanoseconds& timeout) {
+        // notify() doesn't take the lock so a wakeup can be missed, the timeout bounds how late that makes things
+        std::unique_lock lock{demand_mutex_};
+        demand_.wait_for(lock, timeout, [this]() { return shutdown_ || demanded_.load(std::memory_order_acquire); });
+        demanded_.store(false, std::memory_order_relaxed);
+    }
+
+    void publish(std::unique_ptr<Graph> graph) {
+        latest_ = graph.get();
+        pending_.store(graph.release(), std::memory_order_release);
+    }
+
+    std::unique_ptr<Graph> rebuild() {
+        rebuilds_++;
+
+        auto graph = std::make_unique<Graph>();
+        graph->runner.set_parameters(&parameters_);
+        graph->runner.set_profiling(profiling_, trace_events_);
+
+        // Any nodes which still exist keep their state by moving them over from the latest graph
+        synth::NodeWrappers empty;
+        synth::NodeWrappers& previous = latest_ != nullptr ? latest_->wrappers : empty;
+        auto& wrappers = graph->wrappers;
+        component_.run_system<SynthNode>(
+            [&](const ecs::Entity&, const SynthNode& node) { add_node(wrappers, node, previous); });
 
         // Form connections for all of the nodes
         component_.run_system<SynthConnection>(
-            [&](const ecs::Entity&, const SynthConnection& connection) { add_connection(connection); });
-
-        // Update values for all the input wrappers
-        component_.run_system<SynthInput>(
-            [&](const ecs::Entity&, const SynthInput& input) { update_node_value(input); });
+            [&](const ecs::Entity&, const SynthConnection& connection) { add_connection(wrappers, connection); });
 
-        runner_.run_for_at_least(duration, wrappers_);
+        // Values normally arrive through the parameter queue, but they could have changed in any way (like being loaded
+        // from a file) while the graph was being edited so start from whatever the components have
+        auto [inputs, num_inputs] = component_.raw_view<SynthInput>();
+        for (size_t i = 0; i < num_inputs; ++i) {
+            synth::InjectorNode* injector = wrapper_from_node(wrappers, inputs[i].parent).node->as_injector();
+            if (injector == nullptr) throw std::runtime_error("SynthInput attached to a node which isn't an injector.");
+            graph->values.push_back({injector, inputs[i].value});
+        }
 
-        // TODO Right now this assumes there's at max one speaker which breaks down pretty quickly
-        bool any_flushed = false;
+        // Remember which nodes the outputs go to so they don't need to be looked up every cycle
+        auto& routes = graph->routes;
         component_.run_system<SynthOutput>([&](const ecs::Entity&, const SynthOutput& output) {
-            flush_output(output);
-            any_flushed = true;
+            synth::EjectorNode* ejector = wrapper_from_node(wrappers, output.parent).node->as_ejector();
+            if (ejector == nullptr) throw std::runtime_error("SynthOutput attached to a node which isn't an ejector.");
+            if (ejector->stream().channels() != synth::Samples::channels())
+                throw std::runtime_error("SynthOutput attached to an ejector with the wrong number of channels.");
+
+            route_for(routes, audio_buffer(output.stream_name)).ejectors.push_back(ejector);
         });
-        if (!any_flushed) flush_empty(duration);
+        for (auto& [_, bus] : buses_) route_for(routes, *bus);
+
+        try {
+            // Inputs are bound when the graph is swapped in, since the nodes may still be running in the latest graph
+            graph->runner.plan(wrappers);
+            graph->compiled = true;
+        } catch (const std::runtime_error& e) {
+            // Most likely the user has patched a cycle, nothing can run until it's removed
+            info(e.what());
+            graph->compiled = false;
+        }
+        return graph;
     }
 
-private:
-    void add_node(const SynthNode& node, synth::NodeWrappers& previous) {
-        auto& wrapper = wrappers_.id_wrapper_map[node.id];
+    void add_node(synth::NodeWrappers& wrappers, const SynthNode& node, synth::NodeWrappers& previous) {
+        auto& wrapper = wrappers.id_wrapper_map[node.id];
         wrapper.node = from_previous_or_spawn(node, previous);
         wrapper.outputs.resize(wrapper.node->num_outputs());
-        wrapper.node->reset_connections();
     }
 
-    void update_node_value(const SynthInput& input) {
-        auto& wrapper = wrapper_from_node(input.parent);
-        // TODO probably could get rid of this dynamic cast, but that'd add complexity
-        synth::InjectorNode& injector = *dynamic_cast<synth::InjectorNode*>(wrapper.node.get());
-        injector.set_value(input.value);
-    }
-
-    void add_connection(const SynthConnection& connection) {
-        auto& from = wrapper_from_node(connection.from);
+    void add_connection(synth::NodeWrappers& wrappers, const SynthConnection& connection) {
+        auto& from = wrapper_from_node(wrappers, connection.from);
         auto& outputs = from.outputs;
 
-        if (outputs.size() < connection.from_port)
+        if (outputs.size() <= connection.from_port)
             throw std::runtime_error("Not enough outputs defined to add connection.");
 
-        auto& to = wrapper_from_node(connection.to);
+        auto& to = wrapper_from_node(wrappers, connection.to);
+        if (connection.to_port >= to.node->num_inputs()) {
+            // A patch saved with more channels than it was loaded with can connect to Speaker inputs that don't exist
+            info("Skipping connection to input " << connection.to_port << " of " << to.node->name()
+                                                 << ", which only has " << to.node->num_inputs() << " inputs.");
+            return;
+        }
         outputs[connection.from_port].push_back({connection.to_port, to.node.get()});
-        to.node->connect(connection.to_port);
     }
 
-    void flush_output(const SynthOutput& output) {
-        auto& wrapper = wrapper_from_node(output.parent);
-        // TODO probably could get rid of this dynamic cast, but that'd add complexity
-        synth::EjectorNode& ejector = *dynamic_cast<synth::EjectorNode*>(wrapper.node.get());
-        for (float sample : ejector.stream().flush_new()) {
-            audio_buffer_.push(sample);
+    static Graph::Route& route_for(std::vector<Graph::Route>& routes, synth::ThreadSafeBuffer& bus) {
+        for (auto& route : routes) {
+            if (route.bus == &bus) return route;
         }
-    }
-
-    void flush_empty(const std::chrono::nanoseconds& duration) {
-        for (size_t i = 0; i < synth::Samples::samples_from_time(duration); ++i) audio_buffer_.push(0.f);
+        return routes.emplace_back(Graph::Route{&bus, {}});
     }
 
     ///
@@ -110,8 +416,10 @@ private:
         return std::move(wrapper.node);
     }
 
-    synth::NodeWrapper& wrapper_from_node(const ecs::Entity& entity) {
-        auto& wrapper = wrappers_.id_wrapper_map[component_.get<SynthNode>(entity).id];
+    size_t node_id(const ecs::Entity& entity) const { return component_.get<SynthNode>(entity).id; }
+
+    synth::NodeWrapper& wrapper_from_node(synth::NodeWrappers& wrappers, const ecs::Entity& entity) {
+        auto& wrapper = wrappers.id_wrapper_map[component_.get<SynthNode>(entity).id];
         if (wrapper.node == nullptr) throw std::runtime_error("Found a nullptr when updating node values.");
         return wrapper;
     }
@@ -120,12 +428,32 @@ private:
     const BlockLoader& loader_;
     ComponentManager component_;
 
-    synth::Runner runner_;
+    synth::ParameterQueue parameters_;
+
+    // Buses are only ever added, so the graphs can hold onto pointers to them
+    std::unordered_map<std::string, std::unique_ptr<synth::ThreadSafeBuffer>> buses_;
+    synth::ThreadSafeBuffer* main_bus_ = nullptr;
+
+    // Only used by update()
+    Topology topology_;
+    Topology next_topology_;
+    size_t rebuilds_ = 0;
+    Graph* latest_ = nullptr;
+    bool profiling_ = false;
+    size_t trace_events_ = 0;
+
+    // Hand off between update() and the audio side, each slot holds at most one graph
+    std::atomic<Graph*> pending_{nullptr};
+    std::atomic<Graph*> retired_{nullptr};
 
-    synth::ThreadSafeBuffer audio_buffer_;
+    // Only used by whatever is generating audio
+    Graph* active_ = nullptr;
+    std::vector<float> mix_;
 
-    synth::NodeWrappers wrappers_;
-    // TODO Stream support
-    // std::unordered_map<std::string, synth::Stream> streams_;
+    std::atomic<bool> shutdown_{true};
+    std::thread thread_;
+    std::mutex demand_mutex_;
+    std::condition_variable demand_;
+    std::atomic<bool> demanded_{false};
 };
 }  // namespace objects
@@ -8,6 +8,8 @@
 #include "objects/blocks/piano.hh"
 #include "objects/catenary.hh"
 #include "objects/components.hh"
+#include "synth/debug.hh"
+#include "synth/parameters.hh"
 
 namespace objects {
 //
@@ -16,7 +18,12 @@ namespace objects {
 
 class Manager : public engine::AbstractObjectManager {
 public:
-    Manager(const BlockLoader& loader, ComponentManager& components) : loader_(loader), components_(components) {
+    ///
+    /// @brief Value changes made through the UI are sent to the graph through the parameters queue, this object must be
+    /// the only thing pushing to it.
+    ///
+    Manager(const BlockLoader& loader, ComponentManager& components, synth::ParameterQueue& parameters)
+        : loader_(loader), components_(components), parameters_(parameters) {
         for (const std::string& texture_path : loader_.textures()) {
             box_renderer_.add_texture({texture_path});
         }
@@ -92,7 +99,7 @@ public:
         } else if (!event.any_modifiers()) {
             piano_.set_key(event.key, event.clicked);
             components_.run_system<Piano, SynthInput>(
-                [this](const ecs::Entity&, const Piano&, SynthInput& input) { input.value = piano_.as_float(); });
+                [this](const ecs::Entity&, const Piano&, SynthInput& input) { set_value(input, piano_.as_float()); });
         }
     }
 
@@ -165,7 +172,10 @@ private:
     void print_help() {
         auto names = loader_.names();
         for (size_t i = 0; i < names.size(); ++i) {
-            std::cout << "Press '" << (i + 1) << "' to spawn '" << names[i] << "'\n";
+            // Blocks are spawned with the keys from '1' up through the ASCII table (see the key handling above), which
+            // goes past '9' now that Pan and Stereo Mixer make more than nine blocks. Printing (i + 1) would say "10"
+            // and "11" for keys that are really ':' and ';'.
+            std::cout << "Press '" << static_cast<char>('1' + i) << "' to spawn '" << names[i] << "'\n";
         }
     }
 
@@ -235,13 +245,22 @@ private:
     }
 
     void rotate(const engine::MouseEvent& event, SynthInput& input) {
-        // Scale the changes back a bit
-        input.value += 0.05 * event.delta_position.y();
-        // And then clamp to be in the -1 to 1 range
-        input.value = std::clamp(input.value, -1.f, 1.f);
+        // Scale the changes back a bit and then clamp to be in the -1 to 1 range
+        set_value(input, std::clamp<float>(input.value + 0.05 * event.delta_position.y(), -1.f, 1.f));
     }
 
-    void set_alpha(SynthInput& input) { input.value = input.value > 0.5 ? 0.f : 1.f; }
+    void set_alpha(SynthInput& input) { set_value(input, input.value > 0.5 ? 0.f : 1.f); }
+
+    ///
+    /// @brief Update the component (which is what gets rendered and saved) and let the graph know about the change
+    ///
+    void set_value(SynthInput& input, float value) {
+        if (input.value == value) return;
+        input.value = value;
+        if (!parameters_.push(components_.get<SynthNode>(input.parent).id, value)) {
+            info("Parameter queue is full, dropping update.");
+        }
+    }
 
     ecs::Entity spawn_cable_from(const ecs::Entity& entity, const engine::MouseEvent& event) {
         const auto& box = components_.get<TexturedBox>(entity);
@@ -285,6 +304,7 @@ private:
 private:
     const BlockLoader& loader_;
     ComponentManager& components_;
+    synth::ParameterQueue& parameters_;
 
     engine::renderer::BoxRenderer box_renderer_;
     engine::renderer::LineRenderer line_renderer_;
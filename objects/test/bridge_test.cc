@@ -0,0 +1,307 @@
+#include "objects/bridge.hh"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <thread>
+
+#include "objects/blocks.hh"
+
+namespace objects {
+namespace {
+constexpr auto kDuration = std::chrono::milliseconds(10);
+
+struct Block {
+    ecs::Entity primary;
+    ecs::Entity input;  // only valid for blocks with a SynthInput
+};
+
+Block spawn_block(const BlockLoader& loader, ComponentManager& components, const std::string& name, size_t id) {
+    Spawn spawn = loader.get(name).spawn_entities(components);
+    auto& node = components.get<SynthNode>(spawn.primary);
+    node.name = name;
+    node.id = id;
+
+    Block block{spawn.primary, spawn.primary};
+    for (const auto& entity : spawn.entities) {
+        if (components.get_ptr<SynthInput>(entity)) block.input = entity;
+    }
+    return block;
+}
+
+std::vector<float> drain(synth::ThreadSafeBuffer& buffer) {
+    std::vector<float> samples(buffer.size());
+    samples.resize(buffer.read(samples));
+    return samples;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, incremental) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto speaker = spawn_block(loader, components, "Speaker", 1);
+    components.spawn(SynthConnection{knob.primary, 0, speaker.primary, 0});
+
+    components.get<SynthInput>(knob.input).value = 0.5;
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 1);
+
+    auto samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    for (float sample : samples) ASSERT_EQ(sample, 0.5);
+
+    // Changing a value goes through the parameter queue, which shouldn't need a rebuild. Knobs ramp to new values.
+    components.get<SynthInput>(knob.input).value = -0.25;
+    bridge.parameters().push(0, -0.25);
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 1);
+
+    samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    EXPECT_LT(samples.front(), 0.5);
+    for (size_t i = 1; i < samples.size(); ++i) ASSERT_LE(samples[i], samples[i - 1]);
+    EXPECT_EQ(samples.back(), -0.25);
+
+    // But changing the connections does
+    auto second = spawn_block(loader, components, "Knob", 2);
+    components.get<SynthInput>(second.input).value = 0.25;
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 2);
+    drain(bridge.audio_buffer());
+
+    components.spawn(SynthConnection{second.primary, 0, speaker.primary, 0});
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 3);
+
+    samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    for (float sample : samples) ASSERT_EQ(sample, 0.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, cycle) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+
+    auto first = spawn_block(loader, components, "Amplifier", 0);
+    auto second = spawn_block(loader, components, "Amplifier", 1);
+    components.spawn(SynthConnection{first.primary, 0, second.primary, 0});
+    auto cycle = components.spawn(SynthConnection{second.primary, 0, first.primary, 0});
+
+    // Nothing can run, so there should just be silence
+    bridge.process(kDuration);
+    auto samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    for (float sample : samples) ASSERT_EQ(sample, 0.0);
+
+    components.despawn(cycle);
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 2);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, audio_thread) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+    auto& audio = bridge.audio_buffer();
+
+    // Stands in for the lock the GUI holds while editing the components
+    std::mutex gui;
+
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto speaker = spawn_block(loader, components, "Speaker", 1);
+    components.spawn(SynthConnection{knob.primary, 0, speaker.primary, 0});
+    components.get<SynthInput>(knob.input).value = 0.5;
+    bridge.update();
+
+    constexpr auto kLatency = std::chrono::milliseconds(50);
+    bridge.start_thread(kLatency);
+    const size_t channels = synth::Samples::channels();
+    while (synth::Samples::time_from_samples(audio.size() / channels) < kLatency) std::this_thread::yield();
+
+    // Play back in real time, the same way the audio driver would
+    std::atomic<bool> done = false;
+    float last = 0.0;
+    std::thread playback{[&]() {
+        constexpr auto kPeriod = std::chrono::milliseconds(5);
+        std::vector<float> samples(channels * synth::Samples::samples_from_time(kPeriod));
+        auto next = std::chrono::steady_clock::now();
+        while (!done) {
+            next += kPeriod;
+            std::this_thread::sleep_until(next);
+            audio.read(samples);
+            last = samples.back();
+            bridge.notify();
+        }
+    }};
+
+    // Hold the lock for much longer than the latency, audio shouldn't care
+    {
+        std::lock_guard lock{gui};
+        std::this_thread::sleep_for(3 * kLatency);
+
+        auto second = spawn_block(loader, components, "Knob", 2);
+        components.get<SynthInput>(second.input).value = 0.25;
+        components.spawn(SynthConnection{second.primary, 0, speaker.primary, 0});
+        bridge.update();
+        std::this_thread::sleep_for(3 * kLatency);
+    }
+
+    done = true;
+    playback.join();
+    bridge.stop_thread();
+
+    EXPECT_EQ(bridge.rebuilds(), 2);
+    EXPECT_EQ(audio.underruns(), 0);
+    EXPECT_EQ(last, 0.75);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, pull) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+    auto& audio = bridge.audio_buffer();
+
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto speaker = spawn_block(loader, components, "Speaker", 1);
+    components.spawn(SynthConnection{knob.primary, 0, speaker.primary, 0});
+    components.get<SynthInput>(knob.input).value = 0.5;
+    bridge.update();
+
+    // Devices ask for all sorts of sizes, there should never be more than a batch left over. Each frame has a sample
+    // for every channel.
+    const size_t batch = synth::Samples::batch_size();
+    const size_t channels = synth::Samples::channels();
+    std::vector<float> samples(4 * batch * channels);
+    for (size_t frames : {size_t{1}, batch, batch + 1, 3 * batch - 7, 4 * batch, size_t{10}}) {
+        bridge.pull(frames);
+        EXPECT_GE(audio.size(), channels * frames);
+        EXPECT_LT(audio.size(), channels * (frames + batch));
+
+        const size_t count = channels * frames;
+        ASSERT_EQ(audio.read(synth::Span<float>{samples}.subspan(0, count)), count);
+        for (size_t i = 0; i < count; ++i) ASSERT_EQ(samples[i], 0.5);
+    }
+    EXPECT_EQ(audio.underruns(), 0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, stereo) {
+    ASSERT_EQ(synth::Samples::channels(), 2);
+
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+
+    // Hard right, so only the second channel should have anything in it
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto position = spawn_block(loader, components, "Knob", 1);
+    auto pan = spawn_block(loader, components, "Pan", 2);
+    auto speaker = spawn_block(loader, components, "Speaker", 3);
+    components.spawn(SynthConnection{knob.primary, 0, pan.primary, 0});
+    components.spawn(SynthConnection{position.primary, 0, pan.primary, 1});
+    components.spawn(SynthConnection{pan.primary, 0, speaker.primary, 0});
+    components.spawn(SynthConnection{pan.primary, 1, speaker.primary, 1});
+    components.get<SynthInput>(knob.input).value = 0.5;
+    components.get<SynthInput>(position.input).value = 1.0;
+
+    bridge.process(kDuration);
+    auto samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    ASSERT_EQ(samples.size() % 2, 0);
+    for (size_t i = 0; i < samples.size(); i += 2) {
+        ASSERT_NEAR(samples[i], 0.0, 1E-6);
+        ASSERT_NEAR(samples[i + 1], 0.5, 1E-6);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, missing_input) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+
+    // Like a patch saved with more channels than it was loaded with, the extra connection should just be ignored
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto extra = spawn_block(loader, components, "Knob", 1);
+    auto speaker = spawn_block(loader, components, "Speaker", 2);
+    components.spawn(SynthConnection{knob.primary, 0, speaker.primary, 0});
+    components.spawn(SynthConnection{extra.primary, 0, speaker.primary, synth::Samples::channels()});
+    components.get<SynthInput>(knob.input).value = 0.5;
+    components.get<SynthInput>(extra.input).value = 0.25;
+
+    ASSERT_NO_THROW(bridge.process(kDuration));
+    auto samples = drain(bridge.audio_buffer());
+    ASSERT_FALSE(samples.empty());
+    for (float sample : samples) ASSERT_EQ(sample, 0.5);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Bridge, buses) {
+    BlockLoader loader = default_loader();
+    Bridge bridge{loader};
+    auto& components = bridge.component_manager();
+
+    // Two speakers are mixed together, and a third is moved onto its own bus
+    auto knob = spawn_block(loader, components, "Knob", 0);
+    auto first = spawn_block(loader, components, "Speaker", 1);
+    auto second = spawn_block(loader, components, "Speaker", 2);
+    auto monitor = spawn_block(loader, components, "Speaker", 3);
+    components.spawn(SynthConnection{knob.primary, 0, first.primary, 0});
+    components.spawn(SynthConnection{knob.primary, 0, second.primary, 0});
+    components.spawn(SynthConnection{knob.primary, 0, monitor.primary, 0});
+    components.get<SynthInput>(knob.input).value = 0.25;
+    components.run_system<SynthOutput>([&](const ecs::Entity&, SynthOutput& output) {
+        if (output.parent == monitor.primary) output.stream_name = "/monitor";
+    });
+
+    bridge.process(kDuration);
+    auto speakers = drain(bridge.audio_buffer());
+    auto monitored = drain(bridge.audio_buffer("/monitor"));
+    ASSERT_FALSE(speakers.empty());
+    EXPECT_EQ(speakers.size(), monitored.size());
+    for (float sample : speakers) ASSERT_EQ(sample, 0.5);
+    for (float sample : monitored) ASSERT_EQ(sample, 0.25);
+
+    // Buses stay in step even once nothing is sent to them
+    components.run_system<SynthOutput>([&](const ecs::Entity&, SynthOutput& output) {
+        output.stream_name = blocks::Speaker::kStreamName;
+    });
+    bridge.process(kDuration);
+    EXPECT_EQ(bridge.rebuilds(), 2);
+    speakers = drain(bridge.audio_buffer());
+    monitored = drain(bridge.audio_buffer("/monitor"));
+    ASSERT_FALSE(speakers.empty());
+    EXPECT_EQ(speakers.size(), monitored.size());
+    for (float sample : speakers) ASSERT_EQ(sample, 0.75);
+    for (float sample : monitored) ASSERT_EQ(sample, 0.0);
+}
+}  // namespace objects
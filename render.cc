@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "objects/blocks.hh"
+#include "objects/bridge.hh"
+#include "objects/components.hh"
+#include "synth/debug.hh"
+#include "synth/file_writer.hh"
+
+///
+/// Renders a patch saved by objects::save() to a file as fast as possible, without an audio device or window:
+///
+///     bazel run -c opt //:render -- /tmp/save /tmp/out.wav --seconds=10
+///
+/// Output files ending in .wav are written as 32-bit float WAV, anything else as raw floats. Outputs which have been
+/// given a stream name other than the speakers' can be written to their own files with --bus=<stream name>:<path>.
+/// --profile prints how long each node took, and --profile=<path> also writes a trace for chrome://tracing or Perfetto.
+///
+
+namespace {
+struct Options {
+    std::string patch;
+    std::string output;
+    double seconds = 10.0;
+    synth::EngineConfig config;
+
+    // Stream name and path for each extra bus
+    std::vector<std::pair<std::string, std::string>> buses;
+
+    bool profile = false;
+    std::string trace;
+};
+
+///
+/// @brief The nodes which took the most time overall, one per line
+///
+void print_profile(const synth::Profile& profile) {
+    constexpr size_t kMaxNodes = 20;
+
+    std::vector<const synth::Profile::Node*> nodes;
+    for (const auto& node : profile.nodes) nodes.push_back(&node);
+    std::sort(nodes.begin(), nodes.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->timing.total() > rhs->timing.total();
+    });
+    if (nodes.size() > kMaxNodes) nodes.resize(kMaxNodes);
+
+    auto print = [](const std::string& name, const synth::Timing& timing) {
+        std::cout << "  " << name << ": min " << timing.min() << ", mean " << timing.mean() << ", p99 "
+                  << timing.percentile(0.99) << ", total " << timing.total() << "\n";
+    };
+    std::cout << "Batches (" << profile.batch.count() << "):\n";
+    print("Runner::next", profile.batch);
+    std::cout << "Nodes (" << profile.nodes.size() << ", " << profile.node_total() << " total):\n";
+    for (const auto* node : nodes) print(node->name, node->timing);
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const std::string seconds = "--seconds=";
+        const std::string bus = "--bus=";
+        const std::string profile = "--profile";
+        if (arg.compare(0, seconds.size(), seconds) == 0) {
+            options.seconds = std::stod(arg.substr(seconds.size()));
+        } else if (arg.compare(0, bus.size(), bus) == 0) {
+            const size_t split = arg.find(':', bus.size());
+            if (split == std::string::npos) throw std::runtime_error("Expected --bus=<stream name>:<path>, got " + arg);
+            options.buses.push_back({arg.substr(bus.size(), split - bus.size()), arg.substr(split + 1)});
+        } else if (arg.compare(0, profile.size(), profile) == 0) {
+            options.profile = true;
+            if (arg.size() > profile.size()) {
+                if (arg[profile.size()] != '=') throw std::runtime_error("Unknown argument: " + arg);
+                options.trace = arg.substr(profile.size() + 1);
+            }
+        } else if (arg.compare(0, 2, "--") == 0) {
+            if (!synth::parse_flag(arg, options.config)) throw std::runtime_error("Unknown argument: " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2) {
+        throw std::runtime_error("Usage: render <patch> <output.wav|output.raw> [--seconds=10] [--sample_rate=44000] "
+                                 "[--batch_size=128] [--channels=2] [--bus=<stream name>:<path>] "
+                                 "[--profile[=<trace.json>]]");
+    }
+    options.patch = positional[0];
+    options.output = positional[1];
+    return options;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    // Each one is a few dozen bytes, this is enough for a few seconds of a decent sized patch
+    constexpr size_t kTraceEvents = 1 << 20;
+
+    const Options options = parse_options(argc, argv);
+    synth::Samples::configure(options.config);
+
+    objects::BlockLoader loader = objects::default_loader();
+    objects::Bridge bridge{loader};
+    bridge.set_profiling(options.profile, options.trace.empty() ? 0 : kTraceEvents);
+    objects::load(options.patch, bridge.component_manager());
+
+    // Everything is counted in interleaved samples, a frame has one for each channel
+    const size_t channels = synth::Samples::channels();
+    const size_t total = channels * static_cast<size_t>(options.seconds * synth::Samples::sample_rate());
+    const auto writer_channels = static_cast<uint16_t>(channels);
+    synth::FileWriter writer{options.output, synth::FileWriter::format_from_path(options.output),
+                             synth::Samples::sample_rate(), writer_channels};
+
+    // Every bus is generated in step with the speakers, so each one is read the same amount
+    std::vector<std::pair<synth::ThreadSafeBuffer*, std::unique_ptr<synth::FileWriter>>> buses;
+    for (const auto& [name, path] : options.buses) {
+        auto bus_writer = std::make_unique<synth::FileWriter>(path, synth::FileWriter::format_from_path(path),
+                                                              synth::Samples::sample_rate(), writer_channels);
+        buses.emplace_back(&bridge.audio_buffer(name), std::move(bus_writer));
+    }
+
+    // Audio is pulled the same way the audio driver does it, just as fast as possible
+    constexpr auto kChunk = std::chrono::milliseconds(100);
+    auto& audio = bridge.audio_buffer();
+    std::vector<float> samples(channels * synth::Samples::samples_from_time(kChunk));
+    bridge.update();
+
+    const auto start = std::chrono::steady_clock::now();
+    while (writer.samples_written() < total) {
+        const size_t count = std::min(samples.size(), total - writer.samples_written());
+        bridge.pull(count / channels);
+
+        const size_t read = audio.read(synth::Span<float>{samples}.subspan(0, count));
+        writer.write(synth::Span<const float>{samples}.subspan(0, read));
+
+        for (auto& [bus, bus_writer] : buses) {
+            const size_t bus_read = bus->read(synth::Span<float>{samples}.subspan(0, count));
+            bus_writer->write(synth::Span<const float>{samples}.subspan(0, bus_read));
+        }
+    }
+    writer.close();
+    for (auto& [_, bus_writer] : buses) bus_writer->close();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const std::chrono::duration<double> rendered =
+        synth::Samples::time_from_samples(writer.samples_written() / channels);
+    std::cout << "Rendered " << rendered << " to " << options.output << " in " << elapsed << " ("
+              << rendered / elapsed << "x realtime)\n";
+
+    const synth::Runner::SkipStats skipped = bridge.skip_stats();
+    std::cout << "Skipped " << skipped.skipped << " of " << skipped.invocations << " node invocations ("
+              << skipped.skipped_per_second << " per second)\n";
+
+    if (options.profile) print_profile(bridge.profile());
+    if (!options.trace.empty()) {
+        std::ofstream trace{options.trace};
+        bridge.write_trace(trace);
+        std::cout << "Wrote a trace to " << options.trace << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -2,12 +2,16 @@
 
 #include <soundio/soundio.h>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 
+#include "synth/channels.hh"
 #include "synth/debug.hh"
+#include "synth/samples.hh"
 
 namespace synth {
 
@@ -15,7 +19,10 @@ namespace synth {
 // #############################################################################
 //
 
-AudioDriver::AudioDriver(ThreadSafeBuffer &buffer) : buffer_(buffer) {
+AudioDriver::AudioDriver(ThreadSafeBuffer &buffer, AudioCallbacks callbacks)
+    : buffer_(buffer),
+      callbacks_(std::move(callbacks)),
+      target_frames_(Samples::config().latency_batches * Samples::batch_size()) {
     soundio = soundio_create();
     if (!soundio) {
         throw std::runtime_error("soundio_create() failed, out of memory?");
@@ -54,18 +61,35 @@ AudioDriver::AudioDriver(ThreadSafeBuffer &buffer) : buffer_(buffer) {
     outstream->write_callback = write_callback;
     outstream->underflow_callback = underflow_callback;
     outstream->name = "test_stream";
-    outstream->software_latency = 0.0;
-    outstream->sample_rate = 44000;
+    outstream->software_latency = static_cast<double>(target_frames_) / Samples::sample_rate();
+    outstream->sample_rate = Samples::sample_rate();
+
+    if (!soundio_device_supports_sample_rate(device, outstream->sample_rate)) {
+        throw std::runtime_error("Device doesn't support a sample rate of " + std::to_string(outstream->sample_rate));
+    }
 
     if (!soundio_device_supports_format(device, SoundIoFormatFloat32NE)) {
         throw std::runtime_error("No audio support for float32!");
     }
     outstream->format = SoundIoFormatFloat32NE;
 
+    // Fall back to whatever the device has, write_frames() takes care of mapping onto it
+    const SoundIoChannelLayout *layout = soundio_channel_layout_get_default(Samples::channels());
+    if (layout && soundio_device_supports_layout(device, layout)) {
+        outstream->layout = *layout;
+    } else {
+        std::cout << "AudioDriver() Device doesn't support " << Samples::channels() << " channels, using "
+                  << device->current_layout.channel_count << "\n";
+        outstream->layout = device->current_layout;
+    }
+
     if (int err = soundio_outstream_open(outstream)) {
         throw std::runtime_error("soundio_outstream_open() unable to open stream");
     }
 
+    std::cout << "AudioDriver() Latency: " << latency() << " (requested "
+              << Samples::time_from_samples(target_frames_) << ")\n";
+
     if (outstream->layout_error)
         std::cerr << "Unable to set channel layout: " << soundio_strerror(outstream->layout_error) << "\n";
 
@@ -79,11 +103,10 @@ AudioDriver::AudioDriver(ThreadSafeBuffer &buffer) : buffer_(buffer) {
 //
 
 AudioDriver::~AudioDriver() {
-    soundio_outstream_destroy(outstream);
+    stop();
+
     soundio_device_unref(device);
     soundio_destroy(soundio);
-
-    stop_thread();
 }
 
 //
@@ -110,6 +133,7 @@ void AudioDriver::start_thread() {
 
 void AudioDriver::stop_thread() {
     shutdown_ = true;
+    if (soundio) soundio_wakeup(soundio);
     if (thread_.joinable()) thread_.join();
 }
 
@@ -117,21 +141,37 @@ void AudioDriver::stop_thread() {
 // #############################################################################
 //
 
-void AudioDriver::write_inputs(const float *input, size_t size) {
-    for (size_t i = 0; i < size; ++i) {
-        buffer_.push(input[i]);
-    }
+void AudioDriver::stop() {
+    // Destroying the stream joins the device's callback thread
+    if (outstream) soundio_outstream_destroy(outstream);
+    outstream = nullptr;
+
+    stop_thread();
 }
 
+//
+// #############################################################################
+//
+
+void AudioDriver::write_inputs(const float *input, size_t size) { buffer_.write(Span<const float>{input, size}); }
+
 ThreadSafeBuffer &AudioDriver::buffer() { return buffer_; }
 
+size_t AudioDriver::underflows() const { return underflows_.load(std::memory_order_relaxed); }
+
+std::chrono::nanoseconds AudioDriver::latency() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(outstream->software_latency));
+}
+
 //
 // #############################################################################
 //
 
-void AudioDriver::underflow_callback(SoundIoOutStream *) {
-    static int count = 0;
-    std::cerr << "Underflow: " << (count++) << "\n";
+void AudioDriver::underflow_callback(SoundIoOutStream *outstream) {
+    AudioDriver &instance = *reinterpret_cast<AudioDriver *>(outstream->userdata);
+    const size_t count = instance.underflows_.fetch_add(1, std::memory_order_relaxed) + 1;
+    throttled(1.f, "Underflow: " << count);
 }
 
 //
@@ -139,33 +179,41 @@ void AudioDriver::underflow_callback(SoundIoOutStream *) {
 //
 
 void AudioDriver::write_callback(SoundIoOutStream *outstream, int frame_count_min, int frame_count_max) {
-    (void)frame_count_min;
     AudioDriver &instance = *reinterpret_cast<AudioDriver *>(outstream->userdata);
 
-    int frame_count = frame_count_max;
+    // Only give the device what it needs to stay at the target latency, anything more just adds delay
+    int frame_count = std::clamp(static_cast<int>(instance.target_frames_), frame_count_min, frame_count_max);
 
     for (int frames_left = frame_count; frames_left > 0;) {
         SoundIoChannelArea *areas;
         if (int err = soundio_outstream_begin_write(outstream, &areas, &frame_count)) {
             throw std::runtime_error(std::string("Stream error: ") + soundio_strerror(err));
         }
-        const struct SoundIoChannelLayout *layout = &outstream->layout;
-
-        for (int frame = 0; frame < frame_count; frame++) {
-            float sample = 0.0;
-
-            static bool have_ever_gotten_data = false;
-            if (!instance.buffer_.pop(sample)) {
-                throttled(have_ever_gotten_data ? 1.f : 10.f, "No data left in buffer! " << frame);
-                sample = 0.0;
-            } else {
-                have_ever_gotten_data = true;
-            }
-
-            for (int channel = 0; channel < layout->channel_count; channel += 1) {
-                *reinterpret_cast<float *>(areas[channel].ptr) = sample;
-                areas[channel].ptr += areas[channel].step;
-            }
+
+        // Same layout, this just keeps libsoundio out of the copying code
+        std::array<ChannelArea, SOUNDIO_MAX_CHANNELS> channel_areas;
+        const Span<ChannelArea> device_channels{channel_areas.data(),
+                                                static_cast<size_t>(outstream->layout.channel_count)};
+        for (size_t c = 0; c < device_channels.size(); ++c) channel_areas[c] = {areas[c].ptr, areas[c].step};
+
+        if (instance.callbacks_.on_demand) instance.callbacks_.on_demand(frame_count);
+
+        // Read everything that's available in place, and then pad with silence if there wasn't enough
+        static bool have_ever_gotten_data = false;
+        const size_t channels = Samples::channels();
+        auto region = instance.buffer_.prepare_read(channels * frame_count);
+        write_frames(region.first, channels, device_channels);
+        write_frames(region.second, channels, device_channels);
+        instance.buffer_.commit_read(region.size());
+        if (instance.callbacks_.on_read) instance.callbacks_.on_read();
+
+        const size_t frames_read = region.size() / channels;
+        if (frames_read < static_cast<size_t>(frame_count)) {
+            throttled(have_ever_gotten_data ? 1.f : 10.f,
+                      "No data left in buffer! " << instance.buffer_.underruns() << " underruns so far");
+            write_silence(frame_count - frames_read, device_channels);
+        } else {
+            have_ever_gotten_data = true;
         }
 
         if (int err = soundio_outstream_end_write(outstream)) {
@@ -1,5 +1,7 @@
 #pragma once
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <thread>
 
 #include "synth/buffer.hh"
@@ -9,9 +11,31 @@ struct SoundIoDevice;
 struct SoundIoOutStream;
 
 namespace synth {
+
+///
+/// @brief Hooks called from the audio callback, these need to be real-time safe (no locks or allocations)
+///
+struct AudioCallbacks {
+    ///
+    /// @brief Called with the number of frames the device wants right before they're read from the buffer. This is
+    /// how audio is pulled from the graph, whatever is generating it should make sure at least that many are buffered.
+    ///
+    std::function<void(size_t frames)> on_demand;
+
+    ///
+    /// @brief Called each time samples have been taken out of the buffer, so whatever is filling it from another
+    /// thread can wake up.
+    ///
+    std::function<void()> on_read;
+};
+
 class AudioDriver {
 public:
-    AudioDriver(ThreadSafeBuffer &buffer);
+    ///
+    /// @brief The device is asked to keep Samples::config().latency_batches worth of audio queued, and is only given
+    /// about that much each callback.
+    ///
+    AudioDriver(ThreadSafeBuffer &buffer, AudioCallbacks callbacks = {});
     ~AudioDriver();
 
 public:
@@ -19,16 +43,28 @@ public:
     void start_thread();
     void stop_thread();
 
+    ///
+    /// @brief Stops the device and the event thread, after which no more callbacks are made. Should be called before
+    /// anything the callbacks use is torn down.
+    ///
+    void stop();
+
     void write_inputs(const float *input, size_t size);
 
     ThreadSafeBuffer &buffer();
 
+    /// Number of times the device ran out of samples to play, which are heard as clicks or dropouts
+    size_t underflows() const;
+
+    /// What the device actually settled on, which may be more than requested
+    std::chrono::nanoseconds latency() const;
+
 private:
-    static void underflow_callback(SoundIoOutStream *);
+    static void underflow_callback(SoundIoOutStream *outstream);
     static void write_callback(SoundIoOutStream *outstream, int frame_count_min, int frame_count_max);
 
 private:
-    bool shutdown_ = false;
+    std::atomic<bool> shutdown_ = false;
     std::thread thread_;
 
     SoundIo *soundio = nullptr;
@@ -36,5 +72,9 @@ private:
     SoundIoOutStream *outstream = nullptr;
 
     ThreadSafeBuffer &buffer_;
+    AudioCallbacks callbacks_;
+    size_t target_frames_ = 0;
+
+    std::atomic<size_t> underflows_{0};
 };
 }  // namespace synth
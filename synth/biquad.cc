@@ -1,17 +1,24 @@
 #include "synth/biquad.hh"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+
+#include "synth/kernels.hh"
 
 namespace synth {
 namespace {
 double compute_A(float gain) { return std::pow(10.0, gain / 40.0); }
-double compute_w(float f0) { return 2 * M_PI * f0 / Samples::kSampleRate; }
+double compute_w(float f0) { return 2 * M_PI * f0 / Samples::sample_rate(); }
 double compute_alpha(double w, float gain, float slope) {
     const double A = compute_A(gain);
     return 0.5 * std::sin(w) * std::sqrt((A + 1 / A) * (1 / slope - slope) + 2);
 }
+
+/// State smaller than this is inaudible, and flushing it keeps a decaying filter from ending up in denormals
+constexpr double kFlushToZero = 1E-30;
 }  // namespace
 
 //
@@ -77,7 +84,7 @@ BiQuadFilter::Coeff BiQuadFilter::coeff(const Type type, float f0, float gain, f
         case Type::kHpf:
             return high_pass_filter(f0, gain, slope);
         case Type::kLpf:
-            return high_pass_filter(f0, gain, slope);
+            return low_pass_filter(f0, gain, slope);
         default:
             throw std::runtime_error("Unknown coefficient type in BiQuadFilter::coeff()");
     }
@@ -96,24 +103,347 @@ void BiQuadFilter::set_coeff(const Type type, float f0, float gain, float slope)
 // #############################################################################
 //
 
+BiQuadFilter::Coeff BiQuadFilter::with_q(const Type type, float f0, double q) {
+    const double w = compute_w(f0);
+    const double alpha = std::sin(w) / (2.0 * q);
+    const double cos = std::cos(w);
+
+    Coeff coeff;
+    if (type == Type::kLpf) {
+        coeff.b1 = 1 - cos;
+        coeff.b0 = 0.5 * coeff.b1;
+    } else {
+        coeff.b1 = -(1 + cos);
+        coeff.b0 = -0.5 * coeff.b1;
+    }
+    coeff.b2 = coeff.b0;
+    coeff.a1 = -2 * cos;
+    coeff.a2 = 1 - alpha;
+
+    double inv_a0 = 1 / (1 + alpha);
+    coeff.b0 *= inv_a0;
+    coeff.b1 *= inv_a0;
+    coeff.b2 *= inv_a0;
+    coeff.a1 *= inv_a0;
+    coeff.a2 *= inv_a0;
+    return coeff;
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadFilter::reset() {
+    s1_ = 0.0;
+    s2_ = 0.0;
+}
+
+//
+// #############################################################################
+//
+
 float BiQuadFilter::process(float xn) {
-    const auto& [b0, b1, b2, a1, a2] = coeff_;
+    float yn = 0.f;
+    if (precision_ == Precision::kFloat) {
+        run<float>(&xn, &yn, 1);
+    } else {
+        run<double>(&xn, &yn, 1);
+    }
+    check_state("process");
+    return yn;
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadFilter::process_block(Span<const float> in, Span<float> out) {
+    if (in.size() != out.size()) throw std::runtime_error("BiQuadFilter::process_block() sizes don't match.");
 
-    double yn = b0 * xn + b1 * xn_1_ + b2 * xn_2_ - a1 * yn_1_ - a2 * yn_2_;
+    if (precision_ == Precision::kFloat) {
+        run<float>(in.data(), out.data(), in.size());
+    } else {
+        run<double>(in.data(), out.data(), in.size());
+    }
+    check_state("process_block");
+}
 
-    if (std::isnan(yn)) {
+//
+// #############################################################################
+//
+
+void BiQuadFilter::process_ramp(Span<const float> in, Span<float> out, const Coeff& target) {
+    if (in.size() != out.size()) throw std::runtime_error("BiQuadFilter::process_ramp() sizes don't match.");
+    if (in.size() == 0) return;
+
+    if (precision_ == Precision::kFloat) {
+        ramp<float>(in.data(), out.data(), in.size(), target);
+    } else {
+        ramp<double>(in.data(), out.data(), in.size(), target);
+    }
+    coeff_ = target;
+    check_state("process_ramp");
+}
+
+//
+// #############################################################################
+//
+
+template <typename T>
+void BiQuadFilter::run(const float* in, float* out, size_t size) {
+    const T b0 = coeff_.b0;
+    const T b1 = coeff_.b1;
+    const T b2 = coeff_.b2;
+    const T a1 = coeff_.a1;
+    const T a2 = coeff_.a2;
+
+    T s1 = s1_;
+    T s2 = s2_;
+    for (size_t i = 0; i < size; ++i) {
+        const T xn = in[i];
+        const T yn = b0 * xn + s1;
+        s1 = b1 * xn - a1 * yn + s2;
+        s2 = b2 * xn - a2 * yn;
+        out[i] = static_cast<float>(yn);
+    }
+    s1_ = s1;
+    s2_ = s2;
+}
+
+//
+// #############################################################################
+//
+
+template <typename T>
+void BiQuadFilter::ramp(const float* in, float* out, size_t size, const Coeff& target) {
+    // Each step is taken before the sample is filtered, so the last sample is filtered with the target
+    const T scale = T{1} / static_cast<T>(size);
+    const T db0 = (target.b0 - coeff_.b0) * scale;
+    const T db1 = (target.b1 - coeff_.b1) * scale;
+    const T db2 = (target.b2 - coeff_.b2) * scale;
+    const T da1 = (target.a1 - coeff_.a1) * scale;
+    const T da2 = (target.a2 - coeff_.a2) * scale;
+
+    T b0 = coeff_.b0;
+    T b1 = coeff_.b1;
+    T b2 = coeff_.b2;
+    T a1 = coeff_.a1;
+    T a2 = coeff_.a2;
+
+    T s1 = s1_;
+    T s2 = s2_;
+    for (size_t i = 0; i < size; ++i) {
+        b0 += db0;
+        b1 += db1;
+        b2 += db2;
+        a1 += da1;
+        a2 += da2;
+
+        const T xn = in[i];
+        const T yn = b0 * xn + s1;
+        s1 = b1 * xn - a1 * yn + s2;
+        s2 = b2 * xn - a2 * yn;
+        out[i] = static_cast<float>(yn);
+    }
+    s1_ = s1;
+    s2_ = s2;
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadFilter::check_state(const char* function) {
+    // Anything which went wrong in the block ends up in the state, so only it needs to be looked at
+    if (std::isnan(s1_) || std::isnan(s2_)) {
         std::stringstream ss;
-        ss << "BiQuadFilter::process() found nan! ";
-        ss << "xn: " << xn << ", xn_1: " << xn_1_ << ", xn_2: " << xn_2_ << ", yn: " << yn << ", yn_1: " << yn_1_
-           << ", yn_2: " << yn_2_;
-        ss << "b0: " << b0 << ", b1: " << b1 << ", b2: " << b2 << ", a1: " << a1 << ", a2: " << a2;
+        ss << "BiQuadFilter::" << function << "() found nan! ";
+        ss << "s1: " << s1_ << ", s2: " << s2_ << ", ";
+        ss << "b0: " << coeff_.b0 << ", b1: " << coeff_.b1 << ", b2: " << coeff_.b2 << ", a1: " << coeff_.a1
+           << ", a2: " << coeff_.a2;
+        reset();
         throw std::runtime_error(ss.str());
     }
 
-    xn_2_ = xn_1_;
-    yn_2_ = yn_1_;
-    xn_1_ = xn;
-    yn_1_ = yn;
-    return yn;
+    if (std::abs(s1_) < kFlushToZero) s1_ = 0.0;
+    if (std::abs(s2_) < kFlushToZero) s2_ = 0.0;
+}
+
+//
+// #############################################################################
+//
+
+BiQuadTable::BiQuadTable(BiQuadFilter::Type type, float f_min, float f_max, float gain, float slope) {
+    for (size_t i = 0; i < kSize; ++i) {
+        const double f0 = f_min + (f_max - f_min) * static_cast<double>(i) / (kSize - 1);
+        coeffs_[i] = BiQuadFilter::coeff(type, f0, gain, slope);
+    }
+}
+
+//
+// #############################################################################
+//
+
+BiQuadFilter::Coeff BiQuadTable::at(float fraction) const {
+    const double position = std::clamp(fraction, 0.f, 1.f) * static_cast<double>(kSize - 1);
+    const size_t index = std::min(static_cast<size_t>(position), kSize - 2);
+    const double t = position - index;
+
+    const BiQuadFilter::Coeff& lhs = coeffs_[index];
+    const BiQuadFilter::Coeff& rhs = coeffs_[index + 1];
+    BiQuadFilter::Coeff coeff;
+    coeff.b0 = lhs.b0 + t * (rhs.b0 - lhs.b0);
+    coeff.b1 = lhs.b1 + t * (rhs.b1 - lhs.b1);
+    coeff.b2 = lhs.b2 + t * (rhs.b2 - lhs.b2);
+    coeff.a1 = lhs.a1 + t * (rhs.a1 - lhs.a1);
+    coeff.a2 = lhs.a2 + t * (rhs.a2 - lhs.a2);
+    return coeff;
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadCascade::set_butterworth(BiQuadFilter::Type type, size_t order, float f0) {
+    if (order == 0 || order % 2 != 0 || order > 2 * kMaxSections)
+        throw std::runtime_error("BiQuadCascade::set_butterworth() needs an even order up to 8.");
+
+    // The poles are spread evenly around the unit circle, each conjugate pair makes one section
+    size_ = order / 2;
+    for (size_t k = 0; k < size_; ++k) {
+        const double q = 1.0 / (2.0 * std::cos((2.0 * k + 1.0) * M_PI / (2.0 * order)));
+        sections_[k].set_coeff(BiQuadFilter::with_q(type, f0, q));
+    }
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadCascade::set_sections(Span<const BiQuadFilter::Coeff> sections) {
+    if (sections.size() > kMaxSections) throw std::runtime_error("BiQuadCascade::set_sections() too many sections.");
+
+    size_ = sections.size();
+    for (size_t i = 0; i < size_; ++i) sections_[i].set_coeff(sections[i]);
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadCascade::set_precision(BiQuadFilter::Precision precision) {
+    for (BiQuadFilter& section : sections_) section.set_precision(precision);
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadCascade::reset() {
+    for (BiQuadFilter& section : sections_) section.reset();
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadCascade::process_block(Span<const float> in, Span<float> out) {
+    if (in.size() != out.size()) throw std::runtime_error("BiQuadCascade::process_block() sizes don't match.");
+    if (size_ == 0) {
+        if (in.data() != out.data()) std::copy(in.begin(), in.end(), out.begin());
+        return;
+    }
+
+    // The first section reads the input, the rest filter the output in place
+    sections_[0].process_block(in, out);
+    for (size_t i = 1; i < size_; ++i) sections_[i].process_block(out, out);
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadBank::reserve(size_t filters) {
+    channels_.reserve(filters);
+    data_.resize(kGroup * Samples::kMaxBatchSize);
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadBank::clear() { channels_.clear(); }
+
+//
+// #############################################################################
+//
+
+void BiQuadBank::add(BiQuadFilter& filter, const float* input, float* output) {
+    if (channels_.size() == channels_.capacity()) throw std::runtime_error("BiQuadBank::add() is full.");
+    channels_.push_back({&filter, input, output});
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadBank::process(size_t size) {
+    if (size > Samples::kMaxBatchSize) throw std::runtime_error("BiQuadBank::process() size is too large.");
+
+    for (size_t begin = 0; begin < channels_.size(); begin += kGroup) {
+        process_group(begin, std::min(begin + kGroup, channels_.size()), size);
+    }
+
+    // Only once every filter has its state back, so one bad filter doesn't leave the rest behind
+    for (const Channel& channel : channels_) channel.filter->check_state("process_block");
+}
+
+//
+// #############################################################################
+//
+
+void BiQuadBank::process_group(size_t begin, size_t end, size_t size) {
+    const size_t used = end - begin;
+    const size_t lanes = (used + kLanes - 1) / kLanes * kLanes;
+    const Channel* channels = &channels_[begin];
+
+    // Padding is a filter with no coefficients and no state. Its samples are whatever was left over from before (which
+    // are never read back), since filling them in costs about as much as filtering them.
+    for (size_t c = 0; c < lanes; ++c) {
+        const BiQuadFilter* filter = c < used ? channels[c].filter : nullptr;
+        const BiQuadFilter::Coeff coeff = filter ? filter->coeff_ : BiQuadFilter::Coeff{0.0, 0.0, 0.0, 0.0, 0.0};
+        coeff_[c] = coeff.b0;
+        coeff_[lanes + c] = coeff.b1;
+        coeff_[2 * lanes + c] = coeff.b2;
+        coeff_[3 * lanes + c] = coeff.a1;
+        coeff_[4 * lanes + c] = coeff.a2;
+        state_[c] = filter ? filter->s1_ : 0.0;
+        state_[lanes + c] = filter ? filter->s2_ : 0.0;
+    }
+
+    // A tile of samples at a time, so each filter's buffer is only touched one cache line at a time. Sample buffers
+    // tend to be a multiple of 4KB apart, and walking all of them at once would keep evicting each other from cache.
+    for (size_t tile = 0; tile < size; tile += kTile) {
+        const size_t tile_end = std::min(tile + kTile, size);
+        for (size_t c = 0; c < used; ++c) {
+            const float* input = channels[c].input;
+            for (size_t i = tile; i < tile_end; ++i) data_[i * lanes + c] = input[i];
+        }
+    }
+
+    const kernels::Table& kernels = size == Samples::batch_size() ? Samples::batch_kernels() : kernels::best();
+    kernels.biquad(data_.data(), state_.data(), coeff_.data(), lanes, size);
+
+    for (size_t tile = 0; tile < size; tile += kTile) {
+        const size_t tile_end = std::min(tile + kTile, size);
+        for (size_t c = 0; c < used; ++c) {
+            float* output = channels[c].output;
+            for (size_t i = tile; i < tile_end; ++i) output[i] = data_[i * lanes + c];
+        }
+    }
+    for (size_t c = 0; c < used; ++c) {
+        channels[c].filter->s1_ = state_[c];
+        channels[c].filter->s2_ = state_[lanes + c];
+    }
 }
 }  // namespace synth
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+#include <vector>
+
 #include "synth/samples.hh"
+#include "synth/span.hh"
 
 ///
 /// @brief An implementation of a BiQuad filter to operate on samples
@@ -8,6 +12,8 @@
 ///
 
 namespace synth {
+class BiQuadBank;
+
 class BiQuadFilter {
 public:
     struct Coeff {
@@ -22,22 +28,209 @@ public:
 
     enum class Type : uint8_t { kLpf = 0, kHpf = 1 };
 
+    ///
+    /// @brief What the filter runs in. Double is the safe default, float is cheaper and fine for anything that isn't
+    /// cut very low relative to the sample rate.
+    ///
+    enum class Precision : uint8_t { kDouble = 0, kFloat = 1 };
+
 public:
     static Coeff low_pass_filter(float f0, float gain, float slope);
     static Coeff high_pass_filter(float f0, float gain, float slope);
 
     static Coeff coeff(const Type type, float f0, float gain, float slope);
 
+    ///
+    /// @brief Plain second order section with the given Q, which is what cascades are built from
+    ///
+    static Coeff with_q(const Type type, float f0, double q);
+
 public:
     void set_coeff(const Coeff& coeff);
     void set_coeff(const Type type, float f0, float gain, float slope);
+    const Coeff& get_coeff() const { return coeff_; }
+
+    void set_precision(Precision precision) { precision_ = precision; }
+
+    /// Forget the previous samples, as if the filter had only ever seen silence
+    void reset();
+
+    /// True once the state has decayed to nothing, from then on silence in is silence out
+    bool settled() const { return s1_ == 0.0 && s2_ == 0.0; }
+
     float process(float xn);
 
+    ///
+    /// @brief Filter a block of samples (in and out can be the same buffer, but shouldn't otherwise overlap). The
+    /// state lives in registers for the whole block, and is only checked for NaN (which throws) and flushed of
+    /// denormals once at the end.
+    ///
+    void process_block(Span<const float> in, Span<float> out);
+
+    ///
+    /// @brief Same as process_block(), but the coefficients move linearly from the current ones to target over the
+    /// block (landing on it with the last sample). This is how a modulated filter can update its coefficients at a
+    /// fraction of the sample rate without the steps being audible.
+    ///
+    void process_ramp(Span<const float> in, Span<float> out, const Coeff& target);
+
+private:
+    template <typename T>
+    void run(const float* in, float* out, size_t size);
+
+    template <typename T>
+    void ramp(const float* in, float* out, size_t size, const Coeff& target);
+
+    void check_state(const char* function);
+
+    // The bank runs the same recursion, it just needs to move the state in and out
+    friend class BiQuadBank;
+
+private:
+    // Passes everything straight through until it's set
+    Coeff coeff_{1.0, 0.0, 0.0, 0.0, 0.0};
+    Precision precision_ = Precision::kDouble;
+
+    // Transposed direct form II, which only needs two values of state
+    double s1_ = 0.0;
+    double s2_ = 0.0;
+};
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Coefficients for cutoffs across a fixed range worked out ahead of time, so that a filter whose cutoff keeps
+/// moving doesn't need a handful of trig functions each time it does. Entries are spaced evenly in Hz and linearly
+/// interpolated, which is within about 1E-5 of the real coefficients with the default size. This doesn't allocate.
+///
+class BiQuadTable {
+public:
+    static constexpr size_t kSize = 256;
+
+    BiQuadTable(BiQuadFilter::Type type, float f_min, float f_max, float gain, float slope);
+
+    ///
+    /// @brief Coefficients at f_min + fraction * (f_max - f_min), with the fraction clamped to [0, 1]
+    ///
+    BiQuadFilter::Coeff at(float fraction) const;
+
+private:
+    std::array<BiQuadFilter::Coeff, kSize> coeffs_;
+};
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Higher order filters as a chain of second order sections, which is much better behaved numerically than a
+/// single high order section. Every section runs over the whole block before the next one starts.
+///
+class BiQuadCascade {
+public:
+    /// Enough for an 8th order filter
+    static constexpr size_t kMaxSections = 4;
+
+    ///
+    /// @brief Butterworth response (maximally flat) of the given order, which must be even and at most
+    /// 2 * kMaxSections. Nothing is allocated, so this is fine to call from the audio thread.
+    ///
+    void set_butterworth(BiQuadFilter::Type type, size_t order, float f0);
+
+    void set_sections(Span<const BiQuadFilter::Coeff> sections);
+    size_t sections() const { return size_; }
+
+    void set_precision(BiQuadFilter::Precision precision);
+    void reset();
+
+    /// Same as BiQuadFilter::process_block(), run through each section in turn
+    void process_block(Span<const float> in, Span<float> out);
+
 private:
-    Coeff coeff_;
-    double xn_1_ = 0.f;
-    double xn_2_ = 0.f;
-    double yn_1_ = 0.f;
-    double yn_2_ = 0.f;
+    std::array<BiQuadFilter, kMaxSections> sections_;
+    size_t size_ = 0;
+};
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Runs a lot of independent filters over the same number of samples at once. The coefficients and state are
+/// packed struct of arrays style so that every SIMD instruction advances 4, 8 or 16 filters (depending on the CPU),
+/// instead of each filter waiting on its own recursion. The filters still own their coefficients and state, which are
+/// copied in when they're added and written back by process().
+///
+class BiQuadBank {
+public:
+    ///
+    /// @brief Make room for this many filters, after which add() and process() don't allocate
+    ///
+    void reserve(size_t filters);
+
+    void clear();
+    size_t size() const { return channels_.size(); }
+
+    ///
+    /// @brief Filter input into output the next time process() is called. These can be the same buffer, but the output
+    /// shouldn't overlap the input of any other filter. This throws if more filters are added than were reserved.
+    ///
+    void add(BiQuadFilter& filter, const float* input, float* output);
+
+    ///
+    /// @brief Run every filter added since the last clear() over size samples (at most Samples::kMaxBatchSize). Like
+    /// BiQuadFilter::process_block() the state is checked for NaN (which throws) and flushed of denormals at the end.
+    /// NOTE: The bank always runs in float, whatever precision the filters are set to.
+    ///
+    void process(size_t size);
+
+private:
+    ///
+    /// @brief Filters are interleaved this many at a time so the samples being worked on stay in cache, with the last
+    /// group padded out to a multiple of kLanes (the widest vector) by filters which only ever see silence.
+    ///
+    static constexpr size_t kGroup = 32;
+    static constexpr size_t kLanes = 16;
+
+    /// Samples per filter moved in or out of the group at a time, one cache line
+    static constexpr size_t kTile = 16;
+
+    void process_group(size_t begin, size_t end, size_t size);
+
+private:
+    struct Channel {
+        BiQuadFilter* filter;
+        const float* input;
+        float* output;
+    };
+    std::vector<Channel> channels_;
+
+    // Laid out the way kernels::biquad() wants them for one group
+    std::array<float, 5 * kGroup> coeff_;
+    std::array<float, 2 * kGroup> state_;
+    std::vector<float> data_;
+};
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Something (usually a node) whose work each batch is a single BiQuadFilter from one buffer to another, so that
+/// it can be run in a BiQuadBank alongside others of its kind.
+///
+class BiQuadNode {
+public:
+    virtual ~BiQuadNode() = default;
+
+    ///
+    /// @brief Set the filter up for the next batch and add it to the bank, which needs to be done after the inputs
+    /// are ready. Returns false without adding anything if the batch can't be run with a single set of coefficients,
+    /// in which case it should be run as it normally would. Since the bank writes the output directly, any flags on it
+    /// (see Samples::silent) need to be cleared here.
+    ///
+    virtual bool add_to(BiQuadBank& bank) = 0;
 };
 }  // namespace synth
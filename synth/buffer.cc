@@ -1,5 +1,6 @@
 #include "synth/buffer.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -9,24 +10,61 @@ namespace synth {
 // #############################################################################
 //
 
-ThreadSafeBuffer::ThreadSafeBuffer(size_t buffer_size) : entries_(std::vector<float>(buffer_size)) {}
+ThreadSafeBuffer::ThreadSafeBuffer(size_t buffer_size) : entries_(std::vector<float>(buffer_size)) {
+    if (buffer_size == 0) throw std::runtime_error("ThreadSafeBuffer() needs a non-zero size.");
+}
+
+//
+// #############################################################################
+//
+
+bool ThreadSafeBuffer::push(float entry) { return write(Span<const float>{&entry, 1}) == 1; }
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::write(Span<const float> from) {
+    auto to = prepare_write(from.size());
+    std::copy(from.begin(), from.begin() + to.first.size(), to.first.begin());
+    std::copy(from.begin() + to.first.size(), from.begin() + to.size(), to.second.begin());
+    commit_write(to.size());
+    return to.size();
+}
+
+//
+// #############################################################################
+//
+
+ThreadSafeBuffer::Region<float> ThreadSafeBuffer::prepare_write(size_t count) {
+    const size_t available = writable(count);
+    if (available < count) {
+        overruns_.fetch_add(count - available, std::memory_order_relaxed);
+        count = available;
+    }
+    return region<float>(write_.load(std::memory_order_relaxed), count);
+}
 
 //
 // #############################################################################
 //
 
-void ThreadSafeBuffer::push(float entry) { entries_[(write_++) % entries_.size()] = entry; }
+void ThreadSafeBuffer::commit_write(size_t count) {
+    // Release so the entries written above are visible to the reader before the new head is
+    write_.store(write_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
 
 //
 // #############################################################################
 //
 
 bool ThreadSafeBuffer::pop(float& to) {
-    // Get the current write state. Note that writes may happen after we load this, but we'll ignore them for this pop
-    if (size() == 0) {
+    // Polling an empty buffer is expected, so this doesn't go through prepare_read()
+    if (readable(1) == 0) {
         return false;
     }
-    to = blind_pop();
+    to = entries_[read_.load(std::memory_order_relaxed) % entries_.size()];
+    commit_read(1);
     return true;
 }
 
@@ -34,10 +72,43 @@ bool ThreadSafeBuffer::pop(float& to) {
 // #############################################################################
 //
 
-float ThreadSafeBuffer::blind_pop() {
-    // NOTE: Here is where problems arise if the read and write heads are too close and accessed concurrently (since it
-    // could overwrite this entry).
-    return entries_[read_++ % entries_.size()];
+size_t ThreadSafeBuffer::read(Span<float> to) {
+    auto from = prepare_read(to.size());
+    auto end = std::copy(from.first.begin(), from.first.end(), to.begin());
+    std::copy(from.second.begin(), from.second.end(), end);
+    commit_read(from.size());
+    return from.size();
+}
+
+//
+// #############################################################################
+//
+
+ThreadSafeBuffer::Region<const float> ThreadSafeBuffer::prepare_read(size_t count) {
+    const size_t available = readable(count);
+    if (available < count) {
+        underruns_.fetch_add(count - available, std::memory_order_relaxed);
+        count = available;
+    }
+    return region<const float>(read_.load(std::memory_order_relaxed), count);
+}
+
+//
+// #############################################################################
+//
+
+void ThreadSafeBuffer::commit_read(size_t count) {
+    // Release so the writer doesn't reuse these entries until we're done reading them
+    read_.store(read_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+//
+// #############################################################################
+//
+
+void ThreadSafeBuffer::clear() {
+    cached_write_ = write_.load(std::memory_order_acquire);
+    read_.store(cached_write_, std::memory_order_release);
 }
 
 //
@@ -56,5 +127,64 @@ std::string ThreadSafeBuffer::print() const {
 // #############################################################################
 //
 
-size_t ThreadSafeBuffer::size() const { return write_.load() - read_; }
+size_t ThreadSafeBuffer::size() const {
+    // Read head first, since the write head can only move further ahead of it
+    const uint64_t read = read_.load(std::memory_order_acquire);
+    return write_.load(std::memory_order_acquire) - read;
+}
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::capacity() const { return entries_.size(); }
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::writable(size_t count) {
+    const uint64_t write = write_.load(std::memory_order_relaxed);
+    if (write + count > cached_read_ + entries_.size()) {
+        // Acquire so the reader is done with any entries it has released
+        cached_read_ = read_.load(std::memory_order_acquire);
+    }
+    return entries_.size() - (write - cached_read_);
+}
+
+//
+// #############################################################################
+//
+
+size_t ThreadSafeBuffer::readable(size_t count) {
+    const uint64_t read = read_.load(std::memory_order_relaxed);
+    if (read + count > cached_write_) {
+        // Acquire so the entries the writer has committed are visible
+        cached_write_ = write_.load(std::memory_order_acquire);
+    }
+    return cached_write_ - read;
+}
+
+//
+// #############################################################################
+//
+
+template <typename T>
+ThreadSafeBuffer::Region<T> ThreadSafeBuffer::region(uint64_t head, size_t count) {
+    const size_t offset = head % entries_.size();
+    const size_t first = std::min(count, entries_.size() - offset);
+    return {{entries_.data() + offset, first}, {entries_.data(), count - first}};
+}
 }  // namespace synth
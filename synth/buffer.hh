@@ -2,15 +2,35 @@
 #include <atomic>
 #include <cstddef>
 #include <optional>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "synth/span.hh"
+
 namespace synth {
 
 ///
-/// @brief Simple circular buffer for single producer single consumer type access where writes and reads can happen
-/// concurrently as long as the buffer isn't close to capacity.
+/// @brief Lock-free circular buffer for single producer single consumer access. One thread may write (push(), write(),
+/// prepare_write()/commit_write()) while another concurrently reads (pop(), read(), prepare_read()/commit_read()).
+///
+/// Nothing is ever overwritten. Writes which don't fit are dropped and counted as overruns, reads which ask for more
+/// than is available are counted as underruns. Both counters are in samples.
 ///
 class ThreadSafeBuffer {
+public:
+    ///
+    /// @brief Part of the ring which can be accessed in place. Since the ring wraps around, this is made of up to two
+    /// contiguous spans which should be used in order (second will be empty if the region doesn't wrap).
+    ///
+    template <typename T>
+    struct Region {
+        Span<T> first;
+        Span<T> second;
+
+        size_t size() const { return first.size() + second.size(); }
+    };
+
 public:
     explicit ThreadSafeBuffer(size_t buffer_size);
 
@@ -22,28 +42,71 @@ public:
 
 public:
     ///
-    /// @brief Add new entries to the buffer or remove all of the current entries.
-    /// NOTE: These are okay to call concurrently provided the buffer has plenty of extra space.
+    /// @brief Producer side. push() returns false and write() returns less than requested if the buffer was full.
+    ///
+    bool push(float from);
+    size_t write(Span<const float> from);
+
+    ///
+    /// @brief Get up to count free entries to write to in place, which are made visible to the reader by
+    /// commit_write(). Anything requested past the free space is counted as an overrun.
+    ///
+    Region<float> prepare_write(size_t count);
+    void commit_write(size_t count);
+
+    ///
+    /// @brief Consumer side. pop() returns false if the buffer was empty (which isn't considered an underrun), read()
+    /// returns how many entries were actually read.
     ///
-    void push(float from);
     bool pop(float& to);
-    float blind_pop();
+    size_t read(Span<float> to);
+
+    ///
+    /// @brief Get up to count entries to read in place, which are released back to the writer by commit_read().
+    /// Anything requested past the available entries is counted as an underrun.
+    ///
+    Region<const float> prepare_read(size_t count);
+    void commit_read(size_t count);
+
+    /// Drop everything currently buffered, should be called from the reading thread
+    void clear();
 
 public:
     // Not thread safe
     std::string print() const;
 
-    // Okay if called from the reading thread
+    // Okay if called from either thread, although it may be out of date by the time it returns
     size_t size() const;
+    size_t capacity() const;
+
+    size_t overruns() const;
+    size_t underruns() const;
 
 private:
+    /// How much space there is to write or read, the cached heads are only refreshed if there isn't room for count
+    size_t writable(size_t count);
+    size_t readable(size_t count);
+
+    template <typename T>
+    Region<T> region(uint64_t head, size_t count);
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
     /// Main data store, this vector isn't resized after construction so it's safe to keep pointers
     std::vector<float> entries_;
 
-    /// Write and read heads in the entries vector. The write head will be accessed from the write and read threads
-    /// (possibly simultaneously) so it needs to be atomic, but the read head is only accessed from the read thread
-    std::atomic<uint64_t> write_{0};
-    uint64_t read_{0};
+    /// Write and read heads, these only ever increase and are wrapped when indexing into entries_. Each is on its own
+    /// cache line along with the state only its owning thread touches so the two threads don't fight over lines.
+    /// The cached heads are each thread's last view of the other head, which only needs to be reloaded when the
+    /// cached value says the buffer is full (or empty).
+    alignas(kCacheLine) std::atomic<uint64_t> write_{0};
+    uint64_t cached_read_ = 0;
+    std::atomic<uint64_t> overruns_{0};
+
+    alignas(kCacheLine) std::atomic<uint64_t> read_{0};
+    uint64_t cached_write_ = 0;
+    std::atomic<uint64_t> underruns_{0};
 };
 
 //
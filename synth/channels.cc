@@ -0,0 +1,56 @@
+#include "synth/channels.hh"
+
+#include <cstring>
+
+namespace synth {
+namespace {
+bool interleaved(size_t channels, Span<const ChannelArea> areas) {
+    if (areas.size() != channels) return false;
+    for (size_t c = 0; c < areas.size(); ++c) {
+        if (static_cast<size_t>(areas[c].step) != channels * sizeof(float)) return false;
+        if (areas[c].ptr != areas[0].ptr + c * sizeof(float)) return false;
+    }
+    return true;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+void write_frames(Span<const float> frames, size_t channels, Span<ChannelArea> areas) {
+    const size_t count = frames.size() / channels;
+
+    if (interleaved(channels, areas)) {
+        std::memcpy(areas[0].ptr, frames.data(), count * channels * sizeof(float));
+        for (ChannelArea& area : areas) area.ptr += count * area.step;
+        return;
+    }
+
+    for (size_t c = 0; c < areas.size(); ++c) {
+        ChannelArea& area = areas[c];
+        if (channels > 1 && c >= channels) {
+            write_silence(count, areas.subspan(c, 1));
+            continue;
+        }
+
+        const float* source = frames.data() + (channels == 1 ? 0 : c);
+        for (size_t frame = 0; frame < count; ++frame, source += channels, area.ptr += area.step) {
+            std::memcpy(area.ptr, source, sizeof(float));
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+void write_silence(size_t frames, Span<ChannelArea> areas) {
+    constexpr float kZero = 0.f;
+    for (ChannelArea& area : areas) {
+        for (size_t frame = 0; frame < frames; ++frame, area.ptr += area.step) {
+            std::memcpy(area.ptr, &kZero, sizeof(float));
+        }
+    }
+}
+}  // namespace synth
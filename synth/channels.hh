@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+#include "synth/span.hh"
+
+namespace synth {
+
+///
+/// @brief Where to write one of the audio device's channels, this has the same layout as libsoundio's
+/// SoundIoChannelArea. Each frame is step bytes after the previous one.
+///
+struct ChannelArea {
+    char* ptr;
+    int step;
+};
+
+///
+/// @brief Copy interleaved frames (with the given number of channels) into the device's channels, advancing each area
+/// past what was written. When the device's channels are interleaved the same way this is a single copy.
+///
+/// Device channels past the ones in the frames are silent, unless the frames are mono in which case they're played on
+/// every device channel.
+///
+void write_frames(Span<const float> frames, size_t channels, Span<ChannelArea> areas);
+
+///
+/// @brief Write the given number of silent frames to every one of the device's channels
+///
+void write_silence(size_t frames, Span<ChannelArea> areas);
+}  // namespace synth
@@ -1,31 +1,36 @@
 #pragma once
+#include <chrono>
 #include <iostream>
-#include <sstream>
 
-//#define DEBUG_MODE
+#include "synth/log.hh"
 
-#define info(s) std::cerr << __FILE__ << ":" << __LINE__ << " " << __FUNCTION__ << "(...) [INFO]: " << s << "\n"
+//#define DEBUG_MODE
 
+///
+/// Messages below this level are compiled out entirely, their arguments are still type checked but never evaluated
+///
+#ifndef SYNTH_LOG_LEVEL
 #ifdef DEBUG_MODE
-#define debug(s) std::cerr << __FILE__ << ":" << __LINE__ << " " << __FUNCTION__ << "(...) [DEBUG]: " << s << "\n"
+#define SYNTH_LOG_LEVEL 0
 #else
-#define debug(stream)         \
-    do {                      \
-        std::stringstream ss; \
-        ss << stream;         \
-    } while (false)
+#define SYNTH_LOG_LEVEL 1
+#endif
 #endif
 
-#define throttled(rate, s)                                                                                         \
-    do {                                                                                                           \
-        static auto start = std::chrono::steady_clock::now();                                                      \
-        auto now = std::chrono::steady_clock::now();                                                               \
-        if (now - start > std::chrono::duration<float>(rate)) {                                                    \
-            std::cerr << __FILE__ << ":" << __LINE__ << " " << __FUNCTION__ << "(...) [THROTTLED]: " << s << "\n"; \
-            start = now;                                                                                           \
-        }                                                                                                          \
+#define SYNTH_LOG(level, throttle, s)                                                    \
+    do {                                                                                 \
+        if constexpr (static_cast<int>(level) >= SYNTH_LOG_LEVEL) {                      \
+            static ::synth::log::Site log_site{__FILE__, __LINE__, __FUNCTION__, level}; \
+            ::synth::log::Entry(log_site, static_cast<float>(throttle)) << s;            \
+        }                                                                                \
     } while (false)
 
+#define debug(s) SYNTH_LOG(::synth::log::Level::kDebug, 0.f, s)
+#define info(s) SYNTH_LOG(::synth::log::Level::kInfo, 0.f, s)
+
+/// At most one message every rate seconds from each call site, the rest are counted and dropped
+#define throttled(rate, s) SYNTH_LOG(::synth::log::Level::kWarning, rate, s)
+
 template <typename Repr, typename Period>
 std::ostream& operator<<(std::ostream& os, const std::chrono::duration<Repr, Period>& d) {
     using namespace std::chrono;
@@ -0,0 +1,122 @@
+#include "synth/file_writer.hh"
+
+#include <stdexcept>
+#include <string>
+
+namespace synth {
+namespace {
+// WAVE_FORMAT_IEEE_FLOAT
+constexpr uint16_t kFloatFormat = 3;
+constexpr uint16_t kBitsPerSample = 32;
+
+// Where the sizes live in the header: after the RIFF header (12 bytes) and fmt chunk (26 bytes) comes the fact chunk
+// (12 bytes) and then the data chunk header
+constexpr std::streamoff kRiffSizeOffset = 4;
+constexpr std::streamoff kFactOffset = 12 + 26;
+constexpr std::streamoff kFramesOffset = kFactOffset + 8;
+constexpr std::streamoff kDataSizeOffset = kFactOffset + 12 + 4;
+constexpr std::streamoff kHeaderSize = kDataSizeOffset + 4;
+
+void write_le(std::ofstream& file, uint32_t value, size_t bytes) {
+    for (size_t byte = 0; byte < bytes; ++byte) file.put(static_cast<char>((value >> (8 * byte)) & 0xFF));
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+FileWriter::Format FileWriter::format_from_path(const std::filesystem::path& path) {
+    return path.extension() == ".wav" ? Format::kWav : Format::kRaw;
+}
+
+//
+// #############################################################################
+//
+
+FileWriter::FileWriter(const std::filesystem::path& path, Format format, uint64_t sample_rate, uint16_t channels)
+    : format_(format), sample_rate_(sample_rate), channels_(channels) {
+    if (channels_ == 0) throw std::runtime_error("FileWriter() needs at least one channel.");
+
+    file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) throw std::runtime_error("FileWriter() unable to open " + path.string());
+
+    if (format_ == Format::kWav) write_header();
+}
+
+//
+// #############################################################################
+//
+
+FileWriter::~FileWriter() { close(); }
+
+//
+// #############################################################################
+//
+
+void FileWriter::write(Span<const float> samples) {
+    if (!file_.is_open()) throw std::runtime_error("FileWriter::write() called after close().");
+
+    // WAV is little endian, which matches everything we build for
+    file_.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+    samples_written_ += samples.size();
+}
+
+//
+// #############################################################################
+//
+
+void FileWriter::close() {
+    if (!file_.is_open()) return;
+
+    if (format_ == Format::kWav) {
+        const uint32_t data_size = samples_written_ * sizeof(float);
+
+        file_.seekp(kRiffSizeOffset);
+        write_le(file_, kHeaderSize - 8 + data_size, 4);
+        file_.seekp(kFramesOffset);
+        write_le(file_, samples_written_ / channels_, 4);
+        file_.seekp(kDataSizeOffset);
+        write_le(file_, data_size, 4);
+    }
+
+    file_.close();
+}
+
+//
+// #############################################################################
+//
+
+size_t FileWriter::samples_written() const { return samples_written_; }
+
+//
+// #############################################################################
+//
+
+void FileWriter::write_header() {
+    const uint32_t bytes_per_frame = channels_ * kBitsPerSample / 8;
+
+    // Sizes are filled in by close()
+    file_.write("RIFF", 4);
+    write_le(file_, 0, 4);
+    file_.write("WAVE", 4);
+
+    file_.write("fmt ", 4);
+    write_le(file_, 18, 4);
+    write_le(file_, kFloatFormat, 2);
+    write_le(file_, channels_, 2);
+    write_le(file_, sample_rate_, 4);
+    write_le(file_, sample_rate_ * bytes_per_frame, 4);
+    write_le(file_, bytes_per_frame, 2);
+    write_le(file_, kBitsPerSample, 2);
+    write_le(file_, 0, 2);  // no extension
+
+    // Non-PCM formats are supposed to include the number of frames
+    file_.write("fact", 4);
+    write_le(file_, 4, 4);
+    write_le(file_, 0, 4);
+
+    file_.write("data", 4);
+    write_le(file_, 0, 4);
+}
+}  // namespace synth
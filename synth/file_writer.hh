@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#include "synth/span.hh"
+
+namespace synth {
+
+///
+/// @brief Streams float samples to disk, either as a 32-bit float WAV file or as raw native endian floats. The WAV
+/// header is written up front and then patched with the final sizes when the writer is closed (or destroyed).
+///
+class FileWriter {
+public:
+    enum class Format { kWav, kRaw };
+
+    /// Files ending in .wav are written as WAV, anything else is raw
+    static Format format_from_path(const std::filesystem::path& path);
+
+public:
+    FileWriter(const std::filesystem::path& path, Format format, uint64_t sample_rate, uint16_t channels = 1);
+    ~FileWriter();
+
+    FileWriter(const FileWriter& rhs) = delete;
+    FileWriter(FileWriter&& rhs) = delete;
+    FileWriter& operator=(const FileWriter& rhs) = delete;
+    FileWriter& operator=(FileWriter&& rhs) = delete;
+
+public:
+    ///
+    /// @brief Samples should be interleaved if there are multiple channels
+    ///
+    void write(Span<const float> samples);
+
+    ///
+    /// @brief Finish writing the file, nothing can be written after this
+    ///
+    void close();
+
+    size_t samples_written() const;
+
+private:
+    void write_header();
+
+private:
+    Format format_;
+    uint64_t sample_rate_;
+    uint16_t channels_;
+
+    std::ofstream file_;
+    size_t samples_written_ = 0;
+};
+}  // namespace synth
@@ -0,0 +1,92 @@
+#include "synth/kernels.hh"
+
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels {
+namespace {
+struct Scalar {
+    using V = float;
+    static constexpr size_t kWidth = 1;
+
+    static V load(const float* p) { return *p; }
+    static void store(float* p, V v) { *p = v; }
+    static V set1(float f) { return f; }
+
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V fmadd(V a, V b, V c) { return a * b + c; }
+    static V min(V a, V b) { return a < b ? a : b; }
+    static V max(V a, V b) { return a > b ? a : b; }
+};
+}  // namespace
+
+//
+// #############################################################################
+//
+
+const Table& scalar() { return *detail::table_for_size<Scalar>("scalar", 0); }
+
+//
+// #############################################################################
+//
+
+std::vector<const Table*> available() { return available(0); }
+
+//
+// #############################################################################
+//
+
+std::vector<const Table*> available(size_t size) {
+    std::vector<const Table*> tables{detail::table_for_size<Scalar>("scalar", size)};
+
+    // Ordered from least to most preferred
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) tables.push_back(detail::sse2(size));
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) tables.push_back(detail::avx2(size));
+    if (__builtin_cpu_supports("avx512f")) tables.push_back(detail::avx512(size));
+#endif
+
+    return tables;
+}
+
+//
+// #############################################################################
+//
+
+const Table& best() {
+    static const Table& table = *available().back();
+    return table;
+}
+
+//
+// #############################################################################
+//
+
+const Table& best(size_t size) { return *available(size).back(); }
+
+//
+// #############################################################################
+//
+
+void fill(float* out, float value, size_t size) { best().fill(out, value, size); }
+void add(float* out, const float* in, float weight, size_t size) { best().add(out, in, weight, size); }
+void multiply(float* out, const float* lhs, const float* rhs, float scale, size_t size) {
+    best().multiply(out, lhs, rhs, scale, size);
+}
+void multiply_add(float* out, const float* lhs, const float* rhs, size_t size) {
+    best().multiply_add(out, lhs, rhs, size);
+}
+void scale(float* out, const float* in, float gain, size_t size) { best().scale(out, in, gain, size); }
+void clamp(float* out, const float* in, float min, float max, size_t size) { best().clamp(out, in, min, max, size); }
+void remap(float* out, const float* in, float from_min, float from_max, float to_min, float to_max, size_t size) {
+    best().remap(out, in, from_min, from_max, to_min, to_max, size);
+}
+void crossfade(float* out, const float* lhs, const float* rhs, const float* mix, size_t size) {
+    best().crossfade(out, lhs, rhs, mix, size);
+}
+void biquad(float* data, float* state, const float* coeff, size_t channels, size_t size) {
+    best().biquad(data, state, coeff, channels, size);
+}
+}  // namespace synth::kernels
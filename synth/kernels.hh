@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+///
+/// @brief Vectorized versions of the operations that get applied to entire batches of samples. The best implementation
+/// for the current CPU is picked the first time any of the kernels are called (AVX-512, AVX2, SSE2 or a portable
+/// fallback).
+///
+
+namespace synth::kernels {
+
+/// out[i] = value
+void fill(float* out, float value, size_t size);
+
+/// out[i] += weight * in[i]
+void add(float* out, const float* in, float weight, size_t size);
+
+/// out[i] = scale * lhs[i] * rhs[i]
+void multiply(float* out, const float* lhs, const float* rhs, float scale, size_t size);
+
+/// out[i] += lhs[i] * rhs[i]
+void multiply_add(float* out, const float* lhs, const float* rhs, size_t size);
+
+/// out[i] = gain * in[i]
+void scale(float* out, const float* in, float gain, size_t size);
+
+/// out[i] = min(max(in[i], min), max)
+void clamp(float* out, const float* in, float min, float max, size_t size);
+
+/// Clamp to [from_min, from_max] then linearly map that range onto [to_min, to_max]
+void remap(float* out, const float* in, float from_min, float from_max, float to_min, float to_max, size_t size);
+
+/// out[i] = (1 - mix[i]) * lhs[i] + mix[i] * rhs[i]
+void crossfade(float* out, const float* lhs, const float* rhs, const float* mix, size_t size);
+
+///
+/// @brief One transposed direct form II biquad per channel, run across the channels so each instruction advances as
+/// many filters as the vector is wide. data is size frames of channels interleaved samples and is filtered in place.
+/// coeff is b0, b1, b2, a1 and a2 one after the other (channels floats each), state is s1 then s2 (the same) and is
+/// updated.
+///
+void biquad(float* data, float* state, const float* coeff, size_t channels, size_t size);
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Each instruction set provides one of these
+///
+struct Table {
+    const char* name;
+
+    decltype(&kernels::fill) fill;
+    decltype(&kernels::add) add;
+    decltype(&kernels::multiply) multiply;
+    decltype(&kernels::multiply_add) multiply_add;
+    decltype(&kernels::scale) scale;
+    decltype(&kernels::clamp) clamp;
+    decltype(&kernels::remap) remap;
+    decltype(&kernels::crossfade) crossfade;
+    decltype(&kernels::biquad) biquad;
+};
+
+/// The implementation used by the free functions above
+const Table& best();
+
+///
+/// @brief Same as best(), but common sizes get a version specialized so the loop bounds are known at compile time.
+/// NOTE: The kernels in the returned table must only be called with exactly this many elements.
+///
+const Table& best(size_t size);
+
+/// The portable implementation, always available
+const Table& scalar();
+
+/// Every implementation this CPU can run (optionally specialized by size), mostly useful for testing and benchmarking
+std::vector<const Table*> available();
+std::vector<const Table*> available(size_t size);
+}  // namespace synth::kernels
@@ -0,0 +1,49 @@
+#include "synth/kernels.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+namespace {
+struct Avx2 {
+    using V = __m256;
+    static constexpr size_t kWidth = 8;
+
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float f) { return _mm256_set1_ps(f); }
+
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+};
+}  // namespace
+
+const Table* avx2(size_t size) { return table_for_size<Avx2>("avx2", size); }
+}  // namespace synth::kernels::detail
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#else
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+const Table* avx2(size_t) { return nullptr; }
+}  // namespace synth::kernels::detail
+#endif
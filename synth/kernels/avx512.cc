@@ -0,0 +1,54 @@
+#include "synth/kernels.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+// GCC's min/max intrinsics trip this on their undefined passthrough argument
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+namespace {
+struct Avx512 {
+    using V = __m512;
+    static constexpr size_t kWidth = 16;
+
+    static V load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(float f) { return _mm512_set1_ps(f); }
+
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    static V min(V a, V b) { return _mm512_min_ps(a, b); }
+    static V max(V a, V b) { return _mm512_max_ps(a, b); }
+};
+}  // namespace
+
+const Table* avx512(size_t size) { return table_for_size<Avx512>("avx512", size); }
+}  // namespace synth::kernels::detail
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+#else
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+const Table* avx512(size_t) { return nullptr; }
+}  // namespace synth::kernels::detail
+#endif
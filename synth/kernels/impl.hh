@@ -0,0 +1,257 @@
+#pragma once
+#include <cstddef>
+
+#include "synth/kernels.hh"
+
+///
+/// @brief Generic implementation of each kernel. Ops provides the vector type and operations for an instruction set:
+///     using V;                       // vector type
+///     static constexpr size_t kWidth // floats per vector
+///     load(const float*), store(float*, V), set1(float)
+///     add(V, V), sub(V, V), mul(V, V), fmadd(a, b, c) (a * b + c), min(V, V), max(V, V)
+///
+/// Each kernel can also be specialized for a fixed size (kFixed != 0), in which case the size argument is ignored and
+/// the loop bounds are known at compile time. kFixed = 0 handles any size.
+///
+/// NOTE: Each instruction set is compiled in its own translation unit with different target flags. To make sure the
+/// linker never mixes instantiations between them, Ops should always be declared in an anonymous namespace and nothing
+/// in here should call out to (inline) functions that aren't templated on Ops.
+///
+
+namespace synth::kernels::detail {
+
+/// Fixed sizes which are a multiple of the vector width don't need the scalar loop at the end
+template <typename Ops, size_t kFixed>
+constexpr bool has_tail() {
+    return kFixed == 0 || kFixed % Ops::kWidth != 0;
+}
+
+template <typename Ops, size_t kFixed>
+void fill(float* out, float value, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const auto v = Ops::set1(value);
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth) Ops::store(out + i, v);
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] = value;
+}
+
+template <typename Ops, size_t kFixed>
+void add(float* out, const float* in, float weight, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const auto w = Ops::set1(weight);
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth)
+        Ops::store(out + i, Ops::fmadd(Ops::load(in + i), w, Ops::load(out + i)));
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] += weight * in[i];
+}
+
+template <typename Ops, size_t kFixed>
+void multiply(float* out, const float* lhs, const float* rhs, float scale, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const auto s = Ops::set1(scale);
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth)
+        Ops::store(out + i, Ops::mul(Ops::mul(Ops::load(lhs + i), Ops::load(rhs + i)), s));
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] = lhs[i] * rhs[i] * scale;
+}
+
+template <typename Ops, size_t kFixed>
+void multiply_add(float* out, const float* lhs, const float* rhs, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth)
+        Ops::store(out + i, Ops::fmadd(Ops::load(lhs + i), Ops::load(rhs + i), Ops::load(out + i)));
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] += lhs[i] * rhs[i];
+}
+
+template <typename Ops, size_t kFixed>
+void scale(float* out, const float* in, float gain, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const auto g = Ops::set1(gain);
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth) Ops::store(out + i, Ops::mul(Ops::load(in + i), g));
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] = in[i] * gain;
+}
+
+template <typename Ops, size_t kFixed>
+void clamp(float* out, const float* in, float min, float max, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const auto lo = Ops::set1(min);
+    const auto hi = Ops::set1(max);
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth)
+        Ops::store(out + i, Ops::max(Ops::min(Ops::load(in + i), hi), lo));
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] = in[i] < min ? min : (in[i] > max ? max : in[i]);
+}
+
+template <typename Ops, size_t kFixed>
+void remap(float* out, const float* in, float from_min, float from_max, float to_min, float to_max, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    const float ratio = (to_max - to_min) / (from_max - from_min);
+    const auto lo = Ops::set1(from_min);
+    const auto hi = Ops::set1(from_max);
+    const auto r = Ops::set1(ratio);
+    const auto offset = Ops::set1(to_min);
+
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth) {
+        const auto clamped = Ops::max(Ops::min(Ops::load(in + i), hi), lo);
+        Ops::store(out + i, Ops::fmadd(Ops::sub(clamped, lo), r, offset));
+    }
+    if constexpr (has_tail<Ops, kFixed>()) {
+        for (; i < n; ++i) {
+            const float clamped = in[i] < from_min ? from_min : (in[i] > from_max ? from_max : in[i]);
+            out[i] = (clamped - from_min) * ratio + to_min;
+        }
+    }
+}
+
+template <typename Ops, size_t kFixed>
+void crossfade(float* out, const float* lhs, const float* rhs, const float* mix, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    size_t i = 0;
+    for (; i + Ops::kWidth <= n; i += Ops::kWidth) {
+        const auto l = Ops::load(lhs + i);
+        Ops::store(out + i, Ops::fmadd(Ops::sub(Ops::load(rhs + i), l), Ops::load(mix + i), l));
+    }
+    if constexpr (has_tail<Ops, kFixed>())
+        for (; i < n; ++i) out[i] = (rhs[i] - lhs[i]) * mix[i] + lhs[i];
+}
+
+///
+/// @brief kVectors vectors worth of channels from the start of each frame. The recursion has a long dependency chain
+/// per sample, so running a few independent vectors at once keeps the FMA units busy.
+///
+template <typename Ops, size_t kVectors>
+void biquad_vectors(float* data, float* state, const float* coeff, size_t channels, size_t size) {
+    using V = typename Ops::V;
+    constexpr size_t kWidth = Ops::kWidth;
+    const V zero = Ops::set1(0.f);
+
+    V b0[kVectors], b1[kVectors], b2[kVectors], na1[kVectors], na2[kVectors], s1[kVectors], s2[kVectors];
+    for (size_t v = 0; v < kVectors; ++v) {
+        b0[v] = Ops::load(coeff + v * kWidth);
+        b1[v] = Ops::load(coeff + channels + v * kWidth);
+        b2[v] = Ops::load(coeff + 2 * channels + v * kWidth);
+        na1[v] = Ops::sub(zero, Ops::load(coeff + 3 * channels + v * kWidth));
+        na2[v] = Ops::sub(zero, Ops::load(coeff + 4 * channels + v * kWidth));
+        s1[v] = Ops::load(state + v * kWidth);
+        s2[v] = Ops::load(state + channels + v * kWidth);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        float* frame = data + i * channels;
+        for (size_t v = 0; v < kVectors; ++v) {
+            const V x = Ops::load(frame + v * kWidth);
+            const V y = Ops::fmadd(b0[v], x, s1[v]);
+            s1[v] = Ops::fmadd(na1[v], y, Ops::fmadd(b1[v], x, s2[v]));
+            s2[v] = Ops::fmadd(na2[v], y, Ops::mul(b2[v], x));
+            Ops::store(frame + v * kWidth, y);
+        }
+    }
+
+    for (size_t v = 0; v < kVectors; ++v) {
+        Ops::store(state + v * kWidth, s1[v]);
+        Ops::store(state + channels + v * kWidth, s2[v]);
+    }
+}
+
+template <typename Ops, size_t kFixed>
+void biquad(float* data, float* state, const float* coeff, size_t channels, size_t size) {
+    const size_t n = kFixed == 0 ? size : kFixed;
+    constexpr size_t kWidth = Ops::kWidth;
+    constexpr size_t kVectors = 4;
+
+    size_t c = 0;
+    for (; c + kVectors * kWidth <= channels; c += kVectors * kWidth)
+        biquad_vectors<Ops, kVectors>(data + c, state + c, coeff + c, channels, n);
+    for (; c + 2 * kWidth <= channels; c += 2 * kWidth)
+        biquad_vectors<Ops, 2>(data + c, state + c, coeff + c, channels, n);
+    for (; c + kWidth <= channels; c += kWidth) biquad_vectors<Ops, 1>(data + c, state + c, coeff + c, channels, n);
+
+    // Whatever doesn't fill a vector
+    for (; c < channels; ++c) {
+        const float b0 = coeff[c];
+        const float b1 = coeff[channels + c];
+        const float b2 = coeff[2 * channels + c];
+        const float a1 = coeff[3 * channels + c];
+        const float a2 = coeff[4 * channels + c];
+        float s1 = state[c];
+        float s2 = state[channels + c];
+        for (size_t i = 0; i < n; ++i) {
+            const float x = data[i * channels + c];
+            const float y = b0 * x + s1;
+            s1 = b1 * x - a1 * y + s2;
+            s2 = b2 * x - a2 * y;
+            data[i * channels + c] = y;
+        }
+        state[c] = s1;
+        state[channels + c] = s2;
+    }
+}
+
+//
+// #############################################################################
+//
+
+template <typename Ops, size_t kFixed>
+Table make_table(const char* name) {
+    Table table;
+    table.name = name;
+    table.fill = &fill<Ops, kFixed>;
+    table.add = &add<Ops, kFixed>;
+    table.multiply = &multiply<Ops, kFixed>;
+    table.multiply_add = &multiply_add<Ops, kFixed>;
+    table.scale = &scale<Ops, kFixed>;
+    table.clamp = &clamp<Ops, kFixed>;
+    table.remap = &remap<Ops, kFixed>;
+    table.crossfade = &crossfade<Ops, kFixed>;
+    table.biquad = &biquad<Ops, kFixed>;
+    return table;
+}
+
+///
+/// @brief Get the table specialized for the given size, or the general one (size = 0 or an uncommon size)
+///
+template <typename Ops>
+const Table* table_for_size(const char* name, size_t size) {
+    static const Table kGeneral = make_table<Ops, 0>(name);
+    static const Table k32 = make_table<Ops, 32>(name);
+    static const Table k64 = make_table<Ops, 64>(name);
+    static const Table k128 = make_table<Ops, 128>(name);
+    static const Table k256 = make_table<Ops, 256>(name);
+    static const Table k512 = make_table<Ops, 512>(name);
+    static const Table k1024 = make_table<Ops, 1024>(name);
+
+    switch (size) {
+        case 32:
+            return &k32;
+        case 64:
+            return &k64;
+        case 128:
+            return &k128;
+        case 256:
+            return &k256;
+        case 512:
+            return &k512;
+        case 1024:
+            return &k1024;
+        default:
+            return &kGeneral;
+    }
+}
+
+///
+/// @brief Defined by each instruction set, see table_for_size() for the size argument. These will return nullptr if
+/// the instruction set wasn't compiled in, and should only be called once the CPU has been checked for support.
+///
+const Table* sse2(size_t size);
+const Table* avx2(size_t size);
+const Table* avx512(size_t size);
+}  // namespace synth::kernels::detail
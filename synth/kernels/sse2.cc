@@ -0,0 +1,49 @@
+#include "synth/kernels.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+namespace {
+struct Sse2 {
+    using V = __m128;
+    static constexpr size_t kWidth = 4;
+
+    static V load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float f) { return _mm_set1_ps(f); }
+
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+};
+}  // namespace
+
+const Table* sse2(size_t size) { return table_for_size<Sse2>("sse2", size); }
+}  // namespace synth::kernels::detail
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#else
+#include "synth/kernels/impl.hh"
+
+namespace synth::kernels::detail {
+const Table* sse2(size_t) { return nullptr; }
+}  // namespace synth::kernels::detail
+#endif
@@ -0,0 +1,294 @@
+#include "synth/log.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "synth/debug.hh"
+
+namespace synth::log {
+namespace {
+
+///
+/// @brief Bounded lock-free queue with any number of producers and a single consumer (the background thread). Each
+/// slot has a sequence number which says whether it's ready to be written or read for the current lap of the ring.
+///
+class Ring {
+public:
+    explicit Ring(size_t capacity) : slots_(capacity) {
+        for (size_t i = 0; i < capacity; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const Record& record) {
+        uint64_t position = tail_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true) {
+            slot = &slots_[position % slots_.size()];
+            const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<int64_t>(sequence - position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+            } else if (difference < 0) {
+                // The reader hasn't gotten to this slot from the last lap yet, so the ring is full
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->record = record;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Record& record) {
+        Slot& slot = slots_[head_ % slots_.size()];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) return false;
+
+        record = slot.record;
+        slot.sequence.store(head_ + slots_.size(), std::memory_order_release);
+        head_++;
+        popped_.store(head_, std::memory_order_release);
+        return true;
+    }
+
+    /// Number of messages which have been claimed by producers, and the number the consumer has taken out
+    uint64_t pushed() const { return tail_.load(std::memory_order_acquire); }
+    uint64_t popped() const { return popped_.load(std::memory_order_acquire); }
+
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    struct alignas(kCacheLine) Slot {
+        std::atomic<uint64_t> sequence{0};
+        Record record;
+    };
+    std::vector<Slot> slots_;
+
+    alignas(kCacheLine) std::atomic<uint64_t> tail_{0};
+    std::atomic<size_t> dropped_{0};
+
+    alignas(kCacheLine) uint64_t head_ = 0;
+    std::atomic<uint64_t> popped_{0};
+};
+
+//
+// #############################################################################
+//
+
+const char* level_name(Level level) {
+    switch (level) {
+        case Level::kDebug:
+            return "DEBUG";
+        case Level::kInfo:
+            return "INFO";
+        case Level::kWarning:
+            return "WARNING";
+    }
+    return "UNKNOWN";
+}
+
+std::string format(const Record& record) {
+    const Site& site = *record.site;
+
+    std::stringstream ss;
+    ss << site.file << ":" << site.line << " " << site.function << "(...) [" << level_name(site.level) << "]: ";
+    for (size_t i = 0; i < record.num_args; ++i) {
+        const Record::Arg& arg = record.args[i];
+        switch (arg.type) {
+            case Record::Arg::Type::kText:
+                ss << std::string_view{record.text.data() + arg.text.offset, arg.text.size};
+                break;
+            case Record::Arg::Type::kSigned:
+                ss << arg.i;
+                break;
+            case Record::Arg::Type::kUnsigned:
+                ss << arg.u;
+                break;
+            case Record::Arg::Type::kFloat:
+                ss << arg.d;
+                break;
+            case Record::Arg::Type::kDuration:
+                ss << std::chrono::nanoseconds{arg.i};
+                break;
+        }
+    }
+    if (site.suppressed > 0) ss << " (" << site.suppressed << " more since the last one)";
+    return ss.str();
+}
+
+//
+// #############################################################################
+//
+
+///
+/// @brief The ring and the thread which drains it. There's one of these for the whole process, started during static
+/// initialization (see kStarted below).
+///
+class Logger {
+public:
+    Logger() : ring_(kCapacity) {
+        thread_ = std::thread([this]() {
+            while (!shutdown_.load(std::memory_order_acquire)) {
+                drain();
+                std::this_thread::sleep_for(kPeriod);
+            }
+            drain();
+        });
+    }
+
+    ~Logger() {
+        shutdown_.store(true, std::memory_order_release);
+        if (thread_.joinable()) thread_.join();
+    }
+
+public:
+    Ring& ring() { return ring_; }
+
+    void set_sink(std::function<void(const std::string&)> sink) {
+        std::lock_guard lock{sink_mutex_};
+        sink_ = std::move(sink);
+    }
+
+    void flush() {
+        // Anything claimed by now will be written once the background thread has caught up to it
+        const uint64_t target = ring_.pushed();
+        while (ring_.popped() < target && !shutdown_.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(kPeriod / 10);
+        }
+
+        // The sink is called with the lock held, so this makes sure the last message has been written too
+        std::lock_guard lock{sink_mutex_};
+    }
+
+private:
+    void drain() {
+        Record record;
+        while (ring_.pop(record)) {
+            // Only this thread touches the throttling state
+            Site& site = *record.site;
+            if (record.throttle > 0.f) {
+                const auto now = std::chrono::steady_clock::now();
+                if (now - site.last_written < std::chrono::duration<float>(record.throttle)) {
+                    site.suppressed++;
+                    continue;
+                }
+                site.last_written = now;
+            }
+
+            const std::string line = format(record);
+            site.suppressed = 0;
+
+            std::lock_guard lock{sink_mutex_};
+            if (sink_) {
+                sink_(line);
+            } else {
+                std::cerr << line << "\n";
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kCapacity = 1024;
+    static constexpr auto kPeriod = std::chrono::milliseconds(10);
+
+    Ring ring_;
+
+    std::mutex sink_mutex_;
+    std::function<void(const std::string&)> sink_;
+
+    std::atomic<bool> shutdown_{false};
+    std::thread thread_;
+};
+
+///
+/// @brief Leaked on purpose so that threads still logging during static destruction (the audio callback while
+/// exit() runs, for example) and log calls from other static initializers always find a live logger.
+///
+Logger& logger() {
+    static Logger& logger = *new Logger;
+    return logger;
+}
+
+/// The first message usually comes from the audio thread, which shouldn't be the one allocating the ring or starting
+/// the thread
+[[maybe_unused]] const Logger& kStarted = logger();
+}  // namespace
+
+//
+// #############################################################################
+//
+
+Entry::Entry(Site& site, float throttle) {
+    record_.site = &site;
+    record_.throttle = throttle;
+}
+
+//
+// #############################################################################
+//
+
+Entry::~Entry() { logger().ring().push(record_); }
+
+//
+// #############################################################################
+//
+
+Entry& Entry::operator<<(std::string_view text) {
+    const size_t size = std::min(text.size(), record_.text.size() - record_.text_size);
+    std::memcpy(record_.text.data() + record_.text_size, text.data(), size);
+
+    // Text right after more text just extends it, which keeps the number of arguments down
+    if (record_.num_args > 0) {
+        Record::Arg& last = record_.args[record_.num_args - 1];
+        if (last.type == Record::Arg::Type::kText && last.text.offset + last.text.size == record_.text_size) {
+            last.text.size += size;
+            record_.text_size += size;
+            return *this;
+        }
+    }
+
+    Record::Arg arg;
+    arg.type = Record::Arg::Type::kText;
+    arg.text.offset = static_cast<uint16_t>(record_.text_size);
+    arg.text.size = static_cast<uint16_t>(size);
+    record_.text_size += size;
+    return add(arg);
+}
+
+//
+// #############################################################################
+//
+
+Entry& Entry::add(const Record::Arg& arg) {
+    // Anything past the limit is dropped, the message will just be cut short
+    if (record_.num_args < record_.args.size()) record_.args[record_.num_args++] = arg;
+    return *this;
+}
+
+//
+// #############################################################################
+//
+
+void flush() { logger().flush(); }
+
+//
+// #############################################################################
+//
+
+void set_sink(std::function<void(const std::string&)> sink) { logger().set_sink(std::move(sink)); }
+
+//
+// #############################################################################
+//
+
+size_t dropped() { return logger().ring().dropped(); }
+}  // namespace synth::log
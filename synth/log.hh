@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+///
+/// Logging which is safe to use from the audio thread. Messages are captured as raw values into a lock-free ring and a
+/// background thread does the formatting and writing, so logging never allocates, formats or blocks the caller. If
+/// the ring fills up messages are dropped (and counted). Use the macros in synth/debug.hh rather than this directly.
+///
+
+namespace synth::log {
+
+enum class Level : int { kDebug = 0, kInfo = 1, kWarning = 2 };
+
+///
+/// @brief Static information about where a message comes from, one for each logging statement. The last two members
+/// are only touched by the background thread, to throttle messages.
+///
+struct Site {
+    const char* file;
+    int line;
+    const char* function;
+    Level level;
+
+    std::chrono::steady_clock::time_point last_written{};
+    size_t suppressed = 0;
+};
+
+///
+/// @brief A message as it sits in the ring. Strings are copied in (and truncated if there isn't room), everything
+/// else is stored as a value to be formatted later.
+///
+struct Record {
+    static constexpr size_t kMaxArgs = 16;
+    static constexpr size_t kMaxText = 192;
+
+    struct Arg {
+        enum class Type : uint8_t { kText, kSigned, kUnsigned, kFloat, kDuration };
+        Type type;
+        union {
+            struct {
+                uint16_t offset;
+                uint16_t size;
+            } text;
+            int64_t i;
+            uint64_t u;
+            double d;
+        };
+    };
+
+    Site* site = nullptr;
+    // Minimum number of seconds between writing messages from the site, 0 to write all of them. This is checked when
+    // the message is written, so the caller never needs to look at the clock.
+    float throttle = 0.f;
+
+    std::array<Arg, kMaxArgs> args;
+    size_t num_args = 0;
+    std::array<char, kMaxText> text;
+    size_t text_size = 0;
+};
+
+///
+/// @brief Collects a message with operator<< and pushes it into the ring when it goes out of scope
+///
+class Entry {
+public:
+    explicit Entry(Site& site, float throttle = 0.f);
+    ~Entry();
+
+    Entry(const Entry& rhs) = delete;
+    Entry(Entry&& rhs) = delete;
+    Entry& operator=(const Entry& rhs) = delete;
+    Entry& operator=(Entry&& rhs) = delete;
+
+public:
+    Entry& operator<<(std::string_view text);
+    Entry& operator<<(const char* text) { return *this << std::string_view{text}; }
+    Entry& operator<<(const std::string& text) { return *this << std::string_view{text}; }
+    Entry& operator<<(char c) { return *this << std::string_view{&c, 1}; }
+    Entry& operator<<(bool value) { return *this << (value ? "true" : "false"); }
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    Entry& operator<<(T value) {
+        Record::Arg arg;
+        if constexpr (std::is_floating_point_v<T>) {
+            arg.type = Record::Arg::Type::kFloat;
+            arg.d = value;
+        } else if constexpr (std::is_signed_v<T>) {
+            arg.type = Record::Arg::Type::kSigned;
+            arg.i = value;
+        } else {
+            arg.type = Record::Arg::Type::kUnsigned;
+            arg.u = value;
+        }
+        return add(arg);
+    }
+
+    template <typename Rep, typename Period>
+    Entry& operator<<(const std::chrono::duration<Rep, Period>& duration) {
+        Record::Arg arg;
+        arg.type = Record::Arg::Type::kDuration;
+        arg.i = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return add(arg);
+    }
+
+private:
+    Entry& add(const Record::Arg& arg);
+
+private:
+    Record record_;
+};
+
+///
+/// @brief Block until everything logged before this call has been written
+///
+void flush();
+
+///
+/// @brief Where formatted messages end up (a line without the trailing newline). Defaults to std::cerr, passing
+/// nullptr goes back to that. This is called from the background thread.
+///
+void set_sink(std::function<void(const std::string&)> sink);
+
+/// Number of messages dropped because the ring was full
+size_t dropped();
+}  // namespace synth::log
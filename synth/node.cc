@@ -0,0 +1,130 @@
+#include "synth/node.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace synth {
+
+//
+// #############################################################################
+//
+
+const Samples& silence() {
+    static const Samples kSilence = [] {
+        Samples silence;
+        silence.fill(0.f);
+        return silence;
+    }();
+    return kSilence;
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::invoke(const Context& context) {
+    output_.clear_flags();
+    generate(context, output_);
+    num_scheduled_ = 0;
+}
+
+//
+// #############################################################################
+//
+
+bool InjectorNode::idle() const {
+    return num_scheduled_ == 0 && ramp_remaining_ == 0 && current_ == 0.f && filled_ == 0.f;
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::skip() {
+    num_scheduled_ = 0;
+    if (!output_.silent) output_.fill(0.f);
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::set_value(float value) {
+    target_ = value;
+    current_ = value;
+    ramp_remaining_ = 0;
+    num_scheduled_ = 0;
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::schedule(float value, size_t offset) {
+    target_ = value;
+
+    // Keep everything in order, something scheduled earlier can't end up behind something scheduled later
+    offset = std::min(offset, Samples::batch_size() - 1);
+    if (num_scheduled_ > 0) offset = std::max(offset, scheduled_[num_scheduled_ - 1].offset);
+
+    if (num_scheduled_ == kMaxScheduled) {
+        scheduled_.back().value = value;
+        return;
+    }
+    scheduled_[num_scheduled_++] = {offset, value};
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::generate(const Context&, Samples& output) {
+    if (rate_ == Rate::kControl) {
+        for (size_t i = 0; i < num_scheduled_; ++i) start_ramp(scheduled_[i].value);
+        if (ramp_remaining_ > 0) {
+            const size_t steps = std::min(ramp_remaining_, Samples::batch_size());
+            ramp_remaining_ -= steps;
+            current_ = ramp_remaining_ == 0 ? ramp_target_ : current_ + steps * ramp_step_;
+        }
+        output.samples[0] = current_;
+        output.constant = true;
+        output.silent = current_ == 0.f;
+        filled_ = current_;
+        return;
+    }
+
+    if (num_scheduled_ == 0 && ramp_remaining_ == 0) {
+        if (current_ == filled_) {
+            output.constant = true;
+            output.silent = current_ == 0.f;
+            return;
+        }
+        output.fill(current_);
+        filled_ = current_;
+        return;
+    }
+
+    size_t next = 0;
+    output.populate_samples([&](size_t i) {
+        for (; next < num_scheduled_ && scheduled_[next].offset <= i; ++next) start_ramp(scheduled_[next].value);
+        if (ramp_remaining_ > 0) current_ = --ramp_remaining_ == 0 ? ramp_target_ : current_ + ramp_step_;
+        return current_;
+    });
+    filled_ = std::numeric_limits<float>::quiet_NaN();
+}
+
+//
+// #############################################################################
+//
+
+void InjectorNode::start_ramp(float value) {
+    if (ramp_ == 0) {
+        current_ = value;
+        ramp_remaining_ = 0;
+        return;
+    }
+    ramp_target_ = value;
+    ramp_step_ = (value - current_) / ramp_;
+    ramp_remaining_ = ramp_;
+}
+}  // namespace synth
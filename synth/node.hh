@@ -2,6 +2,8 @@
 #include <array>
 #include <chrono>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
 
 #include "synth/samples.hh"
@@ -13,6 +15,21 @@ struct Context {
     std::chrono::nanoseconds timestamp;
 };
 
+///
+/// @brief Buffer that inputs without any connections will read from
+///
+const Samples& silence();
+
+class InjectorNode;
+class EjectorNode;
+class BiQuadNode;
+
+///
+/// @brief How often the value on a port changes. Audio rate ports carry a full batch of samples. Control rate ports
+/// carry one value per batch in the first sample of the buffer, which is all that gets written or read.
+///
+enum class Rate : uint8_t { kAudio = 0, kControl = 1 };
+
 ///
 /// These functions are invoked directly by the runner
 ///
@@ -28,14 +45,53 @@ public:
     virtual size_t num_inputs() const = 0;
     virtual size_t num_outputs() const = 0;
 
-    virtual void reset_connections() = 0;
-    virtual void connect(size_t input_index) = 0;
-
-    virtual void add_input(size_t index, const Samples& input) = 0;
-    virtual Samples get_output(size_t index) const = 0;
-
-    // Return if it was ready to run
-    virtual bool invoke(const Context& context) = 0;
+    ///
+    /// @brief Point the input at the buffer it should read from when invoked. Nothing is copied, so the buffer needs to
+    /// outlive the binding (the runner rebinds every input each time the graph is compiled).
+    ///
+    virtual void set_input(size_t index, const Samples& input) = 0;
+
+    ///
+    /// @brief Control rate outputs only write the first sample of their buffer. The runner promotes them for inputs
+    /// which need a full batch, ramping from the value in the previous batch so that nothing steps.
+    ///
+    virtual Rate output_rate(size_t) const { return Rate::kAudio; }
+
+    ///
+    /// @brief Control rate inputs can make do with a single value per batch when that's all the sources connected to
+    /// them provide. The runner tells them which they ended up with through set_input_rate() (right after set_input()),
+    /// audio rate inputs always get a full batch.
+    ///
+    virtual Rate input_rate(size_t) const { return Rate::kAudio; }
+    virtual void set_input_rate(size_t, Rate) {}
+
+    ///
+    /// @brief Output buffers are owned by the node and are written in place each time it's invoked
+    ///
+    virtual const Samples& output(size_t index) const = 0;
+
+    virtual void invoke(const Context& context) = 0;
+
+    ///
+    /// @brief True when invoking the node this batch would only write silence to its outputs, and skipping it wouldn't
+    /// change anything later on (it doesn't have any state, or what it has has decayed to nothing). This is checked
+    /// once the inputs are ready, and the runner calls skip() instead of invoke() when it's true. Nothing is skipped by
+    /// default.
+    ///
+    virtual bool idle() const { return false; }
+
+    /// Stands in for invoke() on batches where the node is idle, which just needs to leave the outputs silent
+    virtual void skip() {}
+
+    ///
+    /// @brief Typed access to the nodes which move values in and out of the graph (nullptr for every other node), so
+    /// callers can keep tables of them without casting.
+    ///
+    virtual InjectorNode* as_injector() { return nullptr; }
+    virtual EjectorNode* as_ejector() { return nullptr; }
+
+    /// Nodes which are just a filter, the runner can run these together through a BiQuadBank
+    virtual BiQuadNode* as_biquad() { return nullptr; }
 
 private:
     std::string name_;
@@ -52,64 +108,120 @@ public:
     size_t num_inputs() const final { return 0; }
     size_t num_outputs() const final { return 1; }
 
-    // always ready
-    bool invoke(const Context&) final { return true; }
+    ///
+    /// @brief Generates the output, then forgets about any values scheduled for this batch
+    ///
+    void invoke(const Context& context) final;
+
+    void set_input(size_t, const Samples&) final { throw std::runtime_error("InjectorNode::set_input()"); };
+    const Samples& output(size_t) const final { return output_; }
+    Rate output_rate(size_t) const final { return rate_; }
 
-    void reset_connections() final {}
-    void connect(size_t) final { throw std::runtime_error("InjectorNode::connect()"); }
-    void add_input(size_t, const Samples&) final { throw std::runtime_error("InjectorNode::set_input()"); };
-    Samples get_output(size_t) const override { return Samples{value_}; }
+    ///
+    /// @brief Idle when the value is holding at 0 with nothing scheduled. Injectors which override generate() only go
+    /// idle if they override this as well.
+    ///
+    bool idle() const override;
+    void skip() final;
+
+    InjectorNode* as_injector() final { return this; }
 
 public:
-    void set_value(float value) { value_ = value; }
-    float get_value() const { return value_; }
+    /// Jump straight to the value at the start of the next batch, dropping anything that's been scheduled
+    void set_value(float value);
+
+    ///
+    /// @brief Move to the value starting offset samples into the next batch, ramping from wherever the output is at
+    /// that point over ramp samples. Only a handful of values can be scheduled per batch, past that the last one is
+    /// replaced.
+    ///
+    void schedule(float value, size_t offset);
+
+    /// Number of samples scheduled values are smoothed over, 0 (the default) steps straight to the new value
+    void set_ramp(size_t samples) { ramp_ = samples; }
+
+    ///
+    /// @brief At control rate, values scheduled within a batch take effect at the end of it and ramps move a batch at a
+    /// time. Audio rate (the default) is sample accurate. Injectors which override generate() are always audio rate.
+    /// This needs to be set before the graph is compiled.
+    ///
+    void set_rate(Rate rate) {
+        rate_ = rate;
+        filled_ = std::numeric_limits<float>::quiet_NaN();
+    }
+
+    /// The most recently set or scheduled value
+    float get_value() const { return target_; }
+
+protected:
+    ///
+    /// @brief By default the output holds the value (or ramps between values) and is only refilled when it changes.
+    /// Injectors which produce audio rate values themselves should override this.
+    ///
+    virtual void generate(const Context& context, Samples& output);
+
+private:
+    void start_ramp(float value);
 
 private:
-    float value_ = 0.f;
+    struct Scheduled {
+        size_t offset;
+        float value;
+    };
+    static constexpr size_t kMaxScheduled = 16;
+    std::array<Scheduled, kMaxScheduled> scheduled_;
+    size_t num_scheduled_ = 0;
+
+    float target_ = 0.f;
+
+    // The value of the most recent sample and the ramp it's following
+    float current_ = 0.f;
+    float ramp_target_ = 0.f;
+    float ramp_step_ = 0.f;
+    size_t ramp_remaining_ = 0;
+    size_t ramp_ = 0;
+    Rate rate_ = Rate::kAudio;
+
+    // What the output is currently filled with (just the first sample at control rate), NaN if it isn't constant or
+    // hasn't been written by generate() yet
+    float filled_ = std::numeric_limits<float>::quiet_NaN();
+    Samples output_;
 };
 
 ///
-/// @brief Node which can output values from the graph
+/// @brief Node which can output values from the graph, with one input for each channel of the stream. Inputs which
+/// aren't connected play whatever the first one has, so a mono signal is heard on every channel.
 ///
 class EjectorNode : public GenericNode {
 public:
-    EjectorNode(std::string node_name) : GenericNode{node_name} {}
+    EjectorNode(std::string node_name, size_t channels = 1) : GenericNode{node_name}, stream_{channels} {
+        inputs_.fill(&silence());
+    }
     ~EjectorNode() override = default;
 
 public:
-    size_t num_inputs() const final { return 1; }
+    size_t num_inputs() const final { return stream_.channels(); }
     size_t num_outputs() const final { return 0; }
 
-    bool invoke(const Context& context) final {
-        if (input_counter_ > 0) return false;
-        input_counter_ = default_counter_;
-
-        stream_.add_samples(context.timestamp, samples_);
-
-        samples_ = Samples{0};
-
-        return true;
+    void invoke(const Context& context) final {
+        std::array<const Samples*, Samples::kMaxChannels> channels;
+        for (size_t c = 0; c < num_inputs(); ++c) channels[c] = inputs_[c] == &silence() ? inputs_[0] : inputs_[c];
+        stream_.add_samples(context.timestamp, Span<const Samples* const>{channels.data(), num_inputs()});
     }
 
-    void reset_connections() final {
-        default_counter_ = 0;
-        input_counter_ = default_counter_;
-    }
-    void connect(size_t) final { default_counter_++; }
-    void add_input(size_t, const Samples& data) final {
-        input_counter_--;
-        samples_.sum(data.samples);
+    void set_input(size_t index, const Samples& input) final {
+        if (index >= num_inputs()) throw std::runtime_error("EjectorNode::set_input() index out of range.");
+        inputs_[index] = &input;
     };
-    Samples get_output(size_t) const final { throw std::runtime_error("EjectorNode::get_output()"); }
+    const Samples& output(size_t) const final { throw std::runtime_error("EjectorNode::output()"); }
+
+    EjectorNode* as_ejector() final { return this; }
 
 public:
     Stream& stream() { return stream_; }
 
 private:
-    int default_counter_ = 0;
-    int input_counter_ = 0;
-
-    Samples samples_;
+    std::array<const Samples*, Samples::kMaxChannels> inputs_;
     Stream stream_;
 };
 
@@ -117,73 +229,79 @@ private:
 // #############################################################################
 //
 
+///
+/// @brief Read only view of the buffer feeding each input of a node
+///
+template <size_t kSize>
+class InputBuffers {
+public:
+    InputBuffers() { buffers_.fill(&silence()); }
+
+    template <typename... S, typename = std::enable_if_t<(kSize > 0) && sizeof...(S) == kSize>>
+    InputBuffers(const S&... samples) : buffers_{&samples...} {}
+
+public:
+    const Samples& operator[](size_t index) const { return *buffers_[index]; }
+    void set(size_t index, const Samples& samples) { buffers_.at(index) = &samples; }
+
+    /// When true only the first sample of the input is valid, and it's the value for the whole batch
+    bool control(size_t index) const { return rates_[index] == Rate::kControl; }
+    void set_rate(size_t index, Rate rate) { rates_.at(index) = rate; }
+
+    static constexpr size_t size() { return kSize; }
+
+private:
+    std::array<const Samples*, kSize> buffers_;
+    std::array<Rate, kSize> rates_{};
+};
+
+//
+// #############################################################################
+//
+
 template <size_t kInputs, size_t kOutputs>
 class AbstractNode : public GenericNode {
 public:
-    using Inputs = std::array<Samples, kInputs>;
+    using Inputs = InputBuffers<kInputs>;
     using Outputs = std::array<Samples, kOutputs>;
 
 public:
-    AbstractNode(std::string name) : GenericNode(std::move(name)) { reset_connections(); }
+    AbstractNode(std::string name) : GenericNode(std::move(name)) {}
     ~AbstractNode() override = default;
 
 public:
     size_t num_inputs() const final { return kInputs; }
     size_t num_outputs() const final { return kOutputs; }
 
-    void reset_connections() final {
-        initial_counters_.fill(0);
-        counters_ = initial_counters_;
-    }
-    void connect(size_t input_index) final {
-        initial_counters_.at(input_index)++;
-        counters_.at(input_index)++;
-    }
-
-    bool invoke(const Context& context) final {
-        if (!ready()) {
-            return false;
-        }
+    void invoke(const Context& context) final {
+        // Whatever was known about the last batch doesn't hold anymore, the implementation can set them again
+        for (Samples& output : outputs_) output.clear_flags();
 
         // Pass to the user implemented function
-        invoke(context, next_inputs_, outputs_);
-
-        // Reset the internal state
-        counters_ = initial_counters_;
-        next_inputs_ = {};
-        return true;
+        invoke(context, inputs_, outputs_);
     }
 
-    void add_input(size_t input_index, const Samples& incoming_samples) final {
-        auto& next_input = next_inputs_[input_index];
-        for (size_t i = 0; i < next_input.samples.size(); ++i) {
-            // Sum new inputs with the current inputs
-            next_input.samples[i] += incoming_samples.samples[i];
+    void skip() final {
+        for (Samples& output : outputs_) {
+            if (!output.silent) output.fill(0.f);
         }
-
-        counters_[input_index] -= 1;
     }
 
-    Samples get_output(size_t index) const final { return outputs_[index]; }
+    void set_input(size_t input_index, const Samples& input) final { inputs_.set(input_index, input); }
+    void set_input_rate(size_t input_index, Rate rate) final { inputs_.set_rate(input_index, rate); }
+
+    const Samples& output(size_t index) const final { return outputs_[index]; }
 
 protected:
     virtual void invoke(const Context&, const Inputs& inputs, Outputs& outputs) { return invoke(inputs, outputs); }
     virtual void invoke(const Inputs&, Outputs&){};
 
-private:
-    bool ready() const {
-        for (auto& count : counters_) {
-            if (count < 0) throw std::runtime_error(name() + "::ready() found a negative counter!");
-
-            if (count != 0) return false;
-        }
-        return true;
-    }
+    /// For work done outside of invoke()
+    const Inputs& inputs() const { return inputs_; }
+    Outputs& outputs() { return outputs_; }
 
 private:
-    std::array<int, kInputs> initial_counters_;
-    std::array<int, kInputs> counters_;
-    Inputs next_inputs_;
+    Inputs inputs_;
     Outputs outputs_;
 };
 }  // namespace synth
@@ -0,0 +1,81 @@
+#include "synth/parameters.hh"
+
+#include <stdexcept>
+
+namespace synth {
+
+//
+// #############################################################################
+//
+
+ParameterQueue::ParameterQueue(size_t capacity) : events_(capacity) {
+    if (capacity == 0) throw std::runtime_error("ParameterQueue() needs a non-zero capacity.");
+}
+
+//
+// #############################################################################
+//
+
+bool ParameterQueue::push(size_t node_id, float value) {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return push(ParameterEvent{node_id, value, std::chrono::duration_cast<std::chrono::nanoseconds>(now)});
+}
+
+//
+// #############################################################################
+//
+
+bool ParameterQueue::push(const ParameterEvent& event) {
+    const uint64_t write = write_.load(std::memory_order_relaxed);
+    if (write >= cached_read_ + events_.size()) {
+        // Acquire so the reader is done with the entry before it's reused
+        cached_read_ = read_.load(std::memory_order_acquire);
+        if (write >= cached_read_ + events_.size()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    events_[write % events_.size()] = event;
+    write_.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+//
+// #############################################################################
+//
+
+bool ParameterQueue::pop(ParameterEvent& event) {
+    const uint64_t read = read_.load(std::memory_order_relaxed);
+    if (read >= cached_write_) {
+        // Acquire so the entry the writer committed is visible
+        cached_write_ = write_.load(std::memory_order_acquire);
+        if (read >= cached_write_) return false;
+    }
+
+    event = events_[read % events_.size()];
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+//
+// #############################################################################
+//
+
+size_t ParameterQueue::size() const {
+    const uint64_t read = read_.load(std::memory_order_acquire);
+    return write_.load(std::memory_order_acquire) - read;
+}
+
+//
+// #############################################################################
+//
+
+size_t ParameterQueue::capacity() const { return events_.size(); }
+
+//
+// #############################################################################
+//
+
+size_t ParameterQueue::dropped() const { return dropped_.load(std::memory_order_relaxed); }
+}  // namespace synth
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace synth {
+
+///
+/// @brief A new value for the InjectorNode with the given node id. The time is from the producer's steady clock, the
+/// runner maps it onto the sample timeline so that the spacing between events is preserved.
+///
+struct ParameterEvent {
+    size_t node_id;
+    float value;
+    std::chrono::nanoseconds time;
+};
+
+///
+/// @brief Lock-free single producer single consumer queue of parameter changes, used to get values from the UI thread
+/// to the runner without holding a lock around processing. Events which don't fit are dropped and counted.
+///
+class ParameterQueue {
+public:
+    explicit ParameterQueue(size_t capacity = 1024);
+
+    ~ParameterQueue() = default;
+    ParameterQueue(const ParameterQueue& rhs) = delete;
+    ParameterQueue(ParameterQueue&& rhs) = delete;
+    ParameterQueue& operator=(const ParameterQueue& rhs) = delete;
+    ParameterQueue& operator=(ParameterQueue&& rhs) = delete;
+
+public:
+    ///
+    /// @brief Producer side, returns false if the queue was full. The first version is timestamped with the current
+    /// time of the steady clock.
+    ///
+    bool push(size_t node_id, float value);
+    bool push(const ParameterEvent& event);
+
+    ///
+    /// @brief Consumer side, returns false if the queue was empty
+    ///
+    bool pop(ParameterEvent& event);
+
+public:
+    // Okay if called from either thread, although it may be out of date by the time it returns
+    size_t size() const;
+    size_t capacity() const;
+    size_t dropped() const;
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<ParameterEvent> events_;
+
+    /// Same layout as the ThreadSafeBuffer, each head only ever increases and lives with the state only its owner uses
+    alignas(kCacheLine) std::atomic<uint64_t> write_{0};
+    uint64_t cached_read_ = 0;
+    std::atomic<uint64_t> dropped_{0};
+
+    alignas(kCacheLine) std::atomic<uint64_t> read_{0};
+    uint64_t cached_write_ = 0;
+};
+}  // namespace synth
@@ -0,0 +1,204 @@
+#include "synth/profiler.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <thread>
+#include <unordered_map>
+
+namespace synth {
+namespace {
+void write_escaped(std::ostream& stream, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            stream << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            stream << ' ';
+        } else {
+            stream << c;
+        }
+    }
+}
+
+double to_microseconds(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+void Timing::add(std::chrono::nanoseconds duration) {
+    count_++;
+    total_ += duration;
+    min_ = std::min(min_, duration);
+    max_ = std::max(max_, duration);
+
+    const auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    histogram_[bucket(nanoseconds)]++;
+}
+
+//
+// #############################################################################
+//
+
+std::chrono::nanoseconds Timing::mean() const {
+    return count_ > 0 ? total_ / static_cast<int64_t>(count_) : std::chrono::nanoseconds{0};
+}
+
+//
+// #############################################################################
+//
+
+std::chrono::nanoseconds Timing::percentile(double fraction) const {
+    if (count_ == 0) return std::chrono::nanoseconds{0};
+    if (fraction <= 0.0) return min_;
+
+    // The number of samples at or below the percentile
+    const auto target = static_cast<size_t>(std::ceil(fraction * count_));
+    size_t seen = 0;
+    for (size_t b = 0; b < kBuckets; ++b) {
+        seen += histogram_[b];
+        if (seen >= target) {
+            // The bucket bounds are coarse, but the true value is always known to be inside [min, max]
+            const std::chrono::nanoseconds bound{static_cast<int64_t>(upper_bound(b))};
+            return std::clamp(bound, min(), max_);
+        }
+    }
+    return max_;
+}
+
+//
+// #############################################################################
+//
+
+size_t Timing::bucket(uint64_t nanoseconds) {
+    // The first few values get a bucket each, after that each power of two is split into kSubBuckets
+    if (nanoseconds < kSubBuckets) return nanoseconds;
+    const size_t msb = 63 - __builtin_clzll(nanoseconds);
+    const size_t sub = (nanoseconds >> (msb - 2)) & (kSubBuckets - 1);
+    return (msb - 1) * kSubBuckets + sub;
+}
+
+//
+// #############################################################################
+//
+
+uint64_t Timing::upper_bound(size_t bucket) {
+    if (bucket < kSubBuckets) return bucket;
+    const size_t msb = bucket / kSubBuckets + 1;
+    const size_t sub = bucket % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << (msb - 2)) - 1;
+}
+
+//
+// #############################################################################
+//
+
+std::chrono::nanoseconds Profile::node_total() const {
+    std::chrono::nanoseconds total{0};
+    for (const Node& node : nodes) total += node.timing.total();
+    return total;
+}
+
+//
+// #############################################################################
+//
+
+Profiler::Profiler(size_t trace_events) : origin_(Clock::now()), events_(trace_events) {}
+
+//
+// #############################################################################
+//
+
+void Profiler::reset(std::vector<std::string> names) {
+    profile_.nodes.clear();
+    profile_.nodes.reserve(names.size());
+    for (std::string& name : names) profile_.nodes.push_back({std::move(name), Timing{}});
+    clear();
+}
+
+//
+// #############################################################################
+//
+
+void Profiler::clear() {
+    for (Profile::Node& node : profile_.nodes) node.timing = Timing{};
+    profile_.batch = Timing{};
+    origin_ = Clock::now();
+    num_events_.store(0, std::memory_order_relaxed);
+}
+
+//
+// #############################################################################
+//
+
+void Profiler::add_step(size_t step, Clock::time_point start, Clock::time_point end) {
+    profile_.nodes[step].timing.add(end - start);
+    add_event(step, start, end);
+}
+
+//
+// #############################################################################
+//
+
+void Profiler::add_batch(Clock::time_point start, Clock::time_point end) {
+    profile_.batch.add(end - start);
+    add_event(kBatch, start, end);
+}
+
+//
+// #############################################################################
+//
+
+void Profiler::add_event(size_t step, Clock::time_point start, Clock::time_point end) {
+    if (events_.empty()) return;
+
+    // Nodes on the same level can finish at the same time on different threads, so the slots are claimed atomically
+    const size_t index = num_events_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= events_.size()) return;
+
+    // Hashing the id just returns the native handle, which doesn't need to allocate the way thread locals might
+    events_[index] = {step, std::hash<std::thread::id>{}(std::this_thread::get_id()), start, end};
+}
+
+//
+// #############################################################################
+//
+
+Profile Profiler::profile() const { return profile_; }
+
+//
+// #############################################################################
+//
+
+void Profiler::write_trace(std::ostream& stream) const {
+    const size_t size = std::min(num_events_.load(std::memory_order_relaxed), events_.size());
+
+    // Thread ids are renumbered in the order they show up, which keeps the tracks in a sensible order
+    std::unordered_map<size_t, size_t> threads;
+
+    // Times are in microseconds, with enough digits to keep nanoseconds for long traces
+    const std::ios::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (size_t i = 0; i < size; ++i) {
+        const Event& event = events_[i];
+        const size_t thread = threads.emplace(event.thread, threads.size()).first->second;
+
+        stream << (i == 0 ? "\n" : ",\n") << "{\"name\":\"";
+        write_escaped(stream, event.step == kBatch ? "Runner::next" : profile_.nodes[event.step].name);
+        stream << "\",\"cat\":\"" << (event.step == kBatch ? "batch" : "node") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+               << thread << ",\"ts\":" << to_microseconds(event.start - origin_)
+               << ",\"dur\":" << to_microseconds(event.end - event.start) << "}";
+    }
+    stream << "\n]}\n";
+
+    stream.flags(flags);
+    stream.precision(precision);
+}
+}  // namespace synth
@@ -0,0 +1,115 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace synth {
+
+///
+/// @brief Running statistics of a duration which is measured over and over. Percentiles come from a histogram with
+/// four buckets per power of two, so they're accurate to within about 20%. Adding a sample doesn't allocate.
+///
+class Timing {
+public:
+    void add(std::chrono::nanoseconds duration);
+
+    size_t count() const { return count_; }
+    std::chrono::nanoseconds total() const { return total_; }
+    std::chrono::nanoseconds min() const { return count_ > 0 ? min_ : std::chrono::nanoseconds{0}; }
+    std::chrono::nanoseconds max() const { return max_; }
+    std::chrono::nanoseconds mean() const;
+
+    ///
+    /// @brief Upper bound of the histogram bucket holding the given fraction (from 0 to 1) of the samples
+    ///
+    std::chrono::nanoseconds percentile(double fraction) const;
+
+private:
+    static constexpr size_t kSubBuckets = 4;
+    static constexpr size_t kBuckets = 64 * kSubBuckets;
+
+    static size_t bucket(uint64_t nanoseconds);
+    static uint64_t upper_bound(size_t bucket);
+
+private:
+    size_t count_ = 0;
+    std::chrono::nanoseconds total_{0};
+    std::chrono::nanoseconds min_{std::chrono::nanoseconds::max()};
+    std::chrono::nanoseconds max_{0};
+    std::array<uint32_t, kBuckets> histogram_{};
+};
+
+///
+/// @brief How long each node in a runner's plan took, along with the whole batch
+///
+struct Profile {
+    struct Node {
+        std::string name;
+        Timing timing;
+    };
+
+    /// In plan order
+    std::vector<Node> nodes;
+
+    /// Each call to Runner::next(), from start to finish
+    Timing batch;
+
+    /// Time spent in nodes summed over every batch, which is more than the batch time when running on multiple threads
+    std::chrono::nanoseconds node_total() const;
+};
+
+///
+/// @brief Collects the timing for a Runner. The steps are indexed in plan order, and each one is only written by the
+/// thread invoking it so nothing needs to be synchronized beyond what the runner already does between levels.
+/// Individual invocations can also be kept (up to a limit set up front) to be written as a Chrome trace.
+///
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Profiler(size_t trace_events);
+
+public:
+    ///
+    /// @brief Start over with the given nodes, called each time the plan changes
+    ///
+    void reset(std::vector<std::string> names);
+
+    /// Forget everything collected so far, keeping the same nodes
+    void clear();
+
+    void add_step(size_t step, Clock::time_point start, Clock::time_point end);
+    void add_batch(Clock::time_point start, Clock::time_point end);
+
+    Profile profile() const;
+
+    ///
+    /// @brief Write the recorded invocations in the Chrome trace event format, which can be opened in chrome://tracing
+    /// or https://ui.perfetto.dev. Each thread gets its own track. Once the limit is hit later invocations are dropped.
+    ///
+    void write_trace(std::ostream& stream) const;
+
+private:
+    struct Event {
+        /// Index of the step, or kBatch for the whole call to next()
+        size_t step;
+        size_t thread;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+    static constexpr size_t kBatch = static_cast<size_t>(-1);
+
+    void add_event(size_t step, Clock::time_point start, Clock::time_point end);
+
+private:
+    Profile profile_;
+    Clock::time_point origin_;
+
+    std::vector<Event> events_;
+    std::atomic<size_t> num_events_{0};
+};
+}  // namespace synth
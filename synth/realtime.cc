@@ -0,0 +1,155 @@
+#include "synth/realtime.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if SYNTH_REALTIME_CHECKS
+#include <execinfo.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+#endif
+
+namespace synth::realtime {
+namespace {
+// Plain values in static TLS, since these are read from inside malloc (where getting a TLS block can't allocate)
+thread_local int depth __attribute__((tls_model("initial-exec"))) = 0;
+thread_local int allowed __attribute__((tls_model("initial-exec"))) = 0;
+thread_local bool reporting __attribute__((tls_model("initial-exec"))) = false;
+
+std::atomic<size_t> violations_{0};
+
+[[maybe_unused]] void report([[maybe_unused]] const char* what) {
+    constexpr size_t kMaxReports = 16;
+    const size_t count = violations_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count > kMaxReports) return;
+
+#if SYNTH_REALTIME_CHECKS
+    // Getting the stack trace can allocate the first time, which shouldn't be reported again
+    reporting = true;
+
+    char message[160];
+    const int size = std::snprintf(message, sizeof(message), "[REALTIME]: %s on the real-time path (%zu so far)%s\n",
+                                   what, count, count == kMaxReports ? ", no more will be reported" : "");
+    [[maybe_unused]] const auto written = size > 0 ? ::write(STDERR_FILENO, message, size) : 0;
+
+    void* frames[32];
+    backtrace_symbols_fd(frames, backtrace(frames, 32), STDERR_FILENO);
+
+    reporting = false;
+#endif
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+Scope::Scope() { depth++; }
+Scope::~Scope() { depth--; }
+
+//
+// #############################################################################
+//
+
+Allow::Allow() { allowed++; }
+Allow::~Allow() { allowed--; }
+
+//
+// #############################################################################
+//
+
+bool active() { return kEnabled && depth > 0 && allowed == 0 && !reporting; }
+
+//
+// #############################################################################
+//
+
+size_t violations() { return violations_.load(std::memory_order_relaxed); }
+
+//
+// #############################################################################
+//
+
+namespace {
+[[maybe_unused]] inline void check(const char* what) {
+    if (active()) report(what);
+}
+}  // namespace
+}  // namespace synth::realtime
+
+//
+// #############################################################################
+//
+
+#if SYNTH_REALTIME_CHECKS && defined(__GLIBC__)
+// glibc exports its allocator under these names, so everything (including operator new) can be routed through here
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) __THROW {
+    synth::realtime::check("malloc()");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) __THROW {
+    synth::realtime::check("calloc()");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) __THROW {
+    synth::realtime::check("realloc()");
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) __THROW {
+    synth::realtime::check("aligned_alloc()");
+    return __libc_memalign(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) __THROW {
+    synth::realtime::check("memalign()");
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr) __THROW {
+    if (ptr != nullptr) synth::realtime::check("free()");
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) __THROWNL {
+    // This is constant initialized, a static which needed a guard could end up locking a mutex to initialize it
+    using Lock = int (*)(pthread_mutex_t*);
+    static std::atomic<Lock> real{nullptr};
+    Lock lock = real.load(std::memory_order_acquire);
+    if (lock == nullptr) {
+        lock = reinterpret_cast<Lock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        real.store(lock, std::memory_order_release);
+    }
+
+    synth::realtime::check("pthread_mutex_lock()");
+    return lock(mutex);
+}
+}
+
+#elif SYNTH_REALTIME_CHECKS
+// Anywhere else only C++ allocations can be caught, the other forms of new and delete all end up in these
+void* operator new(size_t size) {
+    synth::realtime::check("operator new");
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr != nullptr) synth::realtime::check("operator delete");
+    std::free(ptr);
+}
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+
+///
+/// Builds with --config=rtcheck check that nothing on the real-time path allocates, frees or locks a mutex. Threads
+/// mark themselves as being on the real-time path with a realtime::Scope, and anything that happens inside one is
+/// reported (with a stack trace) and counted. Allocations are caught by interposing malloc and friends (or operator
+/// new/delete where that isn't possible) and locks by interposing pthread_mutex_lock.
+///
+/// Everything else (including plain `bazel run //:main`) compiles the checks out, as do sanitizer builds since those
+/// have their own allocator. The config just defines SYNTH_CHECK_REALTIME.
+///
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define SYNTH_SANITIZED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define SYNTH_SANITIZED
+#endif
+
+#if defined(SYNTH_CHECK_REALTIME) && !defined(SYNTH_SANITIZED)
+#define SYNTH_REALTIME_CHECKS 1
+#else
+#define SYNTH_REALTIME_CHECKS 0
+#endif
+
+namespace synth::realtime {
+
+/// If the checks are compiled in, when they aren't the functions below do nothing
+constexpr bool kEnabled = SYNTH_REALTIME_CHECKS;
+
+///
+/// @brief The calling thread is on the real-time path while one of these is alive (they can be nested)
+///
+class Scope {
+public:
+    Scope();
+    ~Scope();
+
+    Scope(const Scope& rhs) = delete;
+    Scope(Scope&& rhs) = delete;
+    Scope& operator=(const Scope& rhs) = delete;
+    Scope& operator=(Scope&& rhs) = delete;
+};
+
+///
+/// @brief Turns the checks off for the calling thread while alive, for the few places on the real-time path where
+/// blocking is known to be okay. Each one should have a comment saying why.
+///
+class Allow {
+public:
+    Allow();
+    ~Allow();
+
+    Allow(const Allow& rhs) = delete;
+    Allow(Allow&& rhs) = delete;
+    Allow& operator=(const Allow& rhs) = delete;
+    Allow& operator=(Allow&& rhs) = delete;
+};
+
+/// True if the calling thread is inside a Scope (and not an Allow)
+bool active();
+
+/// Total number of allocations, frees and locks seen inside a Scope by any thread. Only the first few are reported.
+size_t violations();
+}  // namespace synth::realtime
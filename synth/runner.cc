@@ -1,16 +1,279 @@
 #include "synth/runner.hh"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <queue>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <tuple>
 
 #include "synth/debug.hh"
+#include "synth/realtime.hh"
 
 namespace synth {
+namespace {
+///
+/// @brief Log how fast the graph is running every so often, shared between every runner
+///
+void report_realtime_factor(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+                            size_t skipped, size_t nodes) {
+    constexpr std::chrono::seconds kPeriod{10};
+    static std::atomic<std::chrono::steady_clock::rep> next{0};
 
-void Runner::run_for_at_least(const std::chrono::nanoseconds& duration, NodeWrappers& wrappers) {
+    if (start.time_since_epoch().count() < next.load(std::memory_order_relaxed)) return;
+    next.store((start + kPeriod).time_since_epoch().count(), std::memory_order_relaxed);
+
+    const std::chrono::nanoseconds duration = end - start;
+    info("Runner::next() " << Samples::batch_increment() << " simulated in " << duration << " ("
+                           << static_cast<double>(Samples::batch_increment().count()) / duration.count()
+                           << "x realtime, " << skipped << "/" << nodes << " nodes skipped)");
+}
+}  // namespace
+
+void Runner::set_threads(size_t threads) { pool_ = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr; }
+
+//
+// #############################################################################
+//
+
+void Runner::compile(NodeWrappers& wrappers) {
+    plan(wrappers);
+    bind();
+}
+
+//
+// #############################################################################
+//
+
+void Runner::plan(NodeWrappers& wrappers) {
+    plan_.clear();
+    level_offsets_.clear();
+    bank_offsets_.clear();
+    injectors_.clear();
+    bindings_.clear();
+    skipped_ = 0;
+    batches_ = 0;
+
+    // Sort by ID so that the plan (and the order in which inputs are summed) is deterministic
+    std::vector<size_t> ids;
+    ids.reserve(wrappers.id_wrapper_map.size());
+    for (const auto& [id, wrapper] : wrappers.id_wrapper_map) {
+        if (wrapper.node != nullptr) ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    // Timing is per step, so anything collected for the previous plan doesn't line up anymore
+    if (profiler_) profiler_->reset({});
+
+    std::unordered_map<const GenericNode*, NodeWrapper*> wrapper_from_node;
+    std::unordered_map<const NodeWrapper*, size_t> in_degree;
+    for (size_t id : ids) {
+        NodeWrapper& wrapper = wrappers.id_wrapper_map.at(id);
+        wrapper_from_node[wrapper.node.get()] = &wrapper;
+        in_degree[&wrapper] = 0;
+        if (InjectorNode* injector = wrapper.node->as_injector()) injectors_[id] = injector;
+    }
+
+    for (size_t id : ids) {
+        for (const auto& output : wrappers.id_wrapper_map.at(id).outputs) {
+            for (const auto& [_, input_node] : output) {
+                auto it = wrapper_from_node.find(input_node);
+                if (it == wrapper_from_node.end())
+                    throw std::runtime_error("Runner::compile() found a connection to a node that isn't in the graph.");
+                in_degree[it->second]++;
+            }
+        }
+    }
+
+    // Kahn's algorithm, one level at a time. The order doubles as the queue of nodes with all of their inputs satisfied
+    std::vector<NodeWrapper*> order;
+    order.reserve(ids.size());
+    for (size_t id : ids) {
+        NodeWrapper* wrapper = &wrappers.id_wrapper_map.at(id);
+        if (in_degree[wrapper] == 0) order.push_back(wrapper);
+    }
+    for (size_t begin = 0; begin < order.size();) {
+        const size_t end = order.size();
+        level_offsets_.push_back(begin);
+
+        for (size_t i = begin; i < end; ++i) {
+            for (const auto& output : order[i]->outputs) {
+                for (const auto& [_, input_node] : output) {
+                    NodeWrapper* next = wrapper_from_node[input_node];
+                    if (--in_degree[next] == 0) order.push_back(next);
+                }
+            }
+        }
+        begin = end;
+    }
+    level_offsets_.push_back(order.size());
+
+    if (order.size() != ids.size()) {
+        std::stringstream ss;
+        ss << "Runner::compile() found a cycle involving:";
+        for (size_t id : ids) {
+            const NodeWrapper& wrapper = wrappers.id_wrapper_map.at(id);
+            if (in_degree[&wrapper] > 0) ss << " '" << wrapper.node->name() << "'";
+        }
+        level_offsets_.clear();
+        throw std::runtime_error(ss.str());
+    }
+
+    // Banking a single filter would only add the cost of moving it in and out of the bank
+    size_t max_bank = 0;
+    for (size_t level = 0; level + 1 < level_offsets_.size(); ++level) {
+        const auto begin = order.begin() + level_offsets_[level];
+        const auto end = order.begin() + level_offsets_[level + 1];
+        auto bank = end;
+        if (banking_) {
+            const auto is_biquad = [](NodeWrapper* wrapper) { return wrapper->node->as_biquad() != nullptr; };
+            if (std::count_if(begin, end, is_biquad) > 1) {
+                bank = std::stable_partition(begin, end, [&](NodeWrapper* wrapper) { return !is_biquad(wrapper); });
+            }
+        }
+        bank_offsets_.push_back(bank - order.begin());
+        max_bank = std::max<size_t>(max_bank, end - bank);
+    }
+    bank_.reserve(max_bank);
+
+    // Gather the buffers feeding each input (and where they come from), in plan order
+    std::unordered_map<const GenericNode*, std::vector<std::vector<const Samples*>>> sources;
+    std::unordered_map<const Samples*, Producer> producers;
+    for (const NodeWrapper* wrapper : order) {
+        sources[wrapper->node.get()].resize(wrapper->node->num_inputs());
+    }
+    plan_.reserve(order.size());
+    for (const NodeWrapper* wrapper : order) {
+        plan_.push_back({wrapper->node.get(), 0, 0, 0, 0});
+
+        for (size_t output_index = 0; output_index < wrapper->outputs.size(); ++output_index) {
+            const Samples& output = wrapper->node->output(output_index);
+            producers[&output] = {plan_.size() - 1, wrapper->node->output_rate(output_index)};
+            for (const auto& [input_index, input_node] : wrapper->outputs[output_index]) {
+                sources[input_node].at(input_index).push_back(&output);
+            }
+        }
+    }
+
+    bind_inputs(sources, producers);
+
+    if (profiler_) profiler_->reset(names());
+}
+
+//
+// #############################################################################
+//
+
+void Runner::bind() {
+    for (const Binding& binding : bindings_) {
+        binding.node->set_input(binding.input, *binding.buffer);
+        binding.node->set_input_rate(binding.input, binding.rate);
+    }
+}
+
+//
+// #############################################################################
+//
+
+void Runner::continue_from(const Runner& previous) {
+    now_ = previous.now_;
+    held_ = previous.held_;
+    parameter_offset_ = previous.parameter_offset_;
+}
+
+//
+// #############################################################################
+//
+
+void Runner::bind_inputs(
+    const std::unordered_map<const GenericNode*, std::vector<std::vector<const Samples*>>>& sources,
+    const std::unordered_map<const Samples*, Producer>& producers) {
+    mixes_.clear();
+    mix_sources_.clear();
+    bindings_.clear();
+    promotions_.clear();
+
+    // An input only stays control rate if it asked to be and everything feeding it is
+    const auto control_source = [&](const Samples* source) { return producers.at(source).rate == Rate::kControl; };
+    const auto control_input = [&](const GenericNode* node, size_t index) {
+        const auto& input = sources.at(node)[index];
+        return node->input_rate(index) == Rate::kControl && std::all_of(input.begin(), input.end(), control_source);
+    };
+
+    // Size the mix and promoted buffers up front so that they don't move around once they've been bound
+    size_t mix_count = 0;
+    std::unordered_map<const Samples*, size_t> promoted;
+    for (const Step& step : plan_) {
+        const auto& inputs = sources.at(step.node);
+        for (size_t input_index = 0; input_index < inputs.size(); ++input_index) {
+            const auto& input = inputs[input_index];
+            mix_count += input.size() > 1 ? 1 : 0;
+            if (control_input(step.node, input_index)) continue;
+            for (const Samples* source : input) {
+                if (control_source(source)) promoted.emplace(source, promoted.size());
+            }
+        }
+    }
+    mix_buffers_.resize(mix_count);
+    promoted_buffers_.resize(promoted.size());
+
+    for (Step& step : plan_) {
+        step.mixes_begin = mixes_.size();
+
+        const auto& inputs = sources.at(step.node);
+        for (size_t input_index = 0; input_index < inputs.size(); ++input_index) {
+            const auto& input = inputs[input_index];
+            const Rate rate = control_input(step.node, input_index) ? Rate::kControl : Rate::kAudio;
+
+            // Audio rate inputs read control rate sources through their promoted buffer
+            const auto buffer = [&](const Samples* source) {
+                return rate == Rate::kAudio && control_source(source) ? &promoted_buffers_[promoted.at(source)]
+                                                                      : source;
+            };
+
+            if (input.empty()) {
+                // Silence is the same for the whole batch, so it's fine either way
+                bindings_.push_back({step.node, input_index, &silence(), step.node->input_rate(input_index)});
+            } else if (input.size() == 1) {
+                bindings_.push_back({step.node, input_index, buffer(input.front()), rate});
+            } else {
+                Samples& destination = mix_buffers_[mixes_.size()];
+                mixes_.push_back(
+                    {&destination, mix_sources_.size(), mix_sources_.size() + input.size(), rate == Rate::kControl});
+                for (const Samples* source : input) mix_sources_.push_back(buffer(source));
+                bindings_.push_back({step.node, input_index, &destination, rate});
+            }
+        }
+
+        step.mixes_end = mixes_.size();
+    }
+
+    // Promotions are grouped by the step producing them, and sorted so the plan is deterministic
+    std::vector<std::tuple<size_t, size_t, const Samples*>> order;
+    order.reserve(promoted.size());
+    for (const auto& [source, index] : promoted) order.emplace_back(producers.at(source).step, index, source);
+    std::sort(order.begin(), order.end());
+
+    constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+    auto it = order.begin();
+    for (size_t s = 0; s < plan_.size(); ++s) {
+        plan_[s].promotions_begin = promotions_.size();
+        for (; it != order.end() && std::get<0>(*it) == s; ++it) {
+            promotions_.push_back({std::get<2>(*it), &promoted_buffers_[std::get<1>(*it)], kNaN, kNaN});
+        }
+        plan_[s].promotions_end = promotions_.size();
+    }
+}
+
+//
+// #############################################################################
+//
+
+void Runner::run_for_at_least(const std::chrono::nanoseconds& duration) {
     auto end = now_ + duration;
     while (now_ < end) {
-        next(wrappers);
+        next();
     }
 }
 
@@ -18,58 +281,274 @@ void Runner::run_for_at_least(const std::chrono::nanoseconds& duration, NodeWrap
 // #############################################################################
 //
 
-void Runner::next(NodeWrappers& wrappers) {
-    auto timer = ScopedPrinter{std::chrono::steady_clock::now()};
+void Runner::next() {
+    realtime::Scope realtime;
+    const auto start = std::chrono::steady_clock::now();
+
     Context context;
     context.timestamp = now_;
     debug("timestamp=" << context.timestamp << "ns");
 
-    std::queue<NodeWrapper*> order;
-    for (auto& [_, wrapper] : wrappers.id_wrapper_map) order.push(&wrapper);
+    dispatch_parameters();
 
-    while (!order.empty()) {
-        NodeWrapper* wrapper = order.front();
-        order.pop();
+    const size_t skipped = skipped_.load(std::memory_order_relaxed);
+    for (size_t level = 0; level + 1 < level_offsets_.size(); ++level) {
+        invoke_level(level, context);
+    }
 
-        assert(wrapper != nullptr);
-        if (wrapper->node == nullptr) continue;
+    now_ += Samples::time_from_batches(1);
+    batches_++;
 
-        GenericNode& node = *wrapper->node;
-        const auto& outputs = wrapper->outputs;
+    const auto end = std::chrono::steady_clock::now();
+    if (profiler_) profiler_->add_batch(start, end);
+    report_realtime_factor(start, end, skipped_.load(std::memory_order_relaxed) - skipped, plan_.size());
+}
+
+//
+// #############################################################################
+//
 
-        // Try to invoke the node if it's ready
-        if (!node.invoke(context)) {
-            // We'll check again later
-            order.push(wrapper);
+void Runner::set_profiling(bool enabled, size_t trace_events) {
+    if (!enabled) {
+        profiler_.reset();
+        return;
+    }
+    profiler_ = std::make_unique<Profiler>(trace_events);
+    profiler_->reset(names());
+}
+
+//
+// #############################################################################
+//
+
+Profile Runner::profile() const { return profiler_ ? profiler_->profile() : Profile{}; }
+
+//
+// #############################################################################
+//
+
+void Runner::reset_profile() {
+    if (profiler_) profiler_->clear();
+}
+
+//
+// #############################################################################
+//
+
+void Runner::write_trace(std::ostream& stream) const {
+    if (profiler_) {
+        profiler_->write_trace(stream);
+    } else {
+        Profiler{0}.write_trace(stream);
+    }
+}
+
+//
+// #############################################################################
+//
+
+std::vector<std::string> Runner::names() const {
+    std::vector<std::string> names;
+    names.reserve(plan_.size());
+    for (const Step& step : plan_) names.push_back(step.node->name());
+    return names;
+}
+
+//
+// #############################################################################
+//
+
+void Runner::dispatch_parameters() {
+    if (parameters_ == nullptr) return;
+
+    const std::chrono::nanoseconds end = now_ + Samples::batch_increment();
+    ParameterEvent event;
+    while (held_ || parameters_->pop(event)) {
+        if (held_) {
+            event = *held_;
+            held_.reset();
+        }
+
+        std::chrono::nanoseconds time = event.time - parameter_offset_;
+        if (time < now_ || time > now_ + kMaxParameterDelay) {
+            parameter_offset_ = event.time - now_;
+            time = now_;
+        }
+
+        if (time >= end) {
+            held_ = event;
+            return;
+        }
+
+        // Events for nodes which have been removed are dropped
+        auto it = injectors_.find(event.node_id);
+        if (it != injectors_.end()) it->second->schedule(event.value, Samples::samples_from_time(time - now_));
+    }
+}
+
+//
+// #############################################################################
+//
+
+void Runner::invoke_level(size_t level, const Context& context) {
+    const size_t begin = level_offsets_[level];
+    const size_t bank = bank_offsets_[level];
+    const size_t end = level_offsets_[level + 1];
+
+    // The bank runs as a single task after the nodes which aren't being banked
+    const size_t size = bank - begin + (bank < end ? 1 : 0);
+
+    auto invoke = [&](size_t i) {
+        if (begin + i == bank) {
+            invoke_bank(bank, end, context);
+            return;
+        }
+
+        const Step& step = plan_[begin + i];
+        assert(step.node != nullptr);
+
+        // Since the plan is sorted, every source has been invoked by now. Summing the inputs is timed with the node.
+        if (profiler_) {
+            const auto start = std::chrono::steady_clock::now();
+            mix(step);
+            if (!skip_if_idle(step)) step.node->invoke(context);
+            promote(step);
+            profiler_->add_step(begin + i, start, std::chrono::steady_clock::now());
+        } else {
+            mix(step);
+            if (!skip_if_idle(step)) step.node->invoke(context);
+            promote(step);
+        }
+    };
+
+    if (pool_) {
+        pool_->run(size, invoke);
+    } else {
+        for (size_t i = 0; i < size; ++i) invoke(i);
+    }
+}
+
+//
+// #############################################################################
+//
+
+void Runner::invoke_bank(size_t begin, size_t end, const Context& context) {
+    const auto start = profiler_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+    bank_.clear();
+    for (size_t s = begin; s < end; ++s) {
+        const Step& step = plan_[s];
+        mix(step);
+        if (skip_if_idle(step)) continue;
+
+        // Anything which can't be banked this batch (a filter with a modulated cutoff, say) is invoked as normal
+        if (!step.node->as_biquad()->add_to(bank_)) step.node->invoke(context);
+    }
+    bank_.process(Samples::batch_size());
+    for (size_t s = begin; s < end; ++s) promote(plan_[s]);
+
+    if (profiler_) {
+        // There's no telling how long each filter took on its own, so they all get an equal share
+        const auto share = (std::chrono::steady_clock::now() - start) / (end - begin);
+        for (size_t s = begin; s < end; ++s) {
+            profiler_->add_step(s, start + (s - begin) * share, start + (s + 1 - begin) * share);
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+void Runner::mix(const Step& step) {
+    for (size_t m = step.mixes_begin; m < step.mixes_end; ++m) {
+        const Mix& mix = mixes_[m];
+
+        // Sources are always summed in the same order so the results don't depend on threading
+        Samples& destination = *mix.destination;
+        bool silent = true;
+        bool constant = true;
+        for (size_t source = mix.sources_begin; source < mix.sources_end; ++source) {
+            silent &= mix_sources_[source]->silent;
+            constant &= mix_sources_[source]->constant;
+        }
+
+        // Nothing needs summing when it's all silence, which the destination might already be
+        if (silent) {
+            if (!destination.silent) destination.fill(0.f);
             continue;
         }
 
-        for (size_t output_index = 0; output_index < outputs.size(); output_index++) {
-            const auto output = node.get_output(output_index);
-            for (auto& [input_index, input_node] : outputs[output_index]) {
-                input_node->add_input(input_index, output);
+        // Control rate inputs only need the first sample, and constant ones can be filled with it
+        if (mix.control || constant) {
+            float value = mix_sources_[mix.sources_begin]->samples[0];
+            for (size_t source = mix.sources_begin + 1; source < mix.sources_end; ++source) {
+                value += mix_sources_[source]->samples[0];
+            }
+            if (mix.control) {
+                destination.samples[0] = value;
+                destination.constant = true;
+                destination.silent = value == 0.f;
+            } else {
+                destination.fill(value);
             }
+            continue;
         }
-    }
 
-    now_ += Samples::time_from_batches(1);
+        destination.copy(*mix_sources_[mix.sources_begin]);
+        for (size_t source = mix.sources_begin + 1; source < mix.sources_end; ++source) {
+            destination.sum(mix_sources_[source]->samples);
+        }
+    }
 }
 
 //
 // #############################################################################
 //
 
-Runner::ScopedPrinter::~ScopedPrinter() {
-    constexpr std::chrono::seconds kInc{10};
+void Runner::promote(const Step& step) {
+    for (size_t p = step.promotions_begin; p < step.promotions_end; ++p) {
+        Promotion& promotion = promotions_[p];
+        const float value = promotion.source->samples[0];
+        if (value == promotion.filled) continue;
 
-    if (start < next_) return;
-    auto d = std::chrono::steady_clock::now() - start;
-    std::cout << "Runner::next() " << Samples::kBatchIncrement << " simulated in " << d << " ("
-              << (Samples::kBatchIncrement / d) << "x realtime)\n";
+        // Ramping from the previous value means the audio rate inputs never see a step, the first batch has nothing
+        // to ramp from
+        Samples& destination = *promotion.destination;
+        if (value == promotion.previous || std::isnan(promotion.previous)) {
+            destination.fill(value);
+            promotion.filled = value;
+        } else {
+            destination.ramp(promotion.previous, value);
+            promotion.filled = std::numeric_limits<float>::quiet_NaN();
+        }
+        promotion.previous = value;
+    }
+}
+
+//
+// #############################################################################
+//
+
+bool Runner::skip_if_idle(const Step& step) {
+    if (!skipping_ || !step.node->idle()) return false;
 
-    next_ = start + kInc;
+    step.node->skip();
+    skipped_.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
-std::chrono::steady_clock::time_point Runner::ScopedPrinter::next_ = std::chrono::steady_clock::now();
+//
+// #############################################################################
+//
 
+Runner::SkipStats Runner::skip_stats() const {
+    SkipStats stats;
+    stats.invocations = batches_ * plan_.size();
+    stats.skipped = skipped_.load(std::memory_order_relaxed);
+
+    const std::chrono::duration<double> generated = Samples::time_from_batches(batches_);
+    if (batches_ > 0) stats.skipped_per_second = stats.skipped / generated.count();
+    return stats;
+}
 }  // namespace synth
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
-#include <queue>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
+#include "synth/biquad.hh"
 #include "synth/node.hh"
+#include "synth/parameters.hh"
+#include "synth/profiler.hh"
+#include "synth/thread_pool.hh"
 
 namespace synth {
 
@@ -22,16 +27,184 @@ struct NodeWrappers {
 
 class Runner {
 public:
-    void run_for_at_least(const std::chrono::nanoseconds& duration, NodeWrappers& wrappers);
-    void next(NodeWrappers& wrappers);
+    ///
+    /// @brief Opt in to running independent nodes across multiple threads (1 runs everything on the calling thread).
+    /// The output is identical to the single threaded version since inputs are always summed in plan order.
+    ///
+    void set_threads(size_t threads);
+
+    ///
+    /// @brief Run the filter nodes (see BiQuadNode) in each level of the plan together through a single BiQuadBank,
+    /// rather than one at a time. This is on by default, and takes effect the next time the graph is planned.
+    ///
+    void set_banking(bool enabled) { banking_ = enabled; }
+
+    ///
+    /// @brief Skip nodes which are idle (see GenericNode::idle()), which is most of them in a patch that isn't playing
+    /// anything. This is on by default, turning it off is only really useful for comparing against.
+    ///
+    void set_skipping(bool enabled) { skipping_ = enabled; }
+
+    struct SkipStats {
+        /// Every node once per batch
+        size_t invocations = 0;
+        size_t skipped = 0;
+        /// Per second of audio generated
+        double skipped_per_second = 0.0;
+    };
+
+    ///
+    /// @brief How many node invocations have been skipped since the graph was last planned. Like the profile this
+    /// should be called from the thread calling next().
+    ///
+    SkipStats skip_stats() const;
+
+    ///
+    /// @brief Flatten the graph into a topologically sorted execution plan. This needs to be called any time the
+    /// wrappers or their connections change, since the plan holds pointers into the wrappers. Throws if the graph
+    /// contains a cycle.
+    ///
+    void compile(NodeWrappers& wrappers);
+
+    ///
+    /// @brief compile() split in two. plan() does all of the work without modifying any of the nodes, and bind() points
+    /// the node inputs at their buffers (which doesn't allocate). This lets a new graph be planned on one thread while
+    /// another is still running the same nodes, and then be bound on the running thread between batches.
+    ///
+    void plan(NodeWrappers& wrappers);
+    void bind();
+
+    ///
+    /// @brief Pick up the timeline (and any parameter events in flight) from a runner this one is replacing
+    ///
+    void continue_from(const Runner& previous);
+
+    ///
+    /// @brief Read parameter changes from the queue at the start of each batch, passing each one to the injector with
+    /// the matching node id at the sample it lands on. Event times are mapped onto the runner's timeline with a fixed
+    /// offset so the spacing between them is kept, the offset is reset whenever an event would land in the past or
+    /// more than kMaxParameterDelay in the future. The queue needs to outlive the runner (or be reset to nullptr).
+    ///
+    void set_parameters(ParameterQueue* parameters) { parameters_ = parameters; }
+
+    static constexpr std::chrono::milliseconds kMaxParameterDelay{100};
+
+    ///
+    /// @brief Opt in to timing each node as it's invoked (and each batch as a whole). If trace_events isn't 0, that
+    /// many individual invocations are also kept for write_trace(). Everything collected so far is dropped, as it is
+    /// each time the graph is compiled.
+    ///
+    void set_profiling(bool enabled, size_t trace_events = 0);
+    bool profiling() const { return profiler_ != nullptr; }
+
+    ///
+    /// @brief What has been collected since profiling was turned on, empty if it's off. Like everything else here,
+    /// these need to be called from the thread calling next().
+    ///
+    Profile profile() const;
+    void reset_profile();
+    void write_trace(std::ostream& stream) const;
+
+    void run_for_at_least(const std::chrono::nanoseconds& duration);
+    void next();
 
 private:
-    struct ScopedPrinter {
-        std::chrono::steady_clock::time_point start;
-        static std::chrono::steady_clock::time_point next_;
-        ~ScopedPrinter();
+    std::chrono::nanoseconds now_{0};
+
+    ///
+    /// @brief Inputs with a single connection read directly from the output buffer of the node feeding them. Inputs
+    /// with more than one connection get a buffer owned by the runner which the sources are summed into right before
+    /// the node is invoked. Control rate inputs only need the first sample summed.
+    ///
+    struct Mix {
+        Samples* destination;
+        size_t sources_begin;
+        size_t sources_end;
+        bool control;
+    };
+
+    ///
+    /// @brief A control rate output feeding at least one audio rate input gets a full batch in a buffer owned by the
+    /// runner, which is written right after the node producing it is invoked. Any number of inputs can share it.
+    ///
+    struct Promotion {
+        const Samples* source;
+        Samples* destination;
+
+        /// The value promoted last batch, NaN before the first
+        float previous;
+        /// What the destination is currently filled with, NaN if it isn't constant
+        float filled;
     };
-    std::chrono::nanoseconds now_;
-    std::vector<size_t> order_;
+
+    struct Step {
+        GenericNode* node;
+        size_t mixes_begin;
+        size_t mixes_end;
+        size_t promotions_begin;
+        size_t promotions_end;
+    };
+
+    /// Where each output is produced in the plan
+    struct Producer {
+        size_t step;
+        Rate rate;
+    };
+
+    void bind_inputs(const std::unordered_map<const GenericNode*, std::vector<std::vector<const Samples*>>>& sources,
+                     const std::unordered_map<const Samples*, Producer>& producers);
+
+    struct Binding {
+        GenericNode* node;
+        size_t input;
+        const Samples* buffer;
+        Rate rate;
+    };
+
+    /// Name of the node for each step of the plan
+    std::vector<std::string> names() const;
+
+    void dispatch_parameters();
+    void invoke_level(size_t level, const Context& context);
+    void invoke_bank(size_t begin, size_t end, const Context& context);
+    void mix(const Step& step);
+    /// Returns true if the node was idle, and skipped instead of being invoked
+    bool skip_if_idle(const Step& step);
+    void promote(const Step& step);
+
+    /// Each node will appear after all of the nodes which feed into it
+    std::vector<Step> plan_;
+
+    /// The plan is grouped into levels of nodes which only depend on nodes from previous levels, level i is the range
+    /// [level_offsets_[i], level_offsets_[i + 1]) of the plan.
+    std::vector<size_t> level_offsets_;
+
+    /// Filter nodes are moved to the end of their level to be banked, in level i these are the range
+    /// [bank_offsets_[i], level_offsets_[i + 1]) of the plan.
+    std::vector<size_t> bank_offsets_;
+    bool banking_ = true;
+    BiQuadBank bank_;
+
+    bool skipping_ = true;
+    /// Since the plan was made, nodes can be skipped from any of the threads
+    std::atomic<size_t> skipped_{0};
+    size_t batches_ = 0;
+
+    std::vector<Mix> mixes_;
+    std::vector<const Samples*> mix_sources_;
+    std::vector<Samples> mix_buffers_;
+    std::vector<Promotion> promotions_;
+    std::vector<Samples> promoted_buffers_;
+    std::vector<Binding> bindings_;
+
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<Profiler> profiler_;
+
+    ParameterQueue* parameters_ = nullptr;
+    std::unordered_map<size_t, InjectorNode*> injectors_;
+    /// The next event if it's for a later batch, events are in time order so nothing behind it needs to be looked at
+    std::optional<ParameterEvent> held_;
+    /// Producer time minus runner time
+    std::chrono::nanoseconds parameter_offset_{0};
 };
 }  // namespace synth
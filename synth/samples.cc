@@ -0,0 +1,52 @@
+#include "synth/samples.hh"
+
+#include <stdexcept>
+#include <string>
+
+namespace synth {
+
+//
+// #############################################################################
+//
+
+bool parse_flag(const std::string& flag, EngineConfig& config) {
+    auto parse = [&flag](const std::string& prefix, auto& value) {
+        if (flag.compare(0, prefix.size(), prefix) != 0) return false;
+        value = std::stoull(flag.substr(prefix.size()));
+        return true;
+    };
+    return parse("--sample_rate=", config.sample_rate) || parse("--batch_size=", config.batch_size) ||
+           parse("--channels=", config.channels) || parse("--latency_batches=", config.latency_batches);
+}
+
+//
+// #############################################################################
+//
+
+void Samples::configure(const EngineConfig& config) {
+    if (config.batch_size == 0 || config.batch_size > kMaxBatchSize) {
+        throw std::runtime_error("Samples::configure() batch size must be in [1, " + std::to_string(kMaxBatchSize) +
+                                 "], got " + std::to_string(config.batch_size));
+    }
+
+    const std::chrono::nanoseconds sample_increment{1'000'000'000 / std::max<uint64_t>(config.sample_rate, 1)};
+    if (config.sample_rate == 0 || sample_increment.count() <= 1) {
+        throw std::runtime_error("Samples::configure() unsupported sample rate: " +
+                                 std::to_string(config.sample_rate));
+    }
+
+    if (config.channels == 0 || config.channels > kMaxChannels) {
+        throw std::runtime_error("Samples::configure() channels must be in [1, " + std::to_string(kMaxChannels) +
+                                 "], got " + std::to_string(config.channels));
+    }
+
+    if (config.latency_batches == 0) {
+        throw std::runtime_error("Samples::configure() needs at least one batch of latency.");
+    }
+
+    config_ = config;
+    sample_increment_ = sample_increment;
+    batch_increment_ = config.batch_size * sample_increment;
+    batch_kernels_ = &kernels::best(config.batch_size);
+}
+}  // namespace synth
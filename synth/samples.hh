@@ -1,39 +1,134 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <string>
+
+#include "synth/kernels.hh"
 
 namespace synth {
-struct Samples {
-    Samples(float value = 0.f) { fill(value); }
 
-    static constexpr uint64_t kSampleRate = 44000;
-    static constexpr uint64_t kBatchSize = 128;
-    static constexpr std::chrono::nanoseconds kSampleIncrement{1'000'000'000 / kSampleRate};
-    static constexpr std::chrono::nanoseconds kBatchIncrement{kBatchSize * kSampleIncrement};
+///
+/// @brief Settings picked once at startup (before any nodes are constructed) with Samples::configure()
+///
+struct EngineConfig {
+    uint64_t sample_rate = 44000;
+    size_t batch_size = 128;
+
+    /// Number of output channels, audio leaving the graph is interleaved frames of this many samples
+    size_t channels = 2;
+
+    /// How far ahead of the audio device samples are generated when it pulls audio from the graph
+    size_t latency_batches = 2;
+};
+
+///
+/// @brief Parse a --sample_rate=<hz>, --batch_size=<samples>, --channels=<channels> or --latency_batches=<batches>
+/// command line flag into the config. Returns false if the flag is something else.
+///
+bool parse_flag(const std::string& flag, EngineConfig& config);
 
-    static constexpr std::chrono::nanoseconds time_from_samples(size_t samples) { return samples * kSampleIncrement; }
-    static constexpr size_t samples_from_time(const std::chrono::nanoseconds& t) { return t / kSampleIncrement; }
+struct alignas(64) Samples {
+    Samples(float value = 0.f) {
+        // Buffers are usually written directly once they're made, so they don't start out claiming anything
+        fill(value);
+        clear_flags();
+    }
 
-    static constexpr std::chrono::nanoseconds time_from_batches(size_t batches) { return batches * kBatchIncrement; }
-    static constexpr size_t batches_from_time(const std::chrono::nanoseconds& t) { return t / kBatchIncrement; }
+    /// Storage is sized for the largest batch, only the first batch_size() samples are used
+    static constexpr size_t kMaxBatchSize = 1024;
 
-    static_assert(kSampleIncrement.count() > 1);
-    std::array<float, kBatchSize> samples;
+    /// Most output channels supported, enough for 7.1
+    static constexpr size_t kMaxChannels = 8;
+
+    ///
+    /// @brief Set the sample rate and batch size used by everything. This will throw if the config isn't supported.
+    /// NOTE: This isn't thread safe, and any existing Samples or nodes should be considered invalid afterwards.
+    ///
+    static void configure(const EngineConfig& config);
+    static const EngineConfig& config() { return config_; }
+
+    static uint64_t sample_rate() { return config_.sample_rate; }
+    static size_t batch_size() { return config_.batch_size; }
+    static size_t channels() { return config_.channels; }
+    static std::chrono::nanoseconds sample_increment() { return sample_increment_; }
+    static std::chrono::nanoseconds batch_increment() { return batch_increment_; }
+
+    static std::chrono::nanoseconds time_from_samples(size_t samples) { return samples * sample_increment_; }
+    static size_t samples_from_time(const std::chrono::nanoseconds& t) { return t / sample_increment_; }
+
+    static std::chrono::nanoseconds time_from_batches(size_t batches) { return batches * batch_increment_; }
+    static size_t batches_from_time(const std::chrono::nanoseconds& t) { return t / batch_increment_; }
+
+    ///
+    /// @brief Kernels which have been specialized for the configured batch size (when it's a common one). These should
+    /// only be used on entire batches.
+    ///
+    static const kernels::Table& batch_kernels() {
+        // Nothing configured yet, the general kernels work for any size
+        return batch_kernels_ != nullptr ? *batch_kernels_ : kernels::best();
+    }
+
+    std::array<float, kMaxBatchSize> samples;
+
+    ///
+    /// @brief What's known about the batch, false only means nothing is. Writing through fill() and copy() keeps these
+    /// up to date and anything else here clears them, but writing to the samples directly doesn't touch them (which is
+    /// why nodes have the flags on their outputs cleared before they're invoked).
+    ///
+    bool constant = false;
+    bool silent = false;
+
+    void clear_flags() {
+        constant = false;
+        silent = false;
+    }
 
     ///
     /// @brief Populate the samples array with a generator. The function should take the sample number within the batch
     ///
     template <typename F>
     void populate_samples(F f) {
-        for (size_t i = 0; i < kBatchSize; ++i) samples[i] = f(i);
+        const size_t size = batch_size();
+        for (size_t i = 0; i < size; ++i) samples[i] = f(i);
+        clear_flags();
     }
 
-    void sum(const std::array<float, kBatchSize>& rhs, float weight = 1.0) {
-        for (size_t i = 0; i < kBatchSize; ++i) samples[i] += weight * rhs[i];
+    void sum(const std::array<float, kMaxBatchSize>& rhs, float weight = 1.0) {
+        batch_kernels().add(samples.data(), rhs.data(), weight, batch_size());
+        clear_flags();
     }
-    void combine(float weight, const std::array<float, kBatchSize>& rhs, float rhs_weight) {
-        for (size_t i = 0; i < kBatchSize; ++i) samples[i] = weight * samples[i] + rhs_weight * rhs[i];
+    void combine(float weight, const std::array<float, kMaxBatchSize>& rhs, float rhs_weight) {
+        batch_kernels().scale(samples.data(), samples.data(), weight, batch_size());
+        batch_kernels().add(samples.data(), rhs.data(), rhs_weight, batch_size());
+        clear_flags();
     }
-    void fill(float value) { std::fill(samples.begin(), samples.end(), value); }
+    void fill(float value) {
+        batch_kernels().fill(samples.data(), value, batch_size());
+        constant = true;
+        silent = value == 0.f;
+    }
+
+    ///
+    /// @brief Move linearly from the value before this batch to the given one, landing on it with the last sample
+    ///
+    void ramp(float from, float to) {
+        const size_t size = batch_size();
+        const float step = (to - from) / size;
+        for (size_t i = 0; i + 1 < size; ++i) samples[i] = from + (i + 1) * step;
+        samples[size - 1] = to;
+        clear_flags();
+    }
+    void copy(const Samples& rhs) {
+        std::copy_n(rhs.samples.begin(), batch_size(), samples.begin());
+        constant = rhs.constant;
+        silent = rhs.silent;
+    }
+
+private:
+    inline static EngineConfig config_{};
+    inline static std::chrono::nanoseconds sample_increment_{1'000'000'000 / EngineConfig{}.sample_rate};
+    inline static std::chrono::nanoseconds batch_increment_{EngineConfig{}.batch_size * sample_increment_};
+    inline static const kernels::Table* batch_kernels_ = nullptr;
 };
 }  // namespace synth
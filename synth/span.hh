@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace synth {
+
+///
+/// @brief Non-owning view of a contiguous range of elements (a minimal std::span until we move to C++20)
+///
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+
+    /// From anything with data() and size(), like std::vector or std::array
+    template <typename Container,
+              typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+    Span(Container& container) : Span(container.data(), container.size()) {}
+
+    /// Span<T> -> Span<const T>
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Span(const Span<U>& rhs) : Span(rhs.data(), rhs.size()) {}
+
+public:
+    T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& operator[](size_t index) const { return data_[index]; }
+
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+
+    ///
+    /// @brief View of [offset, offset + count), clipped to the end of this span
+    ///
+    Span subspan(size_t offset, size_t count = static_cast<size_t>(-1)) const {
+        offset = offset < size_ ? offset : size_;
+        return {data_ + offset, count < size_ - offset ? count : size_ - offset};
+    }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+}  // namespace synth
@@ -1,5 +1,8 @@
 #include "synth/stream.hh"
 
+#include <algorithm>
+#include <cstring>
+
 #include "synth/debug.hh"
 
 namespace synth {
@@ -8,21 +11,46 @@ namespace synth {
 // #############################################################################
 //
 
-Stream::Stream() : batches_(100, true), output_(Samples::kSampleRate) {}
+Stream::Stream(size_t channels)
+    : channels_(channels),
+      batch_size_(Samples::batch_size()),
+      history_(kHistoryBatches * channels * batch_size_) {
+    if (channels == 0 || channels > Samples::kMaxChannels) throw std::runtime_error("Stream() unsupported channels.");
+}
 
 //
 // #############################################################################
 //
 
 void Stream::add_samples(const std::chrono::nanoseconds& timestamp, const Samples& samples) {
+    const Samples* channels[] = {&samples};
+    add_samples(timestamp, Span<const Samples* const>{channels, 1});
+}
+
+//
+// #############################################################################
+//
+
+void Stream::add_samples(const std::chrono::nanoseconds& timestamp, Span<const Samples* const> channels) {
+    if (channels.size() != channels_) throw std::runtime_error("Stream::add_samples() wrong number of channels.");
+
     if (end_time_ && timestamp <= *end_time_) {
-        // Instead of using push(), we'll add them to the existing samples
-        batches_[index_of_timestamp(timestamp)].sum(samples.samples);
+        // Instead of using push(), we'll add them to the existing samples (which silence wouldn't change)
+        const size_t index = index_of_timestamp(timestamp);
+        for (size_t c = 0; c < channels.size(); ++c) {
+            if (channels[c]->silent) continue;
+            Samples::batch_kernels().add(batch(c, index), channels[c]->samples.data(), 1.f, batch_size_);
+        }
         return;
     }
 
+    if (buffered_batches() == kHistoryBatches) throw std::runtime_error("Stream::add_samples() history is full.");
+
     end_time_ = timestamp;  // store the timestamp of the start of this batch
-    batches_.push(samples);
+    write_++;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        std::copy_n(channels[c]->samples.data(), batch_size_, batch(c, buffered_batches() - 1));
+    }
 }
 
 //
@@ -30,10 +58,28 @@ void Stream::add_samples(const std::chrono::nanoseconds& timestamp, const Sample
 //
 
 size_t Stream::flush() {
-    size_t batches = buffered_batches();
-    for (float sample : flush_new()) {
-        output_.push(sample);
+    const size_t batches = buffered_batches();
+    const size_t batch_size = Samples::batch_size();
+    const size_t batch_samples = batch_size * channels();
+
+    // The ring only ever holds whole frames, so the wrap point can split a batch but never a frame
+    ThreadSafeBuffer& output = this->output();
+    auto region = output.prepare_write(batches * batch_samples);
+    const size_t first_frames = region.first.size() / channels();
+    size_t written = 0;
+    for (size_t frame = 0; written + batch_samples <= region.size(); frame += batch_size, written += batch_samples) {
+        // How many of this batch's frames land before the wrap
+        const size_t split = std::min(batch_size, first_frames > frame ? first_frames - frame : 0);
+        if (split > 0) write_batch(region.first.data() + written, 0, split);
+        if (split < batch_size) {
+            write_batch(region.second.data() + (frame + split - first_frames) * channels(), split, batch_size);
+        }
+        drop();
     }
+    output.commit_write(written);
+
+    // Whatever didn't fit has already been counted as an overrun
+    read_ = write_;
     return batches;
 }
 
@@ -41,19 +87,24 @@ size_t Stream::flush() {
 // #############################################################################
 //
 
-std::vector<float> Stream::flush_new() {
-    const size_t batches = buffered_batches();
+size_t Stream::flush(Span<float> frames) {
+    const size_t batch_samples = Samples::batch_size() * channels();
 
-    std::vector<float> output;
-    output.resize(Samples::kBatchSize * batches);
-    for (size_t i = 0; i < batches; ++i) {
-        auto element = batches_.pop();
-
-        void* destination = output.data() + i * Samples::kBatchSize;
-        const void* source = element->samples.data();
-        std::memcpy(destination, source, sizeof(float) * Samples::kBatchSize);
+    size_t written = 0;
+    for (; buffered_batches() > 0 && written + batch_samples <= frames.size(); written += batch_samples) {
+        write_batch(frames.data() + written, 0, Samples::batch_size());
+        drop();
     }
+    return written;
+}
 
+//
+// #############################################################################
+//
+
+std::vector<float> Stream::flush_new() {
+    std::vector<float> output(buffered_batches() * Samples::batch_size() * channels());
+    flush(output);
     return output;
 }
 
@@ -61,38 +112,87 @@ std::vector<float> Stream::flush_new() {
 // #############################################################################
 //
 
+bool Stream::mix_into(Span<float> frames) {
+    if (buffered_batches() == 0) return false;
+
+    const size_t batch_size = Samples::batch_size();
+    const size_t channels = channels_;
+    if (frames.size() < batch_size * channels) throw std::runtime_error("Stream::mix_into() frames are too small.");
+
+    for (size_t c = 0; c < channels; ++c) {
+        const float* samples = batch(c, 0);
+        for (size_t s = 0; s < batch_size; ++s) frames[s * channels + c] += samples[s];
+    }
+    drop();
+    return true;
+}
+
+//
+// #############################################################################
+//
+
 size_t Stream::index_of_timestamp(const std::chrono::nanoseconds& timestamp) const {
-    if (batches_.empty() || !end_time_) throw std::runtime_error("Can't get index without adding samples.");
+    if (buffered_batches() == 0 || !end_time_) throw std::runtime_error("Can't get index without adding samples.");
 
     // The start time of the oldest element in the buffer
-    std::chrono::nanoseconds start_time = *end_time_ - Samples::kBatchIncrement * (batches_.size() - 1);
+    std::chrono::nanoseconds start_time = *end_time_ - Samples::batch_increment() * (buffered_batches() - 1);
 
     if (timestamp < start_time) {
-        std::cerr << "Timestamp: " << timestamp << " is before " << start_time << ". End time: " << *end_time_ << ", "
-                  << batches_.size() << " batches buffered\n";
+        throttled(1.0, "Timestamp: " << timestamp << " is before " << start_time << ". End time: " << *end_time_ << ", "
+                                     << buffered_batches() << " batches buffered");
         throw std::runtime_error("Asking for timestamp before start of buffer.");
     }
 
     // 0 will be the oldest entry, batches_.size() - 1 will be the latest
-    return (timestamp - start_time) / Samples::kBatchIncrement;
+    return (timestamp - start_time) / Samples::batch_increment();
 }
 
 //
 // #############################################################################
 //
 
-ThreadSafeBuffer& Stream::output() { return output_; }
+ThreadSafeBuffer& Stream::output() {
+    if (!output_) output_ = std::make_unique<ThreadSafeBuffer>(channels_ * Samples::sample_rate());
+    return *output_;
+}
 
 //
 // #############################################################################
 //
 
 void Stream::clear() {
-    while (batches_.pop()) {
+    read_ = write_;
+
+    if (output_) output_->clear();
+}
+
+//
+// #############################################################################
+//
+
+size_t Stream::buffered_batches() const { return write_ - read_; }
+
+//
+// #############################################################################
+//
+
+size_t Stream::channels() const { return channels_; }
+
+//
+// #############################################################################
+//
+
+void Stream::write_batch(float* destination, size_t begin, size_t end) const {
+    if (begin >= end) return;
+
+    if (channels() == 1) {
+        std::memcpy(destination, batch(0, 0) + begin, sizeof(float) * (end - begin));
+        return;
     }
 
-    float dummy;
-    while (output_.pop(dummy)) {
+    for (size_t c = 0; c < channels(); ++c) {
+        const float* samples = batch(c, 0);
+        for (size_t s = begin; s < end; ++s) destination[(s - begin) * channels() + c] = samples[s];
     }
 }
 
@@ -100,14 +200,23 @@ void Stream::clear() {
 // #############################################################################
 //
 
-size_t Stream::buffered_batches() const { return batches_.size(); }
+float* Stream::batch(size_t channel, size_t index) {
+    return history_.data() + (((read_ + index) % kHistoryBatches) * channels_ + channel) * batch_size_;
+}
+
+//
+// #############################################################################
+//
+
+const float* Stream::batch(size_t channel, size_t index) const {
+    return history_.data() + (((read_ + index) % kHistoryBatches) * channels_ + channel) * batch_size_;
+}
 
 //
 // #############################################################################
 //
 
-void Stream::default_flush() {
-    throttled(1.0, "Warning: Stream::flush_samples() with end time past end of buffer. Padding with 0s.");
-    for (size_t el = 0; el < Samples::kBatchSize; ++el) output().push(0);
+void Stream::drop() {
+    if (buffered_batches() > 0) read_++;
 }
 }  // namespace synth
@@ -3,37 +3,87 @@
 #include <chrono>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "synth/buffer.hh"
 #include "synth/samples.hh"
 
 namespace synth {
+
+///
+/// @brief Collects batches from the graph (summing any with the same timestamp) and flushes them out as interleaved
+/// frames with the given number of channels
+///
 class Stream {
 public:
-    Stream();
+    explicit Stream(size_t channels = 1);
 
+    /// For mono streams
     void add_samples(const std::chrono::nanoseconds& timestamp, const Samples& samples);
 
+    /// One batch for each of the channels
+    void add_samples(const std::chrono::nanoseconds& timestamp, Span<const Samples* const> channels);
+
     size_t index_of_timestamp(const std::chrono::nanoseconds& timestamp) const;
 
-    /// Returns the number of elements flushed to the output
+    ///
+    /// @brief Flush every buffered batch to output(), returning the number of batches. They're written straight into
+    /// the ring, anything which doesn't fit is dropped (and counted as an overrun). This doesn't allocate once the
+    /// ring exists.
+    ///
     size_t flush();
+
+    ///
+    /// @brief Flush as many whole batches as fit into the frames, returning the number of samples written. This
+    /// doesn't allocate.
+    ///
+    size_t flush(Span<float> frames);
+
+    /// Same as above, but returns everything that was buffered in a new vector
     std::vector<float> flush_new();
 
+    ///
+    /// @brief Pop the oldest batch and add it to the frames as interleaved samples, which must have room for a batch
+    /// of frames. Returns false (leaving the frames alone) if nothing was buffered. This doesn't allocate.
+    ///
+    bool mix_into(Span<float> frames);
+
     size_t buffered_batches() const;
 
+    size_t channels() const;
+
+    ///
+    /// @brief Interleaved frames written by flush(). Most streams are only read with mix_into() and never need this, so
+    /// it's allocated (about a second of audio) the first time it's asked for.
+    ///
     ThreadSafeBuffer& output();
 
     void clear();
 
 private:
-    /// Flushes all zeros to the output
-    void default_flush();
+    /// Interleave the oldest batch into the destination, which holds the batch's frames from [begin, end)
+    void write_batch(float* destination, size_t begin, size_t end) const;
+
+    /// Samples for one channel of the batch index batches after the oldest one
+    float* batch(size_t channel, size_t index);
+    const float* batch(size_t channel, size_t index) const;
+
+    /// Discard the oldest batch from every channel
+    void drop();
 
 private:
     // The most recent samples timestamp (other timestamps are calculated with respect to this
     std::optional<std::chrono::nanoseconds> end_time_;
-    Buffer<Samples> batches_;
-    ThreadSafeBuffer output_;
+    static constexpr size_t kHistoryBatches = 100;
+
+    size_t channels_;
+    size_t batch_size_;
+
+    // Ring of kHistoryBatches batches, each of which is batch_size_ samples for each channel back to back. Only the
+    // configured batch size is stored (rather than whole Samples) since this is copied into for every batch.
+    std::vector<float> history_;
+    size_t write_ = 0;
+    size_t read_ = 0;
+    std::unique_ptr<ThreadSafeBuffer> output_;
 };
 }  // namespace synth
@@ -2,6 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <limits>
+#include <vector>
+
 /// For validating coefficients: https://www.earlevel.com/main/2013/10/13/biquad-calculator-v2/
 /// Note that they use a different coefficient mapping from us. Specifically the b's and a's are flipped
 
@@ -46,4 +50,231 @@ TEST(BiQuad, HPF_process) {
         EXPECT_NEAR(filter.process(0.9096279505973077), -0.002842106651871179, 1E-6);
     }
 }
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, coeff) {
+    const auto lpf = BiQuadFilter::coeff(BiQuadFilter::Type::kLpf, 600.0, 6.0, 1.0);
+    EXPECT_EQ(lpf.b0, BiQuadFilter::low_pass_filter(600.0, 6.0, 1.0).b0);
+    const auto hpf = BiQuadFilter::coeff(BiQuadFilter::Type::kHpf, 600.0, 6.0, 1.0);
+    EXPECT_EQ(hpf.b0, BiQuadFilter::high_pass_filter(600.0, 6.0, 1.0).b0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, process_block) {
+    std::vector<float> input(1000);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = std::sin(0.05 * i) + 0.5 * std::sin(1.3 * i);
+
+    BiQuadFilter single;
+    single.set_coeff(BiQuadFilter::low_pass_filter(800.0, 3.0, 1.0));
+    std::vector<float> expected(input.size());
+    for (size_t i = 0; i < input.size(); ++i) expected[i] = single.process(input[i]);
+
+    // Blocks of any size pick up where the last one left off
+    BiQuadFilter block;
+    block.set_coeff(BiQuadFilter::low_pass_filter(800.0, 3.0, 1.0));
+    std::vector<float> output(input.size());
+    for (size_t begin = 0, size = 1; begin < input.size(); begin += size, size = 2 * size + 1) {
+        block.process_block(Span<const float>{input}.subspan(begin, size), Span<float>{output}.subspan(begin, size));
+    }
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_EQ(output[i], expected[i]) << "index: " << i;
+
+    // Float is close enough, and in place is fine
+    BiQuadFilter low_precision;
+    low_precision.set_coeff(BiQuadFilter::low_pass_filter(800.0, 3.0, 1.0));
+    low_precision.set_precision(BiQuadFilter::Precision::kFloat);
+    output = input;
+    low_precision.process_block(output, output);
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_NEAR(output[i], expected[i], 1E-4) << "index: " << i;
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, nan_and_denormals) {
+    BiQuadFilter filter;
+    filter.set_coeff(BiQuadFilter::low_pass_filter(800.0, 3.0, 1.0));
+
+    std::vector<float> samples(64, 1.0);
+    samples[10] = std::numeric_limits<float>::quiet_NaN();
+    EXPECT_THROW(filter.process_block(samples, samples), std::runtime_error);
+
+    // Once thrown the filter starts over instead of being stuck on NaN
+    std::vector<float> silence(64, 0.0);
+    filter.process_block(silence, silence);
+    for (float sample : silence) ASSERT_EQ(sample, 0.0);
+
+    // A decaying tail is flushed to zero well before it would be denormal
+    std::vector<float> impulse(64, 0.0);
+    impulse[0] = 1.0;
+    filter.process_block(impulse, impulse);
+    std::vector<float> tail(64);
+    for (size_t block = 0; block < 1000; ++block) {
+        std::fill(tail.begin(), tail.end(), 0.f);
+        filter.process_block(tail, tail);
+    }
+    for (float sample : tail) ASSERT_EQ(sample, 0.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, cascade) {
+    // Steady state amplitude of a sine at the given frequency after going through the filter
+    auto gain = [](BiQuadCascade& cascade, double frequency) {
+        cascade.reset();
+        std::vector<float> samples(20000);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            samples[i] = std::sin(2.0 * M_PI * frequency * i / Samples::sample_rate());
+        }
+        cascade.process_block(samples, samples);
+
+        float peak = 0.0;
+        for (size_t i = samples.size() / 2; i < samples.size(); ++i) peak = std::max(peak, std::abs(samples[i]));
+        return peak;
+    };
+
+    for (size_t order : {2, 4, 8}) {
+        BiQuadCascade cascade;
+        cascade.set_butterworth(BiQuadFilter::Type::kLpf, order, 1000.0);
+        EXPECT_EQ(cascade.sections(), order / 2);
+
+        // Maximally flat in the passband, 3dB down at the cutoff and then falling off at 6dB per octave per order
+        EXPECT_NEAR(gain(cascade, 100.0), 1.0, 1E-2) << "order: " << order;
+        EXPECT_NEAR(gain(cascade, 1000.0), 1.0 / std::sqrt(2.0), 1E-2) << "order: " << order;
+        const double stopband = std::pow(4.0, -static_cast<double>(order));
+        EXPECT_NEAR(gain(cascade, 4000.0), stopband, 0.5 * stopband) << "order: " << order;
+
+        cascade.set_butterworth(BiQuadFilter::Type::kHpf, order, 1000.0);
+        EXPECT_NEAR(gain(cascade, 10000.0), 1.0, 2E-2) << "order: " << order;
+        EXPECT_NEAR(gain(cascade, 1000.0), 1.0 / std::sqrt(2.0), 1E-2) << "order: " << order;
+    }
+
+    BiQuadCascade cascade;
+    EXPECT_THROW(cascade.set_butterworth(BiQuadFilter::Type::kLpf, 3, 1000.0), std::runtime_error);
+    EXPECT_THROW(cascade.set_butterworth(BiQuadFilter::Type::kLpf, 10, 1000.0), std::runtime_error);
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, bank) {
+    constexpr size_t kFilters = 21;
+    constexpr size_t kSize = 100;
+
+    // Every filter has its own cutoff and input, with the references run on their own in float
+    std::vector<BiQuadFilter> filters(kFilters);
+    std::vector<BiQuadFilter> references(kFilters);
+    std::vector<std::vector<float>> inputs(kFilters, std::vector<float>(kSize));
+    std::vector<std::vector<float>> outputs(kFilters, std::vector<float>(kSize));
+    for (size_t f = 0; f < kFilters; ++f) {
+        const auto type = f % 2 == 0 ? BiQuadFilter::Type::kLpf : BiQuadFilter::Type::kHpf;
+        filters[f].set_coeff(type, 200.0 + 300.0 * f, 3.0, 1.0);
+        references[f].set_coeff(type, 200.0 + 300.0 * f, 3.0, 1.0);
+        references[f].set_precision(BiQuadFilter::Precision::kFloat);
+        for (size_t i = 0; i < kSize; ++i) inputs[f][i] = std::sin(0.01 * (f + 1) * i) + 0.3 * std::sin(1.3 * i);
+    }
+
+    BiQuadBank bank;
+    bank.reserve(kFilters);
+    for (size_t block = 0; block < 5; ++block) {
+        bank.clear();
+        for (size_t f = 0; f < kFilters; ++f) bank.add(filters[f], inputs[f].data(), outputs[f].data());
+        EXPECT_EQ(bank.size(), kFilters);
+        bank.process(kSize);
+
+        // The state carries over between blocks, so this also checks it makes it back into the filters
+        for (size_t f = 0; f < kFilters; ++f) {
+            std::vector<float> expected(kSize);
+            references[f].process_block(inputs[f], expected);
+            for (size_t i = 0; i < kSize; ++i) {
+                ASSERT_NEAR(outputs[f][i], expected[i], 1E-4) << "block: " << block << " filter: " << f << " i: " << i;
+            }
+        }
+    }
+
+    // In place, and the filters can carry on without the bank
+    bank.clear();
+    std::vector<float> in_place = inputs[0];
+    bank.add(filters[0], in_place.data(), in_place.data());
+    bank.process(kSize);
+    std::vector<float> expected(kSize);
+    references[0].process_block(inputs[0], expected);
+    for (size_t i = 0; i < kSize; ++i) ASSERT_NEAR(in_place[i], expected[i], 1E-4);
+
+    filters[0].set_precision(BiQuadFilter::Precision::kFloat);
+    for (size_t i = 0; i < kSize; ++i) ASSERT_NEAR(filters[0].process(1.f), references[0].process(1.f), 1E-4);
+
+    // Nothing past what was reserved
+    bank.clear();
+    for (size_t f = 0; f < kFilters; ++f) bank.add(filters[f], inputs[f].data(), outputs[f].data());
+    EXPECT_THROW(bank.add(filters[0], inputs[0].data(), outputs[0].data()), std::runtime_error);
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, table) {
+    for (auto type : {BiQuadFilter::Type::kLpf, BiQuadFilter::Type::kHpf}) {
+        const BiQuadTable table{type, 100.0, 10000.0, 3.0, 1.0};
+        for (float fraction = 0.0; fraction <= 1.0; fraction += 0.0123) {
+            const auto expected = BiQuadFilter::coeff(type, 100.0 + fraction * 9900.0, 3.0, 1.0);
+            const auto coeff = table.at(fraction);
+            EXPECT_NEAR(coeff.b0, expected.b0, 1E-5) << "fraction: " << fraction;
+            EXPECT_NEAR(coeff.b1, expected.b1, 1E-5) << "fraction: " << fraction;
+            EXPECT_NEAR(coeff.b2, expected.b2, 1E-5) << "fraction: " << fraction;
+            EXPECT_NEAR(coeff.a1, expected.a1, 1E-5) << "fraction: " << fraction;
+            EXPECT_NEAR(coeff.a2, expected.a2, 1E-5) << "fraction: " << fraction;
+        }
+
+        // Clamped to the ends
+        EXPECT_NEAR(table.at(-1.0).a1, BiQuadFilter::coeff(type, 100.0, 3.0, 1.0).a1, 1E-9);
+        EXPECT_NEAR(table.at(2.0).a1, BiQuadFilter::coeff(type, 10000.0, 3.0, 1.0).a1, 1E-9);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(BiQuad, ramp) {
+    const auto from = BiQuadFilter::low_pass_filter(200.0, 3.0, 1.0);
+    const auto to = BiQuadFilter::low_pass_filter(800.0, 3.0, 1.0);
+    std::vector<float> input(16);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = std::sin(0.3 * i);
+
+    // Against moving the coefficients by hand every sample
+    BiQuadFilter filter;
+    BiQuadFilter reference;
+    filter.set_coeff(from);
+    std::vector<float> output(input.size());
+    filter.process_ramp(input, output, to);
+    for (size_t i = 0; i < input.size(); ++i) {
+        const double t = static_cast<double>(i + 1) / input.size();
+        reference.set_coeff({from.b0 + t * (to.b0 - from.b0), from.b1 + t * (to.b1 - from.b1),
+                             from.b2 + t * (to.b2 - from.b2), from.a1 + t * (to.a1 - from.a1),
+                             from.a2 + t * (to.a2 - from.a2)});
+        ASSERT_NEAR(output[i], reference.process(input[i]), 1E-6) << "i: " << i;
+    }
+
+    // Ending up on the target
+    EXPECT_NEAR(filter.get_coeff().a1, to.a1, 1E-12);
+    EXPECT_NEAR(filter.get_coeff().b0, to.b0, 1E-12);
+
+    // Ramping to where it already is is just process_block()
+    std::vector<float> ramped(input.size());
+    std::vector<float> blocked(input.size());
+    filter.process_ramp(input, ramped, to);
+    reference.process_block(input, blocked);
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_NEAR(ramped[i], blocked[i], 1E-6) << "i: " << i;
+}
 }  // namespace synth
@@ -2,8 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace synth {
 TEST(ThreadSafeBuffer, basic) {
@@ -19,14 +21,67 @@ TEST(ThreadSafeBuffer, basic) {
     EXPECT_TRUE(buffer.pop(result));
     EXPECT_EQ(result, 20);
 
-    // should exceed capacity at this point
-    buffer.push(10);
-    buffer.push(20);
-    buffer.push(30);
+    // should exceed capacity at this point, the newest entry gets dropped
+    EXPECT_TRUE(buffer.push(10));
+    EXPECT_TRUE(buffer.push(20));
+    EXPECT_FALSE(buffer.push(30));
+    EXPECT_EQ(buffer.overruns(), 1);
     EXPECT_TRUE(buffer.pop(result));
-    EXPECT_NE(result, 10);
+    EXPECT_EQ(result, 10);
     EXPECT_TRUE(buffer.pop(result));
-    EXPECT_NE(result, 10);
+    EXPECT_EQ(result, 20);
+
+    // Polling an empty buffer isn't an underrun
+    EXPECT_FALSE(buffer.pop(result));
+    EXPECT_EQ(buffer.underruns(), 0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(ThreadSafeBuffer, bulk) {
+    ThreadSafeBuffer buffer{5};
+
+    std::vector<float> input{1, 2, 3, 4};
+    EXPECT_EQ(buffer.write(input), 4);
+    EXPECT_EQ(buffer.size(), 4);
+
+    std::vector<float> output(3);
+    EXPECT_EQ(buffer.read(output), 3);
+    EXPECT_EQ(output, (std::vector<float>{1, 2, 3}));
+
+    // This write wraps around the end of the ring, and only 4 of the 5 fit
+    input = {5, 6, 7, 8, 9};
+    EXPECT_EQ(buffer.write(input), 4);
+    EXPECT_EQ(buffer.overruns(), 1);
+
+    auto region = buffer.prepare_read(10);
+    EXPECT_EQ(region.size(), 5);
+    EXPECT_EQ(buffer.underruns(), 5);
+    ASSERT_EQ(region.first.size(), 2);
+    ASSERT_EQ(region.second.size(), 3);
+    EXPECT_EQ(region.first[0], 4);
+    EXPECT_EQ(region.first[1], 5);
+    EXPECT_EQ(region.second[0], 6);
+    EXPECT_EQ(region.second[2], 8);
+    buffer.commit_read(region.size());
+    EXPECT_EQ(buffer.size(), 0);
+
+    // Writing in place
+    auto to = buffer.prepare_write(2);
+    ASSERT_EQ(to.size(), 2);
+    to.first[0] = 10;
+    (to.first.size() > 1 ? to.first[1] : to.second[0]) = 11;
+    EXPECT_EQ(buffer.size(), 0);  // nothing is visible until it's committed
+    buffer.commit_write(2);
+    EXPECT_EQ(buffer.read(output), 2);
+    EXPECT_EQ(output[0], 10);
+    EXPECT_EQ(output[1], 11);
+
+    buffer.write(input);
+    buffer.clear();
+    EXPECT_EQ(buffer.size(), 0);
 }
 
 //
@@ -50,14 +105,18 @@ TEST(ThreadSafeBuffer, threaded) {
             to_push.pop();
         }
     }};
-    bool shutdown = false;
+    std::atomic<bool> shutdown = false;
+    std::atomic<size_t> popped_count = 0;
     std::thread reads{[&]() {
         while (!shutdown) {
-            if (buffer.pop(result)) popped.push(result);
+            if (buffer.pop(result)) {
+                popped.push(result);
+                popped_count++;
+            }
         }
     }};
 
-    for (size_t i = 0; i < 100 && popped.size() < 10; ++i) {
+    for (size_t i = 0; i < 100 && popped_count < 100; ++i) {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
     shutdown = true;
@@ -76,6 +135,54 @@ TEST(ThreadSafeBuffer, threaded) {
 // #############################################################################
 //
 
+TEST(ThreadSafeBuffer, stress) {
+    // Bulk reads and writes of varying sizes which wrap around a small buffer lots of times, meant to be run under TSan
+    // as well (bazel test --config=tsan //synth:synth_test)
+    constexpr size_t kTotal = 200'000;
+    ThreadSafeBuffer buffer{97};
+
+    std::thread writes{[&]() {
+        std::vector<float> batch(41);
+        size_t next = 0;
+        for (size_t iteration = 0; next < kTotal; ++iteration) {
+            const size_t count = std::min(1 + iteration % batch.size(), kTotal - next);
+            auto to = buffer.prepare_write(count);
+            for (float& f : to.first) f = next++;
+            for (float& f : to.second) f = next++;
+            buffer.commit_write(to.size());
+            if (to.size() == 0) std::this_thread::yield();
+
+            // Mix in the copying version too
+            if (iteration % 3 == 0 && next < kTotal) {
+                for (size_t i = 0; i < batch.size(); ++i) batch[i] = next + i;
+                const size_t written = buffer.write(Span<const float>{batch}.subspan(0, kTotal - next));
+                next += written;
+            }
+        }
+    }};
+
+    std::vector<float> batch(29);
+    size_t expected = 0;
+    size_t errors = 0;
+    for (size_t iteration = 0; expected < kTotal; ++iteration) {
+        const size_t read = buffer.read(Span<float>{batch}.subspan(0, 1 + iteration % batch.size()));
+        for (size_t i = 0; i < read; ++i) errors += batch[i] != static_cast<float>(expected++);
+        if (read == 0) std::this_thread::yield();
+
+        float single;
+        if (iteration % 5 == 0 && buffer.pop(single)) errors += single != static_cast<float>(expected++);
+    }
+    writes.join();
+
+    EXPECT_EQ(errors, 0);
+    EXPECT_EQ(expected, kTotal);
+    EXPECT_EQ(buffer.size(), 0);
+}
+
+//
+// #############################################################################
+//
+
 TEST(Buffer, basic) {
     Buffer<int> buffer{2, false};
 
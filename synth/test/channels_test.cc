@@ -0,0 +1,82 @@
+#include "synth/channels.hh"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+namespace synth {
+namespace {
+std::vector<float> frames(size_t count, size_t channels) {
+    std::vector<float> result(count * channels);
+    for (size_t i = 0; i < result.size(); ++i) result[i] = i;
+    return result;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Channels, interleaved) {
+    const auto input = frames(4, 2);
+    std::vector<float> output(input.size(), -1.f);
+
+    std::array<ChannelArea, 2> areas;
+    for (size_t c = 0; c < areas.size(); ++c) {
+        areas[c] = {reinterpret_cast<char*>(output.data() + c), 2 * sizeof(float)};
+    }
+
+    // Split in two, like the two halves of a ring buffer region
+    write_frames(Span<const float>{input}.subspan(0, 2), 2, areas);
+    write_frames(Span<const float>{input}.subspan(2), 2, areas);
+    EXPECT_EQ(output, input);
+    EXPECT_EQ(areas[0].ptr, reinterpret_cast<char*>(output.data() + output.size()));
+}
+
+//
+// #############################################################################
+//
+
+TEST(Channels, planar) {
+    const auto input = frames(4, 2);
+    std::vector<float> left(4, -1.f);
+    std::vector<float> right(4, -1.f);
+    std::array<ChannelArea, 2> areas{ChannelArea{reinterpret_cast<char*>(left.data()), sizeof(float)},
+                                     ChannelArea{reinterpret_cast<char*>(right.data()), sizeof(float)}};
+
+    write_frames(input, 2, areas);
+    EXPECT_EQ(left, (std::vector<float>{0, 2, 4, 6}));
+    EXPECT_EQ(right, (std::vector<float>{1, 3, 5, 7}));
+}
+
+//
+// #############################################################################
+//
+
+TEST(Channels, mismatched_channels) {
+    std::vector<float> output(3 * 2, -1.f);
+    std::array<ChannelArea, 3> areas;
+    auto reset = [&]() {
+        for (size_t c = 0; c < areas.size(); ++c) {
+            areas[c] = {reinterpret_cast<char*>(output.data() + c), 3 * sizeof(float)};
+        }
+    };
+
+    // Mono is played everywhere
+    const auto mono = frames(2, 1);
+    reset();
+    write_frames(mono, 1, areas);
+    EXPECT_EQ(output, (std::vector<float>{0, 0, 0, 1, 1, 1}));
+
+    // Extra device channels are silent
+    const auto stereo = frames(2, 2);
+    reset();
+    write_frames(stereo, 2, areas);
+    EXPECT_EQ(output, (std::vector<float>{0, 1, 0, 2, 3, 0}));
+
+    reset();
+    write_silence(2, areas);
+    EXPECT_EQ(output, std::vector<float>(6, 0.f));
+}
+}  // namespace synth
@@ -0,0 +1,85 @@
+#include "synth/file_writer.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace synth {
+namespace {
+std::vector<char> read_file(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::in | std::ios::binary};
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+template <typename T>
+T read_le(const std::vector<char>& data, size_t offset) {
+    T value = 0;
+    for (size_t byte = 0; byte < sizeof(T); ++byte) {
+        value |= static_cast<T>(static_cast<uint8_t>(data.at(offset + byte))) << (8 * byte);
+    }
+    return value;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(FileWriter, wav) {
+    const auto path = std::filesystem::path(testing::TempDir()) / "file_writer_test.wav";
+    ASSERT_EQ(FileWriter::format_from_path(path), FileWriter::Format::kWav);
+
+    const std::vector<float> samples{0.0, 0.5, -0.5, 1.0, -1.0, 0.25};
+    {
+        FileWriter writer{path, FileWriter::Format::kWav, 48000, 2};
+        writer.write(Span<const float>{samples}.subspan(0, 2));
+        writer.write(Span<const float>{samples}.subspan(2));
+        EXPECT_EQ(writer.samples_written(), samples.size());
+    }
+
+    const auto data = read_file(path);
+    constexpr size_t kHeader = 58;
+    ASSERT_EQ(data.size(), kHeader + sizeof(float) * samples.size());
+
+    EXPECT_EQ(std::string(data.data(), 4), "RIFF");
+    EXPECT_EQ(read_le<uint32_t>(data, 4), data.size() - 8);
+    EXPECT_EQ(std::string(data.data() + 8, 8), "WAVEfmt ");
+    EXPECT_EQ(read_le<uint16_t>(data, 20), 3);  // float
+    EXPECT_EQ(read_le<uint16_t>(data, 22), 2);  // channels
+    EXPECT_EQ(read_le<uint32_t>(data, 24), 48000);
+    EXPECT_EQ(read_le<uint32_t>(data, 28), 48000 * 2 * sizeof(float));
+    EXPECT_EQ(read_le<uint16_t>(data, 34), 32);
+    EXPECT_EQ(std::string(data.data() + 38, 4), "fact");
+    EXPECT_EQ(read_le<uint32_t>(data, 46), samples.size() / 2);
+    EXPECT_EQ(std::string(data.data() + 50, 4), "data");
+    EXPECT_EQ(read_le<uint32_t>(data, 54), sizeof(float) * samples.size());
+
+    std::vector<float> result(samples.size());
+    std::memcpy(result.data(), data.data() + kHeader, sizeof(float) * result.size());
+    EXPECT_EQ(result, samples);
+}
+
+//
+// #############################################################################
+//
+
+TEST(FileWriter, raw) {
+    const auto path = std::filesystem::path(testing::TempDir()) / "file_writer_test.raw";
+    ASSERT_EQ(FileWriter::format_from_path(path), FileWriter::Format::kRaw);
+
+    const std::vector<float> samples{0.0, 0.5, -0.5};
+    FileWriter writer{path, FileWriter::Format::kRaw, 44000};
+    writer.write(samples);
+    writer.close();
+    EXPECT_THROW(writer.write(samples), std::runtime_error);
+
+    const auto data = read_file(path);
+    ASSERT_EQ(data.size(), sizeof(float) * samples.size());
+    std::vector<float> result(samples.size());
+    std::memcpy(result.data(), data.data(), data.size());
+    EXPECT_EQ(result, samples);
+}
+}  // namespace synth
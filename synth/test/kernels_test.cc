@@ -0,0 +1,173 @@
+#include "synth/kernels.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+namespace synth::kernels {
+namespace {
+// Not a multiple of any vector width so the tail is tested too
+constexpr size_t kSize = 131;
+
+std::vector<float> make(float offset) {
+    std::vector<float> v(kSize);
+    for (size_t i = 0; i < kSize; ++i) v[i] = std::sin(0.1 * i + offset) * 2.f;
+    return v;
+}
+
+void expect_near(const std::vector<float>& result, const std::vector<float>& expected, const Table& table) {
+    ASSERT_EQ(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        ASSERT_NEAR(result[i], expected[i], 1E-5) << table.name << " index: " << i;
+    }
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Kernels, available) {
+    auto tables = available();
+    ASSERT_FALSE(tables.empty());
+    EXPECT_EQ(tables.front(), &scalar());
+    EXPECT_EQ(tables.back(), &best());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Kernels, matches_reference) {
+    const auto lhs = make(0.0);
+    const auto rhs = make(1.0);
+    std::vector<float> mix(kSize);
+    for (size_t i = 0; i < kSize; ++i) mix[i] = static_cast<float>(i) / kSize;
+
+    for (const Table* table : available()) {
+        std::vector<float> result(kSize);
+        std::vector<float> expected(kSize);
+
+        table->fill(result.data(), 3.0, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = 3.0;
+        expect_near(result, expected, *table);
+
+        result = lhs;
+        table->add(result.data(), rhs.data(), 0.5, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = lhs[i] + 0.5 * rhs[i];
+        expect_near(result, expected, *table);
+
+        table->multiply(result.data(), lhs.data(), rhs.data(), 10.0, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = 10.0 * lhs[i] * rhs[i];
+        expect_near(result, expected, *table);
+
+        result = mix;
+        table->multiply_add(result.data(), lhs.data(), rhs.data(), kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = mix[i] + lhs[i] * rhs[i];
+        expect_near(result, expected, *table);
+
+        table->scale(result.data(), lhs.data(), -2.0, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = -2.0 * lhs[i];
+        expect_near(result, expected, *table);
+
+        table->clamp(result.data(), lhs.data(), -1.0, 0.5, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = std::clamp(lhs[i], -1.f, 0.5f);
+        expect_near(result, expected, *table);
+
+        table->remap(result.data(), lhs.data(), -1.0, 1.0, 10.0, 1000.0, kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = (std::clamp(lhs[i], -1.f, 1.f) + 1.0) / 2.0 * 990.0 + 10.0;
+        for (size_t i = 0; i < kSize; ++i) ASSERT_NEAR(result[i], expected[i], 1E-3) << table->name;
+
+        table->crossfade(result.data(), lhs.data(), rhs.data(), mix.data(), kSize);
+        for (size_t i = 0; i < kSize; ++i) expected[i] = (1.0 - mix[i]) * lhs[i] + mix[i] * rhs[i];
+        expect_near(result, expected, *table);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Kernels, fixed_size) {
+    constexpr size_t kFixed = 64;
+    const auto lhs = make(0.0);
+
+    for (const Table* table : available(kFixed)) {
+        // Only the fixed number of elements should be touched, no matter what size is passed in
+        std::vector<float> result(kSize, -1.0);
+        table->scale(result.data(), lhs.data(), 2.0, kSize);
+        for (size_t i = 0; i < kSize; ++i) {
+            ASSERT_NEAR(result[i], i < kFixed ? 2.0 * lhs[i] : -1.0, 1E-5) << table->name << " index: " << i;
+        }
+    }
+
+    EXPECT_EQ(&best(kFixed), available(kFixed).back());
+    EXPECT_EQ(&best(0), &best());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Kernels, biquad) {
+    // Enough channels for a group of vectors, a few single vectors and a tail on every instruction set
+    constexpr size_t kChannels = 77;
+    constexpr size_t kFrames = 50;
+
+    std::vector<float> coeff(5 * kChannels);
+    std::vector<float> initial(2 * kChannels);
+    std::vector<float> input(kFrames * kChannels);
+    for (size_t c = 0; c < kChannels; ++c) {
+        // A stable low pass for each channel, each with a different cutoff
+        const double w = 0.05 + 0.01 * c;
+        const double alpha = std::sin(w) / 2.0;
+        const double a0 = 1.0 + alpha;
+        coeff[c] = 0.5 * (1.0 - std::cos(w)) / a0;
+        coeff[kChannels + c] = (1.0 - std::cos(w)) / a0;
+        coeff[2 * kChannels + c] = coeff[c];
+        coeff[3 * kChannels + c] = -2.0 * std::cos(w) / a0;
+        coeff[4 * kChannels + c] = (1.0 - alpha) / a0;
+        initial[c] = 0.1 * std::sin(c);
+        initial[kChannels + c] = 0.1 * std::cos(c);
+    }
+    for (size_t i = 0; i < input.size(); ++i) input[i] = std::sin(0.37 * i);
+
+    // Each channel on its own in double
+    std::vector<float> expected = input;
+    std::vector<float> expected_state = initial;
+    for (size_t c = 0; c < kChannels; ++c) {
+        double s1 = initial[c];
+        double s2 = initial[kChannels + c];
+        for (size_t i = 0; i < kFrames; ++i) {
+            const double x = input[i * kChannels + c];
+            const double y = coeff[c] * x + s1;
+            s1 = coeff[kChannels + c] * x - coeff[3 * kChannels + c] * y + s2;
+            s2 = coeff[2 * kChannels + c] * x - coeff[4 * kChannels + c] * y;
+            expected[i * kChannels + c] = y;
+        }
+        expected_state[c] = s1;
+        expected_state[kChannels + c] = s2;
+    }
+
+    for (const Table* table : available()) {
+        std::vector<float> data = input;
+        std::vector<float> state = initial;
+        table->biquad(data.data(), state.data(), coeff.data(), kChannels, kFrames);
+        expect_near(data, expected, *table);
+        expect_near(state, expected_state, *table);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Kernels, in_place) {
+    // Output is allowed to alias the input
+    auto data = make(0.0);
+    const auto expected = data;
+    scale(data.data(), data.data(), 4.0, kSize);
+    for (size_t i = 0; i < kSize; ++i) ASSERT_NEAR(data[i], 4.0 * expected[i], 1E-5);
+}
+}  // namespace synth::kernels
@@ -0,0 +1,111 @@
+#include "synth/log.hh"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "synth/debug.hh"
+#include "synth/realtime.hh"
+
+namespace synth {
+namespace {
+///
+/// @brief Collects everything written while in scope
+///
+struct Capture {
+    Capture() {
+        log::set_sink([this](const std::string& line) {
+            std::lock_guard lock{mutex};
+            lines.push_back(line);
+        });
+    }
+    ~Capture() { log::set_sink(nullptr); }
+
+    std::vector<std::string> flush() {
+        log::flush();
+        std::lock_guard lock{mutex};
+        return lines;
+    }
+
+    std::mutex mutex;
+    std::vector<std::string> lines;
+};
+
+bool ends_with(const std::string& line, const std::string& suffix) {
+    return line.size() >= suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Log, format) {
+    Capture capture;
+
+    const std::string name = "runner";
+    const auto duration = std::chrono::milliseconds(3);
+    info("Hello " << name << " " << 42 << " " << -7 << " " << 0.5 << " " << duration << " " << true);
+    info(std::string(1000, 'x'));
+
+    const auto lines = capture.flush();
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_TRUE(ends_with(lines[0], "[INFO]: Hello runner 42 -7 0.5 3ms true")) << lines[0];
+    EXPECT_NE(lines[0].find("log_test.cc"), std::string::npos);
+
+    // Long strings are cut short
+    EXPECT_TRUE(ends_with(lines[1], std::string(log::Record::kMaxText, 'x'))) << lines[1];
+}
+
+//
+// #############################################################################
+//
+
+TEST(Log, levels) {
+    Capture capture;
+
+    // Below the compiled in level, so the arguments aren't even evaluated
+    size_t evaluated = 0;
+    auto count = [&]() { return ++evaluated; };
+    debug("Not written " << count());
+    info("Written " << count());
+
+    const auto lines = capture.flush();
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_EQ(evaluated, 1);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Log, throttled) {
+    Capture capture;
+
+    for (size_t i = 0; i < 100; ++i) throttled(60.0, "Throttled " << i);
+
+    // Nothing was written for the rest, so they're reported with the next one that is
+    const auto lines = capture.flush();
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_TRUE(ends_with(lines[0], "[WARNING]: Throttled 0")) << lines[0];
+}
+
+//
+// #############################################################################
+//
+
+TEST(Log, realtime) {
+    if (!realtime::kEnabled) GTEST_SKIP() << "Only checked with --config=rtcheck";
+    Capture capture;
+
+    const size_t before = realtime::violations();
+    {
+        realtime::Scope realtime;
+        for (size_t i = 0; i < 10; ++i) info("From the audio thread " << i << " " << std::string_view{"view"});
+    }
+    EXPECT_EQ(realtime::violations(), before);
+    EXPECT_EQ(capture.flush().size(), 10);
+}
+}  // namespace synth
@@ -8,29 +8,230 @@ TEST(EjectorNode, basic) {
 
     EXPECT_EQ(node.name(), "speaker0");
 
-    // Two mock inputs
-    node.connect(0);
-    node.connect(0);
-
     Context context;
     context.timestamp = std::chrono::nanoseconds(100);
 
-    // Things are still ready since nodes are always ready on the first iteration
-    EXPECT_TRUE(node.invoke(context));
-    EXPECT_FALSE(node.invoke(context));
+    // Nothing is connected yet, so this should be silent
+    node.invoke(context);
+
+    Samples input{30.0};
+    node.set_input(0, input);
+    context.timestamp += Samples::batch_increment();
+    node.invoke(context);
 
-    node.add_input(0, Samples{10.0});
-    EXPECT_FALSE(node.invoke(context));
-    node.add_input(0, Samples{20.0});
-    EXPECT_TRUE(node.invoke(context));
+    EXPECT_EQ(node.as_ejector(), &node);
+    EXPECT_EQ(node.as_injector(), nullptr);
 
     Stream& stream = node.stream();
-    EXPECT_EQ(stream.flush(), 1);
-    ASSERT_EQ(stream.output().size(), Samples::kBatchSize);
-    for (size_t i = 0; i < Samples::kBatchSize; ++i) {
+    EXPECT_EQ(stream.flush(), 2);
+    ASSERT_EQ(stream.output().size(), 2 * Samples::batch_size());
+    for (size_t i = 0; i < 2 * Samples::batch_size(); ++i) {
         float value;
         EXPECT_TRUE(stream.output().pop(value));
-        ASSERT_EQ(value, 30.0);
+        ASSERT_EQ(value, i < Samples::batch_size() ? 0.0 : 30.0);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(EjectorNode, channels) {
+    EjectorNode node{"speaker0", 2};
+    ASSERT_EQ(node.num_inputs(), 2);
+    EXPECT_THROW(node.set_input(2, silence()), std::runtime_error);
+
+    Context context;
+    context.timestamp = std::chrono::nanoseconds(100);
+
+    // Only the first input is connected, so it's played on both channels
+    Samples left{10.0};
+    node.set_input(0, left);
+    node.invoke(context);
+
+    Samples right{20.0};
+    node.set_input(1, right);
+    context.timestamp += Samples::batch_increment();
+    node.invoke(context);
+
+    const auto result = node.stream().flush_new();
+    ASSERT_EQ(result.size(), 2 * 2 * Samples::batch_size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        const bool first_batch = i < 2 * Samples::batch_size();
+        ASSERT_EQ(result[i], first_batch || i % 2 == 0 ? 10.0 : 20.0);
     }
 }
+
+//
+// #############################################################################
+//
+
+TEST(InjectorNode, basic) {
+    struct Knob final : InjectorNode {
+        Knob() : InjectorNode("Knob") {}
+    } node;
+    GenericNode& generic = node;
+
+    EXPECT_EQ(generic.as_injector(), &node);
+    EXPECT_EQ(generic.as_ejector(), nullptr);
+
+    Context context;
+    generic.invoke(context);
+    EXPECT_EQ(node.output(0).samples[0], 0.0);
+
+    node.set_value(2.0);
+    generic.invoke(context);
+    generic.invoke(context);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(node.output(0).samples[i], 2.0);
+
+    node.set_value(-1.0);
+    generic.invoke(context);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(node.output(0).samples[i], -1.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(InjectorNode, schedule) {
+    struct Knob final : InjectorNode {
+        Knob() : InjectorNode("Knob") {}
+    } node;
+    const auto& output = node.output(0).samples;
+    Context context;
+
+    // Without a ramp, values step at exactly the scheduled sample
+    node.schedule(1.0, 10);
+    node.schedule(2.0, 20);
+    EXPECT_EQ(node.get_value(), 2.0);
+    node.invoke(context);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) {
+        ASSERT_EQ(output[i], i < 10 ? 0.0 : i < 20 ? 1.0 : 2.0) << i;
+    }
+
+    // Nothing new was scheduled, so the last value is held
+    node.invoke(context);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(output[i], 2.0);
+
+    // Ramps carry over into the next batch
+    const size_t ramp = Samples::batch_size() / 2;
+    node.set_ramp(ramp);
+    node.schedule(0.0, Samples::batch_size() - ramp / 2);
+    node.invoke(context);
+    EXPECT_EQ(output[0], 2.0);
+    for (size_t i = 1; i < Samples::batch_size(); ++i) ASSERT_LE(output[i], output[i - 1]) << i;
+    EXPECT_GT(output[Samples::batch_size() - 1], 0.0);
+
+    node.invoke(context);
+    for (size_t i = 1; i < Samples::batch_size(); ++i) ASSERT_LE(output[i], output[i - 1]) << i;
+    EXPECT_GT(output[ramp / 2 - 2], 0.0);
+    for (size_t i = ramp / 2 - 1; i < Samples::batch_size(); ++i) ASSERT_EQ(output[i], 0.0) << i;
+
+    // Setting a value skips the ramp
+    node.set_value(3.0);
+    node.invoke(context);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(output[i], 3.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(InjectorNode, control_rate) {
+    struct Knob final : InjectorNode {
+        Knob() : InjectorNode("Knob") {}
+    } node;
+    node.set_rate(Rate::kControl);
+    EXPECT_EQ(node.output_rate(0), Rate::kControl);
+    const auto& output = node.output(0).samples;
+    Context context;
+
+    // Only the first sample is written, and anything scheduled within the batch lands by the end of it
+    node.schedule(1.0, 10);
+    node.schedule(2.0, 20);
+    node.invoke(context);
+    EXPECT_EQ(output[0], 2.0);
+
+    // Ramps move a batch at a time
+    node.set_ramp(2 * Samples::batch_size());
+    node.schedule(0.0, 5);
+    node.invoke(context);
+    EXPECT_FLOAT_EQ(output[0], 1.0);
+    node.invoke(context);
+    EXPECT_EQ(output[0], 0.0);
+    node.invoke(context);
+    EXPECT_EQ(output[0], 0.0);
+
+    node.set_value(3.0);
+    node.invoke(context);
+    EXPECT_EQ(output[0], 3.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(InjectorNode, idle) {
+    struct Knob final : InjectorNode {
+        Knob() : InjectorNode("Knob") {}
+    } node;
+    const Samples& output = node.output(0);
+    Context context;
+
+    // The output hasn't been written yet, so it can't be skipped
+    EXPECT_FALSE(node.idle());
+    node.invoke(context);
+    EXPECT_TRUE(output.silent);
+    EXPECT_TRUE(node.idle());
+
+    node.set_value(1.0);
+    EXPECT_FALSE(node.idle());
+    node.invoke(context);
+    EXPECT_TRUE(output.constant);
+    EXPECT_FALSE(output.silent);
+
+    // Scheduling back to 0 needs a batch to land
+    node.schedule(0.0, 10);
+    EXPECT_FALSE(node.idle());
+    node.invoke(context);
+    EXPECT_FALSE(output.constant);
+    node.invoke(context);
+    EXPECT_TRUE(output.silent);
+    EXPECT_TRUE(node.idle());
+
+    node.skip();
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(output.samples[i], 0.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(AbstractNode, inputs) {
+    struct Node final : AbstractNode<2, 1> {
+        Node() : AbstractNode("Node") {}
+        void invoke(const Inputs& inputs, Outputs& outputs) override {
+            outputs[0].populate_samples([&](size_t i) { return inputs[0].samples[i] - inputs[1].samples[i]; });
+        }
+    } node;
+    GenericNode& generic = node;
+
+    Context context;
+    generic.invoke(context);
+    EXPECT_EQ(node.output(0).samples[0], 0.0);
+
+    // Changes to the bound buffer should show up without rebinding
+    Samples lhs{5.0};
+    Samples rhs{2.0};
+    node.set_input(0, lhs);
+    node.set_input(1, rhs);
+    generic.invoke(context);
+    EXPECT_EQ(node.output(0).samples[0], 3.0);
+
+    lhs.fill(10.0);
+    generic.invoke(context);
+    EXPECT_EQ(node.output(0).samples[0], 8.0);
+
+    EXPECT_THROW(node.set_input(2, lhs), std::out_of_range);
+}
 }  // namespace synth
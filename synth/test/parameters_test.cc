@@ -0,0 +1,63 @@
+#include "synth/parameters.hh"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace synth {
+TEST(ParameterQueue, basic) {
+    ParameterQueue queue{2};
+
+    ParameterEvent event;
+    EXPECT_FALSE(queue.pop(event));
+
+    EXPECT_TRUE(queue.push(ParameterEvent{1, 0.5, std::chrono::nanoseconds(10)}));
+    EXPECT_TRUE(queue.push(2, -0.5));
+    EXPECT_FALSE(queue.push(3, 1.0));
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_EQ(queue.dropped(), 1);
+
+    EXPECT_TRUE(queue.pop(event));
+    EXPECT_EQ(event.node_id, 1);
+    EXPECT_EQ(event.value, 0.5);
+    EXPECT_EQ(event.time, std::chrono::nanoseconds(10));
+
+    EXPECT_TRUE(queue.pop(event));
+    EXPECT_EQ(event.node_id, 2);
+    EXPECT_EQ(event.value, -0.5);
+    EXPECT_GT(event.time, std::chrono::nanoseconds(10));
+
+    EXPECT_FALSE(queue.pop(event));
+    EXPECT_EQ(queue.size(), 0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(ParameterQueue, threaded) {
+    ParameterQueue queue{16};
+    constexpr size_t kEvents = 10000;
+
+    std::thread producer{[&queue]() {
+        for (size_t i = 0; i < kEvents; ++i) {
+            while (!queue.push(ParameterEvent{i, static_cast<float>(i), std::chrono::nanoseconds(i)})) {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    for (size_t i = 0; i < kEvents;) {
+        ParameterEvent event;
+        if (!queue.pop(event)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(event.node_id, i);
+        ASSERT_EQ(event.value, static_cast<float>(i));
+        i++;
+    }
+
+    producer.join();
+}
+}  // namespace synth
@@ -0,0 +1,86 @@
+#include "synth/profiler.hh"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace synth {
+
+TEST(Timing, statistics) {
+    Timing timing;
+    EXPECT_EQ(timing.count(), 0);
+    EXPECT_EQ(timing.mean(), std::chrono::nanoseconds(0));
+    EXPECT_EQ(timing.percentile(0.99), std::chrono::nanoseconds(0));
+
+    // 1us to 100us, one of each
+    for (size_t i = 1; i <= 100; ++i) timing.add(std::chrono::microseconds(i));
+
+    EXPECT_EQ(timing.count(), 100);
+    EXPECT_EQ(timing.min(), std::chrono::microseconds(1));
+    EXPECT_EQ(timing.max(), std::chrono::microseconds(100));
+    EXPECT_EQ(timing.total(), std::chrono::microseconds(5050));
+    EXPECT_EQ(timing.mean(), std::chrono::nanoseconds(50500));
+
+    // Only as accurate as the width of the histogram buckets
+    auto near = [](std::chrono::nanoseconds value, std::chrono::nanoseconds expected) {
+        return value >= expected && value <= expected * 5 / 4;
+    };
+    EXPECT_TRUE(near(timing.percentile(0.5), std::chrono::microseconds(50))) << timing.percentile(0.5).count();
+    EXPECT_TRUE(near(timing.percentile(0.9), std::chrono::microseconds(90))) << timing.percentile(0.9).count();
+    EXPECT_EQ(timing.percentile(0.0), timing.min());
+    EXPECT_EQ(timing.percentile(1.0), timing.max());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Timing, outlier) {
+    Timing timing;
+    for (size_t i = 0; i < 1000; ++i) timing.add(std::chrono::microseconds(i % 100 == 0 ? 1000 : 10));
+
+    // One in a hundred is slow, which is right at the edge
+    EXPECT_LE(timing.percentile(0.99), std::chrono::microseconds(13));
+    EXPECT_EQ(timing.percentile(0.991), std::chrono::microseconds(1000));
+}
+
+//
+// #############################################################################
+//
+
+TEST(Profiler, trace) {
+    Profiler profiler{3};
+    profiler.reset({"first", "a \"quoted\" name"});
+
+    const auto start = Profiler::Clock::now();
+    profiler.add_step(0, start, start + std::chrono::microseconds(10));
+    profiler.add_step(1, start + std::chrono::microseconds(10), start + std::chrono::microseconds(15));
+    profiler.add_batch(start, start + std::chrono::microseconds(20));
+    // Past the limit, so it's only counted
+    profiler.add_step(0, start + std::chrono::microseconds(20), start + std::chrono::microseconds(25));
+
+    const Profile profile = profiler.profile();
+    ASSERT_EQ(profile.nodes.size(), 2);
+    EXPECT_EQ(profile.nodes[0].timing.count(), 2);
+    EXPECT_EQ(profile.nodes[1].timing.count(), 1);
+    EXPECT_EQ(profile.batch.count(), 1);
+    EXPECT_EQ(profile.node_total(), std::chrono::microseconds(20));
+
+    std::stringstream trace;
+    profiler.write_trace(trace);
+    const std::string json = trace.str();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_NE(json.find("\"name\":\"first\",\"cat\":\"node\""), std::string::npos) << json;
+    EXPECT_NE(json.find("\"name\":\"a \\\"quoted\\\" name\""), std::string::npos) << json;
+    EXPECT_NE(json.find("\"name\":\"Runner::next\",\"cat\":\"batch\""), std::string::npos) << json;
+    EXPECT_NE(json.find("\"dur\":5.000"), std::string::npos) << json;
+    EXPECT_EQ(json.find("\"dur\":5.000", json.find("\"dur\":5.000") + 1), std::string::npos) << json;
+
+    profiler.clear();
+    EXPECT_EQ(profiler.profile().nodes.size(), 2);
+    EXPECT_EQ(profiler.profile().batch.count(), 0);
+    std::stringstream empty;
+    profiler.write_trace(empty);
+    EXPECT_EQ(empty.str().find("\"ph\""), std::string::npos);
+}
+}  // namespace synth
@@ -0,0 +1,124 @@
+#include "synth/realtime.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "synth/node.hh"
+#include "synth/parameters.hh"
+#include "synth/runner.hh"
+
+namespace synth {
+namespace {
+struct Source final : InjectorNode {
+    Source() : InjectorNode("Source") {}
+};
+
+struct Wobble final : AbstractNode<1, 1> {
+    Wobble() : AbstractNode("Wobble") {}
+
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        outputs[0].populate_samples([&](size_t i) { return std::sin(inputs[0].samples[i] + (phase += 0.01f)); });
+    };
+
+    float phase = 0.0;
+};
+
+template <typename Node, typename... Args>
+Node& spawn(size_t id, NodeWrappers& wrappers, Args&&... args) {
+    auto& wrapper = wrappers.id_wrapper_map[id];
+    wrapper.node = std::make_unique<Node>(std::forward<Args>(args)...);
+    wrapper.outputs.resize(wrapper.node->num_outputs());
+    return static_cast<Node&>(*wrapper.node);
+}
+
+void connect(size_t from_id, size_t to_id, NodeWrappers& wrappers) {
+    auto& to = wrappers.id_wrapper_map.at(to_id);
+    wrappers.id_wrapper_map.at(from_id).outputs.at(0).push_back({0, to.node.get()});
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Realtime, violations) {
+    if (!realtime::kEnabled) GTEST_SKIP() << "Only checked with --config=rtcheck";
+
+    std::mutex mutex;
+    const size_t before = realtime::violations();
+
+    // Nothing is checked outside of a scope
+    auto outside = std::make_unique<float>(1.0);
+    { std::lock_guard lock{mutex}; }
+    EXPECT_FALSE(realtime::active());
+    EXPECT_EQ(realtime::violations(), before);
+
+    {
+        realtime::Scope realtime;
+        EXPECT_TRUE(realtime::active());
+
+        auto inside = std::make_unique<float>(2.0);
+        EXPECT_EQ(realtime::violations(), before + 1);
+        inside.reset();
+        EXPECT_EQ(realtime::violations(), before + 2);
+
+        { std::lock_guard lock{mutex}; }
+        EXPECT_EQ(realtime::violations(), before + 3);
+
+        {
+            realtime::Allow allow;
+            EXPECT_FALSE(realtime::active());
+            { std::lock_guard lock{mutex}; }
+            outside.reset();
+        }
+        EXPECT_EQ(realtime::violations(), before + 3);
+    }
+    EXPECT_FALSE(realtime::active());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Realtime, runner) {
+    if (!realtime::kEnabled) GTEST_SKIP() << "Only checked with --config=rtcheck";
+
+    for (size_t threads : {1, 2}) {
+        for (bool profiling : {false, true}) {
+            // A few voices summed into the output, so there are mixes to do and enough nodes per level to use the
+            // threads
+            NodeWrappers wrappers;
+            auto& ejector = spawn<EjectorNode>(0, wrappers, "Ejector");
+            for (size_t voice = 0; voice < 4; ++voice) {
+                const size_t id = 1 + 2 * voice;
+                spawn<Source>(id, wrappers);
+                spawn<Wobble>(id + 1, wrappers);
+                connect(id, id + 1, wrappers);
+                connect(id + 1, 0, wrappers);
+            }
+
+            ParameterQueue parameters;
+            Runner runner;
+            runner.set_threads(threads);
+            runner.set_parameters(&parameters);
+            // Fewer trace events than get recorded, so running out of room is checked too
+            runner.set_profiling(profiling, 100);
+            runner.compile(wrappers);
+
+            // The first batch counts too, it's the one which is run on the device callback right after compiling
+            const size_t before = realtime::violations();
+            for (size_t batch = 0; batch < 50; ++batch) {
+                parameters.push(1, 0.01f * batch);
+                runner.next();
+                ejector.stream().flush();
+                ejector.stream().output().clear();
+            }
+            EXPECT_EQ(realtime::violations(), before) << "threads: " << threads << " profiling: " << profiling;
+        }
+    }
+}
+}  // namespace synth
@@ -2,20 +2,26 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
 #include "synth/node.hh"
+#include "synth/parameters.hh"
 
 namespace synth {
-/*
 
 struct SourceNode final : InjectorNode {
     SourceNode() : InjectorNode("SourceNode") {}
 };
 
 struct IntermediateNode final : AbstractNode<1, 2> {
-    inline static float value = 0;
     IntermediateNode() : AbstractNode("IntermediateNode") {}
 
-    void invoke(const Inputs& inputs, Outputs& outputs) {
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
         auto& passthrough = outputs[0];
         auto& triple = outputs[1];
 
@@ -25,50 +31,544 @@ struct IntermediateNode final : AbstractNode<1, 2> {
 };
 
 struct DestinationNode final : AbstractNode<2, 0> {
-    inline static float value0 = 0;
-    inline static float value1 = 0;
+    float value0 = 0;
+    float value1 = 0;
 
     DestinationNode() : AbstractNode("DestinationNode") {}
 
-    void invoke(const Inputs& inputs, Outputs&) {
+    void invoke(const Inputs& inputs, Outputs&) override {
         value0 = inputs[0].samples[0];  // just using the first sample since they're all the same
         value1 = inputs[1].samples[0];
     };
 };
 
+struct CheckNode final : AbstractNode<1, 0> {
+    const Samples* input = nullptr;
+
+    CheckNode() : AbstractNode("CheckNode") {}
+
+    void invoke(const Inputs& inputs, Outputs&) override { input = &inputs[0]; };
+};
+
+struct WobbleNode final : AbstractNode<1, 1> {
+    WobbleNode() : AbstractNode("WobbleNode") {}
+
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        outputs[0].populate_samples([&](size_t i) { return std::sin(inputs[0].samples[i] + (phase += 0.01f)); });
+    };
+
+    float phase = 0.0;
+};
+
+struct SlowNode final : AbstractNode<1, 1> {
+    SlowNode() : AbstractNode("SlowNode") {}
+
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+        outputs[0] = inputs[0];
+    };
+};
+
+struct GateNode final : AbstractNode<1, 1> {
+    GateNode() : AbstractNode("GateNode") {}
+
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        invoked++;
+        outputs[0].populate_samples([&](size_t i) { return 2 * inputs[0].samples[i]; });
+    };
+
+    // Doesn't have any state, so silence in is always silence out
+    bool idle() const override { return inputs()[0].silent; }
+
+    size_t invoked = 0;
+};
+
+struct ControlNode final : InjectorNode {
+    ControlNode() : InjectorNode("ControlNode") { set_rate(Rate::kControl); }
+};
+
+struct RateNode final : AbstractNode<2, 0> {
+    std::array<const Samples*, 2> input{};
+    std::array<bool, 2> control{};
+    Samples audio;
+
+    RateNode() : AbstractNode("RateNode") {}
+
+    // The first input takes control rate sources as they are, the second always needs a full batch
+    Rate input_rate(size_t index) const override { return index == 0 ? Rate::kControl : Rate::kAudio; }
+
+    void invoke(const Inputs& inputs, Outputs&) override {
+        for (size_t i = 0; i < 2; ++i) {
+            input[i] = &inputs[i];
+            control[i] = inputs.control(i);
+        }
+        audio = inputs[1];
+    };
+};
+
+struct LowPassNode final : AbstractNode<1, 1>, BiQuadNode {
+    LowPassNode() : AbstractNode("LowPassNode") {
+        filter.set_coeff(BiQuadFilter::low_pass_filter(500.0 + 100.0 * count++, 3.0, 1.0));
+    }
+
+    void invoke(const Inputs& inputs, Outputs& outputs) override {
+        invoked++;
+        filter.process_block({inputs[0].samples.data(), Samples::batch_size()},
+                             {outputs[0].samples.data(), Samples::batch_size()});
+    };
+
+    BiQuadNode* as_biquad() override { return this; }
+
+    bool add_to(BiQuadBank& bank) override {
+        if (!bankable) return false;
+        bank.add(filter, inputs()[0].samples.data(), outputs()[0].samples.data());
+        return true;
+    }
+
+    inline static size_t count = 0;
+    BiQuadFilter filter;
+    bool bankable = true;
+    size_t invoked = 0;
+};
+
 //
 // #############################################################################
 //
 
-TEST(runner, basic) {
-    Runner runner;
+template <typename Node>
+Node& spawn(size_t id, NodeWrappers& wrappers) {
+    auto& wrapper = wrappers.id_wrapper_map[id];
+    wrapper.node = std::make_unique<Node>();
+    wrapper.outputs.resize(wrapper.node->num_outputs());
+    return static_cast<Node&>(*wrapper.node);
+}
+
+template <>
+EjectorNode& spawn(size_t id, NodeWrappers& wrappers) {
+    auto& wrapper = wrappers.id_wrapper_map[id];
+    wrapper.node = std::make_unique<EjectorNode>("EjectorNode");
+    return static_cast<EjectorNode&>(*wrapper.node);
+}
+
+void connect(size_t from_id, size_t from_port, size_t to_id, size_t to_port, NodeWrappers& wrappers) {
+    auto& to = wrappers.id_wrapper_map.at(to_id);
+    wrappers.id_wrapper_map.at(from_id).outputs.at(from_port).push_back({to_port, to.node.get()});
+}
+
+//
+// #############################################################################
+//
 
-    auto source = std::make_unique<SourceNode>();
-    auto intermediate = std::make_unique<IntermediateNode>();
-    auto destination = std::make_unique<DestinationNode>();
+TEST(Runner, basic) {
+    NodeWrappers wrappers;
 
-    auto source_ptr = source.get();
+    // IDs are in the opposite order of execution to make sure the runner isn't relying on them
+    auto& destination = spawn<DestinationNode>(0, wrappers);
+    spawn<IntermediateNode>(1, wrappers);
+    auto& source = spawn<SourceNode>(2, wrappers);
 
-    auto source_id = runner.spawn(std::move(source));
-    auto intermediate_id = runner.spawn(std::move(intermediate));
-    auto destination_id = runner.spawn(std::move(destination));
+    connect(2, 0, 0, 0, wrappers);
+    connect(2, 0, 1, 0, wrappers);
+    connect(1, 0, 0, 0, wrappers);
+    connect(1, 1, 0, 1, wrappers);
 
-    runner.connect(source_id, 0, destination_id, 0);
-    runner.connect(source_id, 0, intermediate_id, 0);
-    runner.connect(intermediate_id, 0, destination_id, 0);
-    runner.connect(intermediate_id, 1, destination_id, 1);
+    Runner runner;
+    runner.compile(wrappers);
 
-    source_ptr->set_value(10.0);
+    source.set_value(10.0);
     float expected_value0 = 20.0;  // source and intermediate node will produce 10.0 each
     float expected_value1 = 30.0;  // intermediate will triple the source 10.0 value
 
-    EXPECT_NE(DestinationNode::value0, expected_value0);
-    EXPECT_NE(DestinationNode::value1, expected_value1);
+    runner.next();
+    EXPECT_EQ(destination.value0, expected_value0);
+    EXPECT_EQ(destination.value1, expected_value1);
+
+    // Nothing should be left over from the previous batch
+    source.set_value(1.0);
+    runner.next();
+    EXPECT_EQ(destination.value0, 2.0);
+    EXPECT_EQ(destination.value1, 3.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, zero_copy) {
+    NodeWrappers wrappers;
+
+    auto& source = spawn<SourceNode>(0, wrappers);
+    auto& single = spawn<CheckNode>(1, wrappers);
+    auto& multiple = spawn<CheckNode>(2, wrappers);
+    auto& none = spawn<CheckNode>(3, wrappers);
+
+    connect(0, 0, 1, 0, wrappers);
+    connect(0, 0, 2, 0, wrappers);
+    connect(0, 0, 2, 0, wrappers);
+
+    Runner runner;
+    runner.compile(wrappers);
+
+    source.set_value(4.0);
+    runner.next();
+
+    // A single input is read straight from the output that feeds it
+    EXPECT_EQ(single.input, &source.output(0));
+
+    // Multiple inputs need to be summed into a different buffer
+    ASSERT_NE(multiple.input, nullptr);
+    EXPECT_NE(multiple.input, &source.output(0));
+    EXPECT_EQ(multiple.input->samples[0], 8.0);
+
+    EXPECT_EQ(none.input, &silence());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, cycle) {
+    NodeWrappers wrappers;
+
+    spawn<SourceNode>(0, wrappers);
+    spawn<IntermediateNode>(1, wrappers);
+    spawn<IntermediateNode>(2, wrappers);
+    spawn<DestinationNode>(3, wrappers);
+
+    connect(0, 0, 1, 0, wrappers);
+    connect(1, 0, 2, 0, wrappers);
+    connect(2, 1, 3, 0, wrappers);
+
+    Runner runner;
+    EXPECT_NO_THROW(runner.compile(wrappers));
+
+    // Feed the second intermediate node back into the first
+    connect(2, 0, 1, 0, wrappers);
+    EXPECT_THROW(runner.compile(wrappers), std::runtime_error);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, threaded) {
+    // Lots of independent voices (each a few nodes deep) all summed into the same output
+    constexpr size_t kVoices = 32;
+    auto build = [](NodeWrappers& wrappers) -> EjectorNode& {
+        auto& ejector = spawn<EjectorNode>(0, wrappers);
+        for (size_t voice = 0; voice < kVoices; ++voice) {
+            const size_t id = 1 + 3 * voice;
+            spawn<SourceNode>(id, wrappers).set_value(0.1 * voice);
+            spawn<WobbleNode>(id + 1, wrappers);
+            spawn<WobbleNode>(id + 2, wrappers);
+
+            connect(id, 0, id + 1, 0, wrappers);
+            connect(id + 1, 0, id + 2, 0, wrappers);
+            connect(id + 2, 0, 0, 0, wrappers);
+        }
+        return ejector;
+    };
+
+    NodeWrappers single_wrappers;
+    auto& single = build(single_wrappers);
+    Runner single_runner;
+    single_runner.compile(single_wrappers);
+
+    NodeWrappers threaded_wrappers;
+    auto& threaded = build(threaded_wrappers);
+    Runner threaded_runner;
+    threaded_runner.set_threads(4);
+    threaded_runner.compile(threaded_wrappers);
+
+    for (size_t batch = 0; batch < 10; ++batch) {
+        single_runner.next();
+        threaded_runner.next();
+    }
+
+    auto expected = single.stream().flush_new();
+    auto result = threaded.stream().flush_new();
+    ASSERT_EQ(result.size(), 10 * Samples::batch_size());
+    ASSERT_EQ(expected.size(), result.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        // Should be bit-identical
+        ASSERT_EQ(expected[i], result[i]) << "sample: " << i;
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, parameters) {
+    NodeWrappers wrappers;
+    auto& source = spawn<SourceNode>(3, wrappers);
+    auto& ejector = spawn<EjectorNode>(4, wrappers);
+    connect(3, 0, 4, 0, wrappers);
+
+    ParameterQueue parameters;
+    Runner runner;
+    runner.set_parameters(&parameters);
+    runner.compile(wrappers);
+
+    // Producer time is arbitrary, only the spacing between events matters
+    const std::chrono::nanoseconds start{123456789};
+    const size_t batch = Samples::batch_size();
+    auto at = [&](size_t sample) { return start + Samples::time_from_samples(sample); };
+
+    // The first event lands at the start of the next batch, then the rest are placed relative to it
+    parameters.push({3, 1.0, at(0)});
+    parameters.push({3, 2.0, at(batch / 2)});
+    parameters.push({3, 3.0, at(batch + 10)});
+    parameters.push({5, 4.0, at(batch + 20)});  // not an injector in this graph, so it's ignored
+
+    runner.next();
+    runner.next();
+    EXPECT_EQ(source.get_value(), 3.0);
+
+    auto result = ejector.stream().flush_new();
+    ASSERT_EQ(result.size(), 2 * batch);
+    for (size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQ(result[i], i < batch / 2 ? 1.0 : i < batch + 10 ? 2.0 : 3.0) << "sample: " << i;
+    }
+
+    // Something which would be in the past gets pulled up to the current batch
+    parameters.push({3, 5.0, at(0)});
+    runner.next();
+    result = ejector.stream().flush_new();
+    ASSERT_EQ(result.size(), batch);
+    for (size_t i = 0; i < result.size(); ++i) ASSERT_EQ(result[i], 5.0) << "sample: " << i;
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, profiling) {
+    NodeWrappers wrappers;
+    spawn<SourceNode>(0, wrappers);
+    spawn<SlowNode>(1, wrappers);
+    spawn<WobbleNode>(2, wrappers);
+    spawn<EjectorNode>(3, wrappers);
+    connect(0, 0, 1, 0, wrappers);
+    connect(0, 0, 2, 0, wrappers);
+    connect(1, 0, 3, 0, wrappers);
+    connect(2, 0, 3, 0, wrappers);
+
+    Runner runner;
+    runner.set_threads(2);
+    runner.compile(wrappers);
+    EXPECT_TRUE(runner.profile().nodes.empty());
+
+    runner.set_profiling(true, 100);
+    for (size_t batch = 0; batch < 10; ++batch) runner.next();
+
+    const Profile profile = runner.profile();
+    ASSERT_EQ(profile.nodes.size(), 4);
+    EXPECT_EQ(profile.batch.count(), 10);
+    EXPECT_EQ(profile.nodes.front().name, "SourceNode");
+    EXPECT_EQ(profile.nodes.back().name, "EjectorNode");
+    for (const auto& node : profile.nodes) {
+        EXPECT_EQ(node.timing.count(), 10) << node.name;
+        EXPECT_LE(node.timing.min(), node.timing.mean()) << node.name;
+        EXPECT_LE(node.timing.mean(), node.timing.max()) << node.name;
+        EXPECT_LE(node.timing.percentile(0.99), node.timing.max()) << node.name;
+    }
+
+    // The slow node should stand out, and every batch has to wait for it
+    const auto slow = std::find_if(profile.nodes.begin(), profile.nodes.end(),
+                                   [](const auto& node) { return node.name == "SlowNode"; });
+    ASSERT_NE(slow, profile.nodes.end());
+    EXPECT_GE(slow->timing.min(), std::chrono::microseconds(200));
+    EXPECT_GE(profile.batch.min(), slow->timing.min());
+    for (const auto& node : profile.nodes) EXPECT_LE(node.timing.total(), slow->timing.total()) << node.name;
+
+    // One event per node per batch plus the batch itself
+    std::stringstream trace;
+    runner.write_trace(trace);
+    const std::string json = trace.str();
+    size_t events = 0;
+    for (size_t i = json.find("\"ph\":\"X\""); i != std::string::npos; i = json.find("\"ph\":\"X\"", i + 1)) events++;
+    EXPECT_EQ(events, 10 * 5);
+
+    // Compiling the graph again starts over, since the steps may have moved around
+    runner.compile(wrappers);
+    EXPECT_EQ(runner.profile().batch.count(), 0);
+    EXPECT_EQ(runner.profile().nodes.size(), 4);
+
+    runner.set_profiling(false);
+    runner.next();
+    EXPECT_TRUE(runner.profile().nodes.empty());
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, banking) {
+    // A handful of filters fed by the same source, which all end up in the same level
+    constexpr size_t kFilters = 11;
+    auto build = [](NodeWrappers& wrappers) {
+        LowPassNode::count = 0;
+        spawn<SourceNode>(0, wrappers);
+        spawn<WobbleNode>(1, wrappers);
+        auto& ejector = spawn<EjectorNode>(2, wrappers);
+        connect(0, 0, 1, 0, wrappers);
+        for (size_t f = 0; f < kFilters; ++f) {
+            spawn<LowPassNode>(3 + f, wrappers);
+            connect(1, 0, 3 + f, 0, wrappers);
+            connect(3 + f, 0, 2, 0, wrappers);
+        }
+        return &ejector;
+    };
+
+    for (size_t threads : {1, 3}) {
+        NodeWrappers expected_wrappers;
+        EjectorNode* expected_ejector = build(expected_wrappers);
+        Runner expected_runner;
+        expected_runner.set_banking(false);
+        expected_runner.compile(expected_wrappers);
+
+        NodeWrappers wrappers;
+        EjectorNode* ejector = build(wrappers);
+        auto& stubborn = static_cast<LowPassNode&>(*wrappers.id_wrapper_map.at(3).node);
+        stubborn.bankable = false;
+
+        Runner runner;
+        runner.set_threads(threads);
+        runner.set_profiling(true);
+        runner.compile(wrappers);
+
+        for (size_t batch = 0; batch < 4; ++batch) {
+            runner.next();
+            expected_runner.next();
+        }
+
+        const auto result = ejector->stream().flush_new();
+        const auto expected = expected_ejector->stream().flush_new();
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) ASSERT_NEAR(result[i], expected[i], 1E-4) << "i: " << i;
+
+        // Banked filters are never invoked, but the one which can't be banked still is
+        EXPECT_EQ(stubborn.invoked, 4);
+        for (size_t f = 1; f < kFilters; ++f) {
+            EXPECT_EQ(static_cast<LowPassNode&>(*wrappers.id_wrapper_map.at(3 + f).node).invoked, 0);
+        }
+
+        // Each banked filter still shows up in the profile
+        for (const auto& node : runner.profile().nodes) EXPECT_EQ(node.timing.count(), 4) << node.name;
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, control_rate) {
+    NodeWrappers wrappers;
+    auto& knob = spawn<ControlNode>(0, wrappers);
+    auto& other = spawn<ControlNode>(1, wrappers);
+    auto& audio = spawn<SourceNode>(2, wrappers);
+    auto& single = spawn<RateNode>(3, wrappers);
+    auto& mixed = spawn<RateNode>(4, wrappers);
+    auto& unconnected = spawn<RateNode>(5, wrappers);
+
+    connect(0, 0, 3, 0, wrappers);
+    connect(0, 0, 3, 1, wrappers);
+    connect(0, 0, 4, 0, wrappers);
+    connect(1, 0, 4, 0, wrappers);
+    connect(1, 0, 4, 1, wrappers);
+    connect(2, 0, 4, 1, wrappers);
+
+    Runner runner;
+    runner.compile(wrappers);
+
+    knob.set_value(1.0);
+    other.set_value(2.0);
+    audio.set_value(4.0);
+    runner.next();
+
+    // A control rate input fed only by control rate outputs gets them as they are (or summed in the first sample)
+    EXPECT_TRUE(single.control[0]);
+    EXPECT_EQ(single.input[0], &knob.output(0));
+    EXPECT_TRUE(mixed.control[0]);
+    EXPECT_EQ(mixed.input[0]->samples[0], 3.0);
+
+    // Audio rate inputs get a promoted copy, which is held for the first batch since there's nothing to ramp from
+    EXPECT_FALSE(single.control[1]);
+    EXPECT_NE(single.input[1], &knob.output(0));
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(single.audio.samples[i], 1.0);
+    EXPECT_FALSE(mixed.control[1]);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(mixed.audio.samples[i], 6.0);
+
+    EXPECT_TRUE(unconnected.control[0]);
+    EXPECT_FALSE(unconnected.control[1]);
+
+    // Changes are ramped over the next batch, landing on the new value
+    knob.set_value(3.0);
+    runner.next();
+    EXPECT_EQ(single.input[0]->samples[0], 3.0);
+    for (size_t i = 1; i < Samples::batch_size(); ++i) ASSERT_GT(single.audio.samples[i], single.audio.samples[i - 1]);
+    EXPECT_GT(single.audio.samples[0], 1.0);
+    EXPECT_EQ(single.audio.samples[Samples::batch_size() - 1], 3.0);
+
+    runner.next();
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(single.audio.samples[i], 3.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Runner, skipping) {
+    auto build = [](NodeWrappers& wrappers) {
+        spawn<SourceNode>(0, wrappers);
+        spawn<SourceNode>(1, wrappers);
+        spawn<GateNode>(2, wrappers);
+        spawn<EjectorNode>(3, wrappers);
+        connect(0, 0, 2, 0, wrappers);
+        connect(1, 0, 2, 0, wrappers);
+        connect(2, 0, 3, 0, wrappers);
+    };
+    const std::vector<float> values{0.0, 0.0, 1.0, 0.0, 0.0};
+
+    NodeWrappers expected_wrappers;
+    build(expected_wrappers);
+    Runner expected_runner;
+    expected_runner.set_skipping(false);
+    expected_runner.compile(expected_wrappers);
+
+    NodeWrappers wrappers;
+    build(wrappers);
+    Runner runner;
+    runner.compile(wrappers);
+    auto& gate = static_cast<GateNode&>(*wrappers.id_wrapper_map.at(2).node);
+
+    for (size_t batch = 0; batch < values.size(); ++batch) {
+        static_cast<SourceNode&>(*wrappers.id_wrapper_map.at(0).node).set_value(values[batch]);
+        static_cast<SourceNode&>(*expected_wrappers.id_wrapper_map.at(0).node).set_value(values[batch]);
+        runner.next();
+        expected_runner.next();
+        EXPECT_EQ(gate.invoked, batch < 2 ? 0 : 1);
+    }
+
+    // Skipped nodes leave silence behind, not whatever they last output
+    const auto result = wrappers.id_wrapper_map.at(3).node->as_ejector()->stream().flush_new();
+    const auto expected = expected_wrappers.id_wrapper_map.at(3).node->as_ejector()->stream().flush_new();
+    ASSERT_EQ(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i) ASSERT_EQ(result[i], expected[i]) << "i: " << i;
+    EXPECT_EQ(result[2 * Samples::batch_size()], 2.0);
+    EXPECT_EQ(result.back(), 0.0);
 
-    runner.next({});
+    // The gate only runs once. Sources need to have filled their output with silence before they're skipped, so the
+    // one held at 0 is skipped in every batch after the first, and the other only once it's been at 0 for a batch.
+    const Runner::SkipStats stats = runner.skip_stats();
+    EXPECT_EQ(stats.invocations, 4 * values.size());
+    EXPECT_EQ(stats.skipped, 4 + 4 + 2);
+    const std::chrono::duration<double> generated = Samples::time_from_batches(values.size());
+    EXPECT_DOUBLE_EQ(stats.skipped_per_second, stats.skipped / generated.count());
 
-    EXPECT_EQ(DestinationNode::value0, expected_value0);
-    EXPECT_EQ(DestinationNode::value1, expected_value1);
+    EXPECT_EQ(expected_runner.skip_stats().skipped, 0);
 }
-*/
 }  // namespace synth
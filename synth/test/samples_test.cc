@@ -0,0 +1,105 @@
+#include "synth/samples.hh"
+
+#include <gtest/gtest.h>
+
+#include "synth/node.hh"
+#include "synth/runner.hh"
+
+namespace synth {
+namespace {
+struct SourceNode final : InjectorNode {
+    SourceNode() : InjectorNode("SourceNode") {}
+};
+
+///
+/// @brief Puts the default config back once the test is done, since it's shared by everything
+///
+struct ScopedConfig {
+    ScopedConfig(const EngineConfig& config) { Samples::configure(config); }
+    ~ScopedConfig() { Samples::configure(EngineConfig{}); }
+};
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Samples, configure) {
+    ScopedConfig scoped{{48000, 64}};
+
+    EXPECT_EQ(Samples::sample_rate(), 48000);
+    EXPECT_EQ(Samples::batch_size(), 64);
+    EXPECT_EQ(Samples::sample_increment(), std::chrono::nanoseconds(1'000'000'000 / 48000));
+    EXPECT_EQ(Samples::batch_increment(), 64 * Samples::sample_increment());
+    EXPECT_EQ(Samples::samples_from_time(std::chrono::seconds(1)), 48000);
+    EXPECT_EQ(&Samples::batch_kernels(), &kernels::best(64));
+
+    Samples samples{1.0};
+    samples.sum(Samples{2.0}.samples);
+    for (size_t i = 0; i < Samples::batch_size(); ++i) ASSERT_EQ(samples.samples[i], 3.0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Samples, invalid_config) {
+    EXPECT_THROW(Samples::configure({44000, 0}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({44000, Samples::kMaxBatchSize + 1}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({0, 128}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({1'000'000'000, 128}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({44000, 128, 0}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({44000, 128, Samples::kMaxChannels + 1}), std::runtime_error);
+    EXPECT_THROW(Samples::configure({44000, 128, 2, 0}), std::runtime_error);
+
+    // Nothing should have changed
+    EXPECT_EQ(Samples::sample_rate(), EngineConfig{}.sample_rate);
+    EXPECT_EQ(Samples::batch_size(), EngineConfig{}.batch_size);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Samples, parse_flag) {
+    EngineConfig config;
+    EXPECT_TRUE(parse_flag("--sample_rate=48000", config));
+    EXPECT_TRUE(parse_flag("--batch_size=64", config));
+    EXPECT_TRUE(parse_flag("--channels=4", config));
+    EXPECT_TRUE(parse_flag("--latency_batches=1", config));
+    EXPECT_FALSE(parse_flag("--seconds=10", config));
+
+    EXPECT_EQ(config.sample_rate, 48000);
+    EXPECT_EQ(config.batch_size, 64);
+    EXPECT_EQ(config.channels, 4);
+    EXPECT_EQ(config.latency_batches, 1);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Samples, runner) {
+    // An uncommon batch size which doesn't get specialized kernels
+    ScopedConfig scoped{{96000, 100}};
+
+    NodeWrappers wrappers;
+    auto& source_wrapper = wrappers.id_wrapper_map[0];
+    source_wrapper.node = std::make_unique<SourceNode>();
+    source_wrapper.outputs.resize(1);
+    auto& ejector_wrapper = wrappers.id_wrapper_map[1];
+    ejector_wrapper.node = std::make_unique<EjectorNode>("EjectorNode");
+    source_wrapper.outputs[0].push_back({0, ejector_wrapper.node.get()});
+
+    static_cast<SourceNode&>(*source_wrapper.node).set_value(0.5);
+
+    Runner runner;
+    runner.compile(wrappers);
+    runner.next();
+    runner.next();
+
+    auto result = static_cast<EjectorNode&>(*ejector_wrapper.node).stream().flush_new();
+    ASSERT_EQ(result.size(), 200);
+    for (float sample : result) ASSERT_EQ(sample, 0.5);
+}
+}  // namespace synth
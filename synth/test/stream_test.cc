@@ -2,6 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <array>
+#include <vector>
+
+#include "synth/realtime.hh"
+
 namespace synth {
 TEST(Stream, basic_flush) {
     Stream s;
@@ -9,7 +14,7 @@ TEST(Stream, basic_flush) {
     EXPECT_EQ(s.output().size(), 0);
     EXPECT_THROW(s.index_of_timestamp(std::chrono::seconds(0)), std::runtime_error);
 
-    auto inc = Samples::kBatchIncrement;
+    auto inc = Samples::batch_increment();
 
     s.add_samples(0 * inc, Samples{100});
     EXPECT_EQ(s.index_of_timestamp(0 * inc), 0);
@@ -23,9 +28,9 @@ TEST(Stream, basic_flush) {
 
     // Flush samples, this should flush the first and second set of samples added above
     auto result = s.flush_new();
-    ASSERT_EQ(result.size(), 2 * Samples::kBatchSize);
-    for (size_t i = 0; i < 2 * Samples::kBatchSize; ++i) {
-        size_t batch_number = i / Samples::kBatchSize;
+    ASSERT_EQ(result.size(), 2 * Samples::batch_size());
+    for (size_t i = 0; i < 2 * Samples::batch_size(); ++i) {
+        size_t batch_number = i / Samples::batch_size();
         float expected = 100.f * (batch_number + 1);
         EXPECT_EQ(result[i], expected);
     }
@@ -36,7 +41,7 @@ TEST(Stream, basic_flush) {
 //
 
 TEST(Stream, add_input) {
-    auto inc = Samples::kBatchIncrement;
+    auto inc = Samples::batch_increment();
 
     // Create the stream
     Stream s;
@@ -53,21 +58,21 @@ TEST(Stream, add_input) {
     s.add_samples(3 * inc, Samples{4000});
 
     EXPECT_EQ(s.flush(), 4);
-    ASSERT_EQ(s.output().size(), 4 * Samples::kBatchSize);
+    ASSERT_EQ(s.output().size(), 4 * Samples::batch_size());
     float value;
-    for (size_t i = 0; i < Samples::kBatchSize; ++i) {
+    for (size_t i = 0; i < Samples::batch_size(); ++i) {
         ASSERT_TRUE(s.output().pop(value));
         ASSERT_EQ(value, 100 + 1000);
     }
-    for (size_t i = 0; i < Samples::kBatchSize; ++i) {
+    for (size_t i = 0; i < Samples::batch_size(); ++i) {
         ASSERT_TRUE(s.output().pop(value));
         ASSERT_EQ(value, 200 + 2000);
     }
-    for (size_t i = 0; i < Samples::kBatchSize; ++i) {
+    for (size_t i = 0; i < Samples::batch_size(); ++i) {
         ASSERT_TRUE(s.output().pop(value));
         ASSERT_EQ(value, 300 + 3000);
     }
-    for (size_t i = 0; i < Samples::kBatchSize; ++i) {
+    for (size_t i = 0; i < Samples::batch_size(); ++i) {
         ASSERT_TRUE(s.output().pop(value));
         ASSERT_EQ(value, 400 + 4000);
     }
@@ -75,4 +80,112 @@ TEST(Stream, add_input) {
     // We can't add samples in the past
     EXPECT_THROW(s.add_samples(1 * inc, Samples{2000}), std::runtime_error);
 }
+
+//
+// #############################################################################
+//
+
+TEST(Stream, interleave_channels) {
+    auto inc = Samples::batch_increment();
+
+    Stream s{2};
+    EXPECT_EQ(s.channels(), 2);
+
+    Samples left{1.0};
+    Samples right{-1.0};
+    const std::array<const Samples*, 2> channels{&left, &right};
+    s.add_samples(0 * inc, channels);
+    s.add_samples(0 * inc, channels);
+
+    // Mono samples need a mono stream
+    EXPECT_THROW(s.add_samples(1 * inc, left), std::runtime_error);
+
+    auto result = s.flush_new();
+    ASSERT_EQ(result.size(), 2 * Samples::batch_size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        EXPECT_EQ(result[i], i % 2 == 0 ? 2.0 : -2.0);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Stream, mix_into) {
+    auto inc = Samples::batch_increment();
+
+    Stream s{2};
+    std::vector<float> frames(2 * Samples::batch_size(), 1.f);
+    EXPECT_FALSE(s.mix_into(frames));
+
+    Samples left{1.0};
+    Samples right{2.0};
+    const std::array<const Samples*, 2> channels{&left, &right};
+    s.add_samples(0 * inc, channels);
+    s.add_samples(1 * inc, channels);
+
+    EXPECT_TRUE(s.mix_into(frames));
+    EXPECT_EQ(s.buffered_batches(), 1);
+    for (size_t i = 0; i < frames.size(); ++i) EXPECT_EQ(frames[i], i % 2 == 0 ? 2.0 : 3.0);
+
+    std::vector<float> small(Samples::batch_size());
+    EXPECT_THROW(s.mix_into(small), std::runtime_error);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Stream, flush_wraps) {
+    auto inc = Samples::batch_increment();
+
+    // The ring isn't a whole number of batches, so batches will be split when it wraps around
+    Stream s{2};
+    ASSERT_NE(s.output().capacity() % (2 * Samples::batch_size()), 0);
+
+    std::vector<float> read(2 * Samples::batch_size());
+    for (size_t batch = 0; batch < 1000; ++batch) {
+        Samples left{static_cast<float>(batch)};
+        Samples right{-static_cast<float>(batch)};
+        const std::array<const Samples*, 2> channels{&left, &right};
+        s.add_samples(batch * inc, channels);
+        ASSERT_EQ(s.flush(), 1);
+
+        ASSERT_EQ(s.output().read(read), read.size());
+        for (size_t i = 0; i < read.size(); ++i) ASSERT_EQ(read[i], i % 2 == 0 ? batch : -1.f * batch);
+    }
+    EXPECT_EQ(s.output().overruns(), 0);
+}
+
+//
+// #############################################################################
+//
+
+TEST(Stream, flush_doesnt_allocate) {
+    if (!realtime::kEnabled) GTEST_SKIP() << "Allocations are only tracked with --config=rtcheck";
+    auto inc = Samples::batch_increment();
+
+    Stream s{2};
+    Samples left{1.0};
+    Samples right{2.0};
+    const std::array<const Samples*, 2> channels{&left, &right};
+    std::vector<float> frames(2 * Samples::batch_size());
+    s.output();  // the ring is allocated on first use
+
+    const size_t before = realtime::violations();
+    realtime::Scope realtime;
+    for (size_t batch = 0; batch < 100; ++batch) {
+        s.add_samples(batch * inc, channels);
+        s.add_samples(batch * inc, channels);
+        s.flush();
+        s.output().read(frames);
+    }
+    for (size_t batch = 100; batch < 200; ++batch) {
+        s.add_samples(batch * inc, channels);
+        s.flush(frames);
+    }
+    EXPECT_EQ(realtime::violations(), before);
+    EXPECT_EQ(frames[0], 1.0);
+    EXPECT_EQ(frames[1], 2.0);
+}
 }  // namespace synth
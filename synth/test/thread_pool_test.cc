@@ -0,0 +1,67 @@
+#include "synth/thread_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+namespace synth {
+TEST(ThreadPool, basic) {
+    ThreadPool pool{4};
+    EXPECT_EQ(pool.size(), 4);
+
+    std::vector<int> counts(1000, 0);
+    for (size_t iteration = 0; iteration < 100; ++iteration) {
+        pool.run(counts.size(), [&](size_t i) { counts[i]++; });
+    }
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+        ASSERT_EQ(counts[i], 100) << "index: " << i;
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(ThreadPool, uneven) {
+    ThreadPool pool{3};
+
+    // All of the slow tasks end up in the first worker's range, so the others will need to steal them
+    std::atomic<size_t> total{0};
+    pool.run(30, [&](size_t i) {
+        if (i < 10) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        total += i;
+    });
+    EXPECT_EQ(total, 29 * 30 / 2);
+
+    // Smaller than the number of threads
+    total = 0;
+    pool.run(2, [&](size_t i) { total += i + 1; });
+    EXPECT_EQ(total, 3);
+}
+
+//
+// #############################################################################
+//
+
+TEST(ThreadPool, exception) {
+    ThreadPool pool{4};
+
+    std::atomic<size_t> count{0};
+    EXPECT_THROW(pool.run(100,
+                          [&](size_t i) {
+                              count++;
+                              if (i == 50) throw std::runtime_error("Task failed!");
+                          }),
+                 std::runtime_error);
+
+    // Everything else should still have run
+    EXPECT_EQ(count, 100);
+
+    // And the pool is still usable
+    count = 0;
+    pool.run(100, [&](size_t) { count++; });
+    EXPECT_EQ(count, 100);
+}
+}  // namespace synth
@@ -0,0 +1,101 @@
+#include "synth/wavetable.hh"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "synth/samples.hh"
+
+namespace synth {
+namespace {
+/// Amplitude of harmonic n in one cycle sampled from the table
+double harmonic(const Wavetable& table, size_t level, size_t n) {
+    constexpr size_t kSamples = 4 * Wavetable::kSize;
+    double real = 0.0;
+    double imaginary = 0.0;
+    for (size_t i = 0; i < kSamples; ++i) {
+        const auto phase = static_cast<Wavetable::Phase>((uint64_t{1} << 32) * i / kSamples);
+        const double value = table.at(phase, level, Wavetable::Interpolation::kCubic);
+        real += value * std::cos(2.0 * M_PI * n * i / kSamples);
+        imaginary += value * std::sin(2.0 * M_PI * n * i / kSamples);
+    }
+    return 2.0 * std::hypot(real, imaginary) / kSamples;
+}
+}  // namespace
+
+//
+// #############################################################################
+//
+
+TEST(Wavetable, sine) {
+    for (auto interpolation : {Wavetable::Interpolation::kLinear, Wavetable::Interpolation::kCubic}) {
+        double worst = 0.0;
+        for (size_t i = 0; i < 10000; ++i) {
+            const auto phase = static_cast<Wavetable::Phase>(i * 429497);
+            const double expected = std::sin(2.0 * M_PI * phase / 4294967296.0);
+            worst = std::max(worst, std::abs(Wavetable::sine().at(phase, 0, interpolation) - expected));
+        }
+        EXPECT_LT(worst, interpolation == Wavetable::Interpolation::kLinear ? 2E-6 : 1E-6);
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Wavetable, level) {
+    // Level 0 is used until the top harmonic would pass Nyquist
+    const double nyquist = Samples::sample_rate() / 2.0;
+    EXPECT_EQ(Wavetable::level(0), 0);
+    EXPECT_EQ(Wavetable::level(Wavetable::phase_increment(nyquist / Wavetable::kMaxHarmonics * 0.99)), 0);
+    EXPECT_EQ(Wavetable::level(Wavetable::phase_increment(nyquist / Wavetable::kMaxHarmonics * 1.01)), 1);
+    EXPECT_EQ(Wavetable::level(Wavetable::phase_increment(nyquist / 4 * 0.99)), Wavetable::kLevels - 3);
+    EXPECT_EQ(Wavetable::level(Wavetable::phase_increment(nyquist * 0.99)), Wavetable::kLevels - 1);
+    EXPECT_EQ(Wavetable::level(Wavetable::phase_increment(nyquist * 1.5)), Wavetable::kLevels - 1);
+
+    // Negative frequencies run backwards
+    EXPECT_EQ(Wavetable::phase_increment(-1000.0), Wavetable::Phase{0} - Wavetable::phase_increment(1000.0));
+}
+
+//
+// #############################################################################
+//
+
+TEST(Wavetable, band_limited) {
+    // Each level only has the harmonics it's meant to, with the ratios from the Fourier series
+    const Wavetable& saw = Wavetable::saw();
+    const Wavetable& square = Wavetable::square();
+    const double fundamental = harmonic(saw, 0, 1);
+    for (size_t level : {size_t{5}, size_t{8}}) {
+        const size_t harmonics = Wavetable::kMaxHarmonics >> level;
+        for (size_t n = 1; n <= 2 * harmonics + 1; ++n) {
+            const double expected = n <= harmonics ? fundamental / n : 0.0;
+            EXPECT_NEAR(harmonic(saw, level, n), expected, 1E-4) << "level: " << level << " harmonic: " << n;
+
+            // Only odd harmonics for the square
+            if (n % 2 == 0 || n > harmonics) {
+                EXPECT_NEAR(harmonic(square, level, n), 0.0, 1E-4) << "level: " << level << " harmonic: " << n;
+            }
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+TEST(Wavetable, render) {
+    std::vector<Wavetable::Phase> phases(100);
+    for (size_t i = 0; i < phases.size(); ++i) phases[i] = static_cast<Wavetable::Phase>(i * 123456789);
+
+    for (auto interpolation : {Wavetable::Interpolation::kLinear, Wavetable::Interpolation::kCubic}) {
+        std::vector<float> out(phases.size());
+        Wavetable::triangle().render(out.data(), phases.data(), 3, out.size(), interpolation);
+        for (size_t i = 0; i < phases.size(); ++i) {
+            ASSERT_EQ(out[i], Wavetable::triangle().at(phases[i], 3, interpolation)) << "index: " << i;
+            ASSERT_LE(std::abs(out[i]), 1.0) << "index: " << i;
+        }
+    }
+}
+}  // namespace synth
@@ -0,0 +1,146 @@
+#include "synth/thread_pool.hh"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <stdexcept>
+
+#include "synth/realtime.hh"
+
+namespace synth {
+
+//
+// #############################################################################
+//
+
+ThreadPool::ThreadPool(size_t threads) : ranges_(threads) {
+    if (threads == 0) throw std::runtime_error("ThreadPool() needs at least one thread.");
+
+    // The calling thread is worker 0
+    threads_.reserve(threads - 1);
+    for (size_t worker = 1; worker < threads; ++worker) {
+        threads_.emplace_back([this, worker]() { worker_loop(worker); });
+    }
+}
+
+//
+// #############################################################################
+//
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex_};
+        shutdown_ = true;
+    }
+    start_.notify_all();
+
+    for (auto& thread : threads_) thread.join();
+}
+
+//
+// #############################################################################
+//
+
+size_t ThreadPool::size() const { return ranges_.size(); }
+
+//
+// #############################################################################
+//
+
+void ThreadPool::run(size_t count, Task task) {
+    if (count == 0) return;
+
+    // Not worth waking anyone up
+    if (threads_.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) task.invoke(task.data, i);
+        return;
+    }
+
+    const size_t workers = ranges_.size();
+    for (size_t worker = 0; worker < workers; ++worker) {
+        Range& range = ranges_[worker];
+        range.next.store(worker * count / workers, std::memory_order_relaxed);
+        range.end = (worker + 1) * count / workers;
+    }
+
+    {
+        // Workers only ever hold this briefly to check for new work, so it's not going to block for long
+        realtime::Allow allow;
+        std::lock_guard lock{mutex_};
+        task_ = task;
+        running_.store(threads_.size(), std::memory_order_relaxed);
+        generation_++;
+    }
+    start_.notify_all();
+
+    work(0);
+
+    // Batches are expected to be short, so spin instead of sleeping until the stragglers are done
+    while (running_.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+
+    if (error_) {
+        std::exception_ptr error = nullptr;
+        std::swap(error, error_);
+        std::rethrow_exception(error);
+    }
+}
+
+//
+// #############################################################################
+//
+
+void ThreadPool::work(size_t worker) {
+    const size_t workers = ranges_.size();
+
+    // Start with our own range, then move on to stealing from the others
+    for (size_t offset = 0; offset < workers; ++offset) {
+        Range& range = ranges_[(worker + offset) % workers];
+
+        for (size_t i = range.next.fetch_add(1, std::memory_order_relaxed); i < range.end;
+             i = range.next.fetch_add(1, std::memory_order_relaxed)) {
+            try {
+                task_.invoke(task_.data, i);
+            } catch (...) {
+                std::lock_guard lock{error_mutex_};
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+void ThreadPool::worker_loop(size_t worker) {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock{mutex_};
+            start_.wait(lock, [&]() { return shutdown_ || generation_ != generation; });
+            if (shutdown_) return;
+            generation = generation_;
+        }
+
+        {
+            // Workers are running parts of Runner::next(), so they're on the real-time path too
+            realtime::Scope realtime;
+            work(worker);
+        }
+        running_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+//
+// #############################################################################
+//
+
+bool set_realtime_priority(std::thread& thread) {
+    sched_param param{};
+    // Leave some room above for the audio driver's own threads
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+    return pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) == 0;
+}
+}  // namespace synth
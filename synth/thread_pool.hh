@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace synth {
+
+///
+/// @brief Fixed size pool of workers for running batches of independent tasks. Each batch is split evenly between the
+/// workers up front, and workers that finish their share early will steal tasks from the others. The calling thread
+/// is counted as one of the workers and takes part in every batch.
+///
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool(ThreadPool&& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(ThreadPool&& rhs) = delete;
+
+public:
+    ///
+    /// @brief Invoke f(i) for each i in [0, count) and block until all have finished. If any of the tasks throw, the
+    /// first exception is rethrown here once the batch is done.
+    ///
+    template <typename F>
+    void run(size_t count, F&& f) {
+        using Function = std::remove_reference_t<F>;
+        run(count, Task{&f, [](void* data, size_t i) { (*static_cast<Function*>(data))(i); }});
+    }
+
+    size_t size() const;
+
+private:
+    /// Type erased reference to the function being run (so there's no need to allocate a std::function)
+    struct Task {
+        void* data;
+        void (*invoke)(void* data, size_t i);
+    };
+
+    /// The subset of the batch initially given to each worker, the next index is shared with anyone stealing work
+    struct alignas(64) Range {
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    void run(size_t count, Task task);
+    void work(size_t worker);
+    void worker_loop(size_t worker);
+
+private:
+    std::vector<Range> ranges_;
+    std::vector<std::thread> threads_;
+
+    Task task_{nullptr, nullptr};
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    uint64_t generation_ = 0;
+    bool shutdown_ = false;
+
+    /// Number of workers (not including the caller) which are still running the current batch
+    std::atomic<size_t> running_{0};
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+//
+// #############################################################################
+//
+
+///
+/// @brief Best effort attempt to give the thread real-time (SCHED_FIFO) scheduling, which usually needs extra
+/// permissions. Returns false if that wasn't allowed, in which case the thread is left as it was.
+///
+bool set_realtime_priority(std::thread& thread);
+}  // namespace synth
@@ -0,0 +1,128 @@
+#include "synth/wavetable.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace synth {
+
+//
+// #############################################################################
+//
+
+size_t Wavetable::level(Phase increment) {
+    // Half a cycle per sample is Nyquist, so the highest harmonic times the increment needs to stay under that
+    constexpr uint64_t kNyquist = uint64_t{1} << 31;
+    for (size_t level = 0; level < kLevels; ++level) {
+        if ((kMaxHarmonics >> level) * static_cast<uint64_t>(increment) <= kNyquist) return level;
+    }
+    return kLevels - 1;
+}
+
+//
+// #############################################################################
+//
+
+Wavetable::Wavetable(const std::vector<double>& amplitudes) : data_(kLevels * kPadded) {
+    std::vector<double> sine(kSize);
+    for (size_t i = 0; i < kSize; ++i) sine[i] = std::sin(2.0 * M_PI * i / kSize);
+
+    // Each level is the one after it plus the harmonics in between, so the levels are built from the last one up
+    std::vector<double> sum(kSize, 0.0);
+    size_t harmonics = 0;
+    std::vector<std::vector<double>> levels(kLevels);
+    for (size_t level = kLevels; level-- > 0;) {
+        for (; harmonics < std::min(kMaxHarmonics >> level, amplitudes.size()); ++harmonics) {
+            const double amplitude = amplitudes[harmonics];
+            if (amplitude == 0.0) continue;
+
+            // Harmonic n of sample i is just a different sample of the first harmonic
+            const size_t n = harmonics + 1;
+            for (size_t i = 0; i < kSize; ++i) sum[i] += amplitude * sine[(n * i) & (kSize - 1)];
+        }
+        levels[level] = sum;
+    }
+
+    double peak = 0.0;
+    for (double value : levels.front()) peak = std::max(peak, std::abs(value));
+    const double scale = peak > 0.0 ? 1.0 / peak : 1.0;
+
+    for (size_t level = 0; level < kLevels; ++level) {
+        float* data = &data_[level * kPadded];
+        for (size_t i = 0; i < kPadded; ++i) {
+            data[i] = static_cast<float>(scale * levels[level][(i + kSize - 1) & (kSize - 1)]);
+        }
+    }
+}
+
+//
+// #############################################################################
+//
+
+const Wavetable& Wavetable::sine() {
+    static const Wavetable table{{1.0}};
+    return table;
+}
+
+//
+// #############################################################################
+//
+
+const Wavetable& Wavetable::triangle() {
+    // Odd harmonics falling off with n^2, alternating in sign so the peaks line up with the sine
+    static const Wavetable table{[] {
+        std::vector<double> amplitudes(kMaxHarmonics, 0.0);
+        for (size_t n = 1; n <= kMaxHarmonics; n += 2) amplitudes[n - 1] = (n % 4 == 1 ? 1.0 : -1.0) / (n * n);
+        return amplitudes;
+    }()};
+    return table;
+}
+
+//
+// #############################################################################
+//
+
+const Wavetable& Wavetable::saw() {
+    // Rises from 0 at the start of the cycle, and drops from the top to the bottom half way through
+    static const Wavetable table{[] {
+        std::vector<double> amplitudes(kMaxHarmonics, 0.0);
+        for (size_t n = 1; n <= kMaxHarmonics; ++n) amplitudes[n - 1] = (n % 2 == 1 ? 1.0 : -1.0) / n;
+        return amplitudes;
+    }()};
+    return table;
+}
+
+//
+// #############################################################################
+//
+
+const Wavetable& Wavetable::square() {
+    // High for the first half of the cycle and low for the second
+    static const Wavetable table{[] {
+        std::vector<double> amplitudes(kMaxHarmonics, 0.0);
+        for (size_t n = 1; n <= kMaxHarmonics; n += 2) amplitudes[n - 1] = 1.0 / n;
+        return amplitudes;
+    }()};
+    return table;
+}
+
+//
+// #############################################################################
+//
+
+void Wavetable::render(float* out, const Phase* phases, size_t level, size_t size,
+                       Interpolation interpolation) const {
+    // Separate loops so the choice isn't made every sample, each one only depends on the phase for that sample
+    const float* data = &data_[level * kPadded + 1];
+    if (interpolation == Interpolation::kLinear) {
+        for (size_t i = 0; i < size; ++i) {
+            const float fraction = static_cast<float>(phases[i] & kFractionMask) * kFractionScale;
+            out[i] = linear(data + (phases[i] >> kFractionBits), fraction);
+        }
+    } else {
+        for (size_t i = 0; i < size; ++i) {
+            const float fraction = static_cast<float>(phases[i] & kFractionMask) * kFractionScale;
+            out[i] = cubic(data + (phases[i] >> kFractionBits), fraction);
+        }
+    }
+}
+}  // namespace synth
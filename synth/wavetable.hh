@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "synth/samples.hh"
+
+///
+/// @brief Band-limited single cycle waveforms for table lookup oscillators. Each table is mip-mapped: level 0 holds
+/// the first kMaxHarmonics harmonics, and every level after it holds half as many as the one before. Oscillators pick
+/// the level which keeps every harmonic below Nyquist for the frequency they're playing, so nothing aliases.
+///
+
+namespace synth {
+class Wavetable {
+public:
+    /// Samples in one cycle of each level, a power of two so the index is just the top bits of the phase
+    static constexpr size_t kBits = 11;
+    static constexpr size_t kSize = size_t{1} << kBits;
+
+    /// Harmonics in level 0, the last level is a pure sine
+    static constexpr size_t kMaxHarmonics = 512;
+    static constexpr size_t kLevels = 10;
+    static_assert((kMaxHarmonics >> (kLevels - 1)) == 1);
+    static_assert(2 * kMaxHarmonics < kSize);
+
+    enum class Interpolation : uint8_t { kLinear = 0, kCubic = 1 };
+
+    ///
+    /// @brief Position in the cycle as a 32 bit fixed point fraction, so it wraps around on its own. The top kBits
+    /// bits are the index into the table and the rest are the fraction between samples.
+    ///
+    using Phase = uint32_t;
+
+    /// How far the phase moves each sample at the given frequency (with the current sample rate). This is inline so
+    /// oscillators can call it per sample, the scale is the same for the whole batch and gets hoisted out of loops.
+    static Phase phase_increment(double frequency) {
+        // Through a signed integer so negative frequencies wrap around and run the phase backwards
+        const double scale = 4294967296.0 / static_cast<double>(Samples::sample_rate());
+        return static_cast<Phase>(static_cast<int64_t>(frequency * scale));
+    }
+
+    /// First level with every harmonic below Nyquist at the given increment
+    static size_t level(Phase increment);
+
+public:
+    ///
+    /// @brief Sum of sine harmonics, amplitudes[n] is the amplitude of harmonic n + 1 (and anything past the end is
+    /// 0). Every level is scaled by the same amount so that level 0 peaks at 1.
+    ///
+    explicit Wavetable(const std::vector<double>& amplitudes);
+
+    static const Wavetable& sine();
+    static const Wavetable& triangle();
+    static const Wavetable& saw();
+    static const Wavetable& square();
+
+public:
+    ///
+    /// @brief out[i] = value at phases[i] from the given level. This doesn't allocate.
+    ///
+    void render(float* out, const Phase* phases, size_t level, size_t size, Interpolation interpolation) const;
+
+    float at(Phase phase, size_t level, Interpolation interpolation) const {
+        const float* data = &data_[level * kPadded + 1 + (phase >> kFractionBits)];
+        const float fraction = static_cast<float>(phase & kFractionMask) * kFractionScale;
+        return interpolation == Interpolation::kLinear ? linear(data, fraction) : cubic(data, fraction);
+    }
+
+private:
+    static constexpr size_t kFractionBits = 32 - kBits;
+    static constexpr Phase kFractionMask = (Phase{1} << kFractionBits) - 1;
+    static constexpr float kFractionScale = 1.f / static_cast<float>(Phase{1} << kFractionBits);
+
+    /// Each level has one sample before and two after the cycle (wrapped around) so interpolating never needs to wrap
+    static constexpr size_t kPadded = kSize + 3;
+
+    static float linear(const float* data, float fraction) { return data[0] + fraction * (data[1] - data[0]); }
+
+    /// Catmull-Rom through the two samples either side
+    static float cubic(const float* data, float fraction) {
+        const float before = data[-1];
+        const float c1 = 0.5f * (data[1] - before);
+        const float c2 = before - 2.5f * data[0] + 2.f * data[1] - 0.5f * data[2];
+        const float c3 = 0.5f * (data[2] - before) + 1.5f * (data[0] - data[1]);
+        return ((c3 * fraction + c2) * fraction + c1) * fraction + data[0];
+    }
+
+private:
+    std::vector<float> data_;
+};
+}  // namespace synth